@@ -0,0 +1,226 @@
+#include <string.h>
+
+#include "corpus.h"
+
+
+static const char*
+__corpus_names[] = {
+    "text",
+    "skewed",
+    "uniform",
+    "zeros",
+    "samples",
+};
+
+
+static const char*
+__corpus_words[] = {
+    "the", "of", "and", "to", "in", "a", "is", "that", "for", "it",
+    "as", "was", "with", "be", "by", "on", "not", "he", "this", "are",
+    "or", "his", "from", "at", "which", "but", "have", "an", "had", "they",
+    "encoding", "frequency", "binary", "tree", "symbol", "stream", "block",
+    "compression", "Huffman", "library", "buffer", "decoder", "encoder",
+};
+
+
+// Return the next pseudo-random number of the xorshift generator.
+static inline uint64_t
+__corpus_next(uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    return *state = x;
+}
+
+
+// Return the pseudo-random number, where the small numbers are
+// much more frequent than the large ones.
+static inline size_t
+__corpus_zipf(uint64_t *state, size_t count)
+{
+    uint64_t value = __corpus_next(state);
+
+    // Square of the uniform value in range [0, 1) is skewed towards zero.
+    uint64_t low = value & 0xffffffff;
+    return (size_t)(((low * low) >> 32) * count >> 32);
+}
+
+
+// Return the name of the corpus.
+const char*
+corpus_name(corpus_t corpus)
+{
+    if (corpus >= CORPUS_COUNT) {
+        return "unknown";
+    }
+
+    return __corpus_names[corpus];
+}
+
+
+// Find the corpus by the name.
+corpus_t
+corpus_parse(const char *name)
+{
+    for (size_t index = 0; index < CORPUS_COUNT; index++) {
+        if (!strcmp(name, __corpus_names[index])) {
+            return (corpus_t)index;
+        }
+    }
+
+    return CORPUS_COUNT;
+}
+
+
+static void
+__corpus_fill_text(uint8_t *buf, size_t len, uint64_t *state)
+{
+    const size_t words_len = sizeof(__corpus_words) / sizeof(*__corpus_words);
+    size_t offset = 0;
+    size_t line = 0;
+
+    while (offset < len) {
+        const char *word = __corpus_words[__corpus_zipf(state, words_len)];
+        size_t word_len = strlen(word);
+
+        if (word_len > len - offset) {
+            word_len = len - offset;
+        }
+
+        memcpy(buf + offset, word, word_len);
+        offset += word_len;
+        line += word_len;
+
+        if (offset == len) {
+            break;
+        }
+
+        uint64_t punct = __corpus_next(state) % 16;
+
+        if (line > 72) {
+            buf[offset++] = '\n';
+            line = 0;
+        } else if (punct == 0) {
+            buf[offset++] = '.';
+        } else if (punct == 1) {
+            buf[offset++] = ',';
+        } else {
+            buf[offset++] = ' ';
+            line++;
+        }
+    }
+}
+
+
+static void
+__corpus_fill_skewed(uint8_t *buf, size_t len, uint64_t *state)
+{
+    for (size_t index = 0; index < len; index++) {
+        uint64_t value = __corpus_next(state);
+
+        // Each next symbol is half as frequent as the previous one.
+        size_t symbol = 0;
+        while ((value & 1) && symbol < 255) {
+            value >>= 1;
+            symbol++;
+
+            if (!(symbol % 63)) {
+                value = __corpus_next(state);
+            }
+        }
+
+        buf[index] = (uint8_t)symbol;
+    }
+}
+
+
+static void
+__corpus_fill_uniform(uint8_t *buf, size_t len, uint64_t *state)
+{
+    for (size_t index = 0; index < len; index++) {
+        buf[index] = (uint8_t)(__corpus_next(state) >> 24);
+    }
+}
+
+
+static void
+__corpus_fill_zeros(uint8_t *buf, size_t len, uint64_t *state)
+{
+    size_t offset = 0;
+
+    while (offset < len) {
+        size_t run = __corpus_next(state) % 4096;
+        size_t noise = __corpus_next(state) % 64;
+
+        if (run > len - offset) {
+            run = len - offset;
+        }
+
+        memset(buf + offset, 0, run);
+        offset += run;
+
+        for (; noise > 0 && offset < len; noise--) {
+            buf[offset++] = (uint8_t)(__corpus_next(state) >> 24);
+        }
+    }
+}
+
+
+static void
+__corpus_fill_samples(uint8_t *buf, size_t len, uint64_t *state)
+{
+    int32_t sample = 0;
+
+    for (size_t index = 0; index < len; index += 2) {
+        // Small steps of the walk, that drifts back to zero.
+        int32_t step = (int32_t)(__corpus_next(state) % 513) - 256;
+        sample += step - sample / 64;
+
+        if (sample > INT16_MAX) {
+            sample = INT16_MAX;
+        } else if (sample < INT16_MIN) {
+            sample = INT16_MIN;
+        }
+
+        uint16_t value = (uint16_t)sample;
+
+        buf[index] = value & 0xff;
+        if (index + 1 < len) {
+            buf[index + 1] = value >> 8;
+        }
+    }
+}
+
+
+// Fill the buffer with the data of the corpus.
+void
+corpus_fill(corpus_t corpus, uint8_t *buf, size_t len, uint64_t seed)
+{
+    // State of the xorshift generator must not be zero.
+    uint64_t state = seed * 0x9e3779b97f4a7c15 + 1;
+
+    switch (corpus) {
+    case CORPUS_TEXT:
+        __corpus_fill_text(buf, len, &state);
+        break;
+    case CORPUS_SKEWED:
+        __corpus_fill_skewed(buf, len, &state);
+        break;
+    case CORPUS_UNIFORM:
+        __corpus_fill_uniform(buf, len, &state);
+        break;
+    case CORPUS_ZEROS:
+        __corpus_fill_zeros(buf, len, &state);
+        break;
+    case CORPUS_SAMPLES:
+        __corpus_fill_samples(buf, len, &state);
+        break;
+    default:
+        memset(buf, 0, len);
+        break;
+    }
+}
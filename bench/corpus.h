@@ -0,0 +1,48 @@
+#ifndef INCLUDE_huffman_bench_corpus_h__
+#define INCLUDE_huffman_bench_corpus_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Enumeration of the generated corpora.
+typedef enum {
+    // Words of the small vocabulary separated by the spaces,
+    // punctuation and line breaks.
+    CORPUS_TEXT,
+
+    // Bytes of the geometric distribution, a few symbols
+    // take most of the data.
+    CORPUS_SKEWED,
+
+    // Uniformly distributed bytes, that can't be compressed.
+    CORPUS_UNIFORM,
+
+    // Long runs of zeros interleaved with the random bytes.
+    CORPUS_ZEROS,
+
+    // Little-endian 16-bit samples of the random walk.
+    CORPUS_SAMPLES,
+
+    // Count of the corpora.
+    CORPUS_COUNT,
+} corpus_t;
+
+
+// Return the name of the corpus.
+const char*
+corpus_name(corpus_t corpus);
+
+
+// Find the corpus by the name, returns CORPUS_COUNT when
+// there is no corpus with such name.
+corpus_t
+corpus_parse(const char *name);
+
+
+// Fill the buffer with the data of the corpus. The same seed
+// always produces the same data.
+void
+corpus_fill(corpus_t corpus, uint8_t *buf, size_t len, uint64_t seed);
+
+
+#endif // INCLUDE_huffman_bench_corpus_h__
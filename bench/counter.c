@@ -0,0 +1,98 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "counter.h"
+
+
+// Open the cycles counter of the calling thread.
+int
+counter_open(void)
+{
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // Counter of the calling thread on any processor.
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+
+// Close the cycles counter.
+void
+counter_close(int fd)
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+
+// Return the current time and the count of cycles.
+counter_sample_t
+counter_read(int fd)
+{
+    counter_sample_t sample = {0, 0};
+    struct timespec ts;
+
+    if (fd >= 0 && read(fd, &sample.cycles, sizeof(sample.cycles)) != sizeof(sample.cycles)) {
+        sample.cycles = 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    sample.ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+    return sample;
+}
+
+
+static void*
+counter_alloc(void *ctx, size_t size)
+{
+    counter_allocator_t *self = ctx;
+
+    self->allocations++;
+    if (!self->wrapped.alloc) {
+        return malloc(size);
+    }
+    return self->wrapped.alloc(self->wrapped.ctx, size);
+}
+
+
+static void
+counter_free(void *ctx, void *ptr)
+{
+    counter_allocator_t *self = ctx;
+
+    if (!self->wrapped.alloc) {
+        free(ptr);
+    } else if (self->wrapped.free) {
+        self->wrapped.free(self->wrapped.ctx, ptr);
+    }
+}
+
+
+// Return the allocator, that counts the allocations with the counter.
+huf_allocator_t
+counter_allocator(counter_allocator_t *self)
+{
+    huf_allocator_t allocator = {counter_alloc, counter_free, self};
+    return allocator;
+}
@@ -0,0 +1,55 @@
+#ifndef INCLUDE_huffman_bench_counter_h__
+#define INCLUDE_huffman_bench_counter_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <huffman/malloc.h>
+
+// counter_sample_t is a reading of the monotonic clock and of the
+// processor cycles counter. The difference of two samples is the
+// cost of the code executed between them.
+typedef struct counter_sample {
+    // Monotonic time in nanoseconds.
+    uint64_t ns;
+
+    // Processor cycles spent by the calling thread in the user
+    // space, zero when the cycles counter is not available.
+    uint64_t cycles;
+} counter_sample_t;
+
+
+// Open the cycles counter of the calling thread with perf_event_open,
+// returns -1 when the counter is not available, then only the time
+// is measured.
+int
+counter_open(void);
+
+
+// Close the cycles counter.
+void
+counter_close(int fd);
+
+
+// Return the current time and the count of cycles.
+counter_sample_t
+counter_read(int fd);
+
+
+// counter_allocator_t counts the calls of the wrapped allocator.
+typedef struct counter_allocator {
+    // Wrapped allocator, if the alloc function is nil, then malloc
+    // and free are used.
+    huf_allocator_t wrapped;
+
+    // Count of the allocations.
+    size_t allocations;
+} counter_allocator_t;
+
+
+// Return the allocator, that counts the allocations with the counter.
+huf_allocator_t
+counter_allocator(counter_allocator_t *self);
+
+
+#endif // INCLUDE_huffman_bench_counter_h__
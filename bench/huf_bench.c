@@ -0,0 +1,390 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <huffman.h>
+
+#include "corpus.h"
+#include "counter.h"
+
+
+// Maximum count of the values of the list options.
+#define BENCH_LIST_LEN 16
+
+
+// bench_options_t holds parameters of the benchmark.
+typedef struct bench_options {
+    // Corpora to benchmark.
+    corpus_t corpora[CORPUS_COUNT];
+    size_t corpora_len;
+
+    // Sizes of the encoding blocks.
+    uint64_t blocksizes[BENCH_LIST_LEN];
+    size_t blocksizes_len;
+
+    // Sizes of the reader and writer buffers.
+    uint64_t buffer_sizes[BENCH_LIST_LEN];
+    size_t buffer_sizes_len;
+
+    // Length of the generated data.
+    size_t length;
+
+    // Count of the measured runs, the fastest run is reported.
+    size_t iterations;
+
+    // Count of the interleaved streams.
+    size_t streams;
+
+    // Depth of the encoder pipeline.
+    size_t pipeline_depth;
+
+    // Seed of the corpus generator.
+    uint64_t seed;
+} bench_options_t;
+
+
+// bench_result_t holds measurements of the single configuration.
+typedef struct bench_result {
+    // Length of the encoded data.
+    size_t encoded_length;
+
+    // The fastest encoding and decoding time in seconds.
+    double encode_seconds;
+    double decode_seconds;
+} bench_result_t;
+
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -c LIST  corpora: text,skewed,uniform,zeros,samples (default: all)\n"
+        "  -n SIZE  length of the generated data in bytes (default: 16777216)\n"
+        "  -b LIST  sizes of the encoding blocks (default: 65536,1048576)\n"
+        "  -r LIST  sizes of the reader and writer buffers (default: 65536)\n"
+        "  -i NUM   count of the measured runs (default: 5)\n"
+        "  -s NUM   count of the interleaved streams, 0 or 4 (default: 0)\n"
+        "  -p NUM   depth of the encoder pipeline (default: 0)\n"
+        "  -S NUM   seed of the corpus generator (default: 1)\n"
+        "\n"
+        "Each result is printed as a JSON object on a separate line.\n",
+        name);
+}
+
+
+// Return the current time in seconds.
+static double
+now(void)
+{
+    return counter_read(-1).ns / 1e9;
+}
+
+
+// Return the peak resident set size of the process in KiB.
+static long
+peak_rss(void)
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage)) {
+        return -1;
+    }
+
+    return usage.ru_maxrss;
+}
+
+
+// Parse the comma-separated list of numbers, returns the
+// count of the numbers or zero on failure.
+static size_t
+parse_numbers(const char *arg, uint64_t *values, size_t len)
+{
+    size_t count = 0;
+    char *end = NULL;
+
+    while (*arg && count < len) {
+        values[count++] = strtoull(arg, &end, 0);
+
+        if (end == arg || (*end && *end != ',')) {
+            return 0;
+        }
+
+        arg = *end ? end + 1 : end;
+    }
+
+    return *arg ? 0 : count;
+}
+
+
+// Parse the comma-separated list of the corpora.
+static size_t
+parse_corpora(const char *arg, corpus_t *corpora)
+{
+    char name[64];
+    size_t count = 0;
+
+    while (*arg && count < CORPUS_COUNT) {
+        size_t len = strcspn(arg, ",");
+        if (len >= sizeof(name)) {
+            return 0;
+        }
+
+        memcpy(name, arg, len);
+        name[len] = '\0';
+
+        corpora[count] = corpus_parse(name);
+        if (corpora[count++] == CORPUS_COUNT) {
+            return 0;
+        }
+
+        arg += len;
+        arg += *arg == ',';
+    }
+
+    return count;
+}
+
+
+// Replace the content of the memory stream with the specified data.
+static huf_error_t
+reset_stream(huf_read_writer_t *stream, const void *buf, size_t len)
+{
+    huf_error_t err = huf_memrewind(stream);
+    if (err != HUF_ERROR_SUCCESS || !len) {
+        return err;
+    }
+
+    return stream->write(stream->stream, buf, len);
+}
+
+
+// Encode and decode the data with the specified configuration.
+static huf_error_t
+bench_run(const bench_options_t *options, const uint8_t *data,
+        uint64_t blocksize, uint64_t buffer_size, bench_result_t *result)
+{
+    huf_error_t err;
+    huf_read_writer_t *input = NULL, *output = NULL;
+    void *bufin = NULL, *bufout = NULL;
+    uint8_t *encoded = NULL;
+
+    const size_t length = options->length;
+
+    memset(result, 0, sizeof(*result));
+
+    err = huf_memopen(&input, &bufin, length);
+    if (err != HUF_ERROR_SUCCESS) {
+        goto cleanup;
+    }
+
+    err = huf_memopen(&output, &bufout, length);
+    if (err != HUF_ERROR_SUCCESS) {
+        goto cleanup;
+    }
+
+    huf_config_t config = {
+        .length = length,
+        .blocksize = blocksize,
+        .reader_buffer_size = buffer_size,
+        .writer_buffer_size = buffer_size,
+        .streams = options->streams,
+        .pipeline_depth = options->pipeline_depth,
+        .reader = input,
+        .writer = output,
+    };
+
+    for (size_t index = 0; index < options->iterations; index++) {
+        if ((err = reset_stream(input, data, length)) != HUF_ERROR_SUCCESS ||
+                (err = huf_memrewind(output)) != HUF_ERROR_SUCCESS) {
+            goto cleanup;
+        }
+
+        double start = now();
+
+        err = huf_encode(&config);
+        if (err != HUF_ERROR_SUCCESS) {
+            goto cleanup;
+        }
+
+        double elapsed = now() - start;
+        if (!index || elapsed < result->encode_seconds) {
+            result->encode_seconds = elapsed;
+        }
+    }
+
+    err = huf_memlen(output, &result->encoded_length);
+    if (err != HUF_ERROR_SUCCESS) {
+        goto cleanup;
+    }
+
+    encoded = malloc(result->encoded_length + 1);
+    if (!encoded) {
+        err = HUF_ERROR_MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+
+    memcpy(encoded, bufout, result->encoded_length);
+    config.length = result->encoded_length;
+
+    for (size_t index = 0; index < options->iterations; index++) {
+        if ((err = reset_stream(input, encoded, result->encoded_length)) != HUF_ERROR_SUCCESS ||
+                (err = huf_memrewind(output)) != HUF_ERROR_SUCCESS) {
+            goto cleanup;
+        }
+
+        double start = now();
+
+        err = huf_decode(&config);
+        if (err != HUF_ERROR_SUCCESS) {
+            goto cleanup;
+        }
+
+        double elapsed = now() - start;
+        if (!index || elapsed < result->decode_seconds) {
+            result->decode_seconds = elapsed;
+        }
+    }
+
+    // Validate the decoded data, so broken changes are not measured.
+    size_t decoded_length = 0;
+
+    err = huf_memlen(output, &decoded_length);
+    if (err != HUF_ERROR_SUCCESS) {
+        goto cleanup;
+    }
+
+    if (decoded_length != length || memcmp(bufout, data, length)) {
+        err = HUF_ERROR_BLOCK_CORRUPTED;
+    }
+
+cleanup:
+    free(encoded);
+    huf_memclose(&input);
+    huf_memclose(&output);
+    free(bufin);
+    free(bufout);
+
+    return err;
+}
+
+
+// Return the throughput in MB/s.
+static double
+throughput(size_t length, double seconds)
+{
+    return seconds > 0 ? length / seconds / 1e6 : 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    bench_options_t options = {
+        .blocksizes = {HUF_64KIB_BUFFER, HUF_1MIB_BUFFER},
+        .blocksizes_len = 2,
+        .buffer_sizes = {HUF_64KIB_BUFFER},
+        .buffer_sizes_len = 1,
+        .length = 16 * HUF_1MIB_BUFFER,
+        .iterations = 5,
+        .seed = 1,
+    };
+
+    for (size_t index = 0; index < CORPUS_COUNT; index++) {
+        options.corpora[options.corpora_len++] = (corpus_t)index;
+    }
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:b:r:i:s:p:S:h")) != -1) {
+        int valid = 1;
+
+        switch (opt) {
+        case 'c':
+            options.corpora_len = parse_corpora(optarg, options.corpora);
+            valid = options.corpora_len > 0;
+            break;
+        case 'n':
+            options.length = strtoull(optarg, NULL, 0);
+            valid = options.length > 0;
+            break;
+        case 'b':
+            options.blocksizes_len = parse_numbers(optarg,
+                    options.blocksizes, BENCH_LIST_LEN);
+            valid = options.blocksizes_len > 0;
+            break;
+        case 'r':
+            options.buffer_sizes_len = parse_numbers(optarg,
+                    options.buffer_sizes, BENCH_LIST_LEN);
+            valid = options.buffer_sizes_len > 0;
+            break;
+        case 'i':
+            options.iterations = strtoull(optarg, NULL, 0);
+            valid = options.iterations > 0;
+            break;
+        case 's':
+            options.streams = strtoull(optarg, NULL, 0);
+            break;
+        case 'p':
+            options.pipeline_depth = strtoull(optarg, NULL, 0);
+            break;
+        case 'S':
+            options.seed = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            valid = 0;
+            break;
+        }
+
+        if (!valid) {
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    uint8_t *data = malloc(options.length);
+    if (!data) {
+        fprintf(stderr, "%s\n", huf_error_string(HUF_ERROR_MEMORY_ALLOCATION));
+        return 1;
+    }
+
+    for (size_t index = 0; index < options.corpora_len; index++) {
+        corpus_t corpus = options.corpora[index];
+        corpus_fill(corpus, data, options.length, options.seed);
+
+        for (size_t block = 0; block < options.blocksizes_len; block++) {
+            for (size_t buffer = 0; buffer < options.buffer_sizes_len; buffer++) {
+                bench_result_t result;
+
+                huf_error_t err = bench_run(&options, data, options.blocksizes[block],
+                        options.buffer_sizes[buffer], &result);
+                if (err != HUF_ERROR_SUCCESS) {
+                    fprintf(stderr, "%s: %s\n", corpus_name(corpus), huf_error_string(err));
+                    free(data);
+                    return 1;
+                }
+
+                printf("{\"corpus\": \"%s\", \"length\": %zu, \"blocksize\": %llu, "
+                        "\"buffer_size\": %llu, \"streams\": %zu, \"pipeline_depth\": %zu, "
+                        "\"encoded_length\": %zu, \"ratio\": %.4f, "
+                        "\"encode_mbps\": %.2f, \"decode_mbps\": %.2f, "
+                        "\"peak_rss_kib\": %ld}\n",
+                        corpus_name(corpus), options.length,
+                        (unsigned long long)options.blocksizes[block],
+                        (unsigned long long)options.buffer_sizes[buffer],
+                        options.streams, options.pipeline_depth,
+                        result.encoded_length,
+                        (double)options.length / result.encoded_length,
+                        throughput(options.length, result.encode_seconds),
+                        throughput(options.length, result.decode_seconds),
+                        peak_rss());
+                fflush(stdout);
+            }
+        }
+    }
+
+    free(data);
+
+    return 0;
+}
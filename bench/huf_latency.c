@@ -0,0 +1,437 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <huffman.h>
+
+#include "corpus.h"
+#include "counter.h"
+
+
+// Maximum count of the values of the list options.
+#define LATENCY_LIST_LEN 16
+
+// Count of the distinct messages, the calls go through them in turn.
+#define LATENCY_MESSAGES 64
+
+
+// latency_context_t holds the messages and the buffers of the calls.
+typedef struct latency_context {
+    // Messages of the same length, and their encodings.
+    huf_segment_t messages[LATENCY_MESSAGES];
+    huf_segment_t encodings[LATENCY_MESSAGES];
+    huf_segment_t shared[LATENCY_MESSAGES];
+    huf_segment_t table;
+
+    // Length of each message.
+    size_t length;
+
+    // Streams of the encoder and decoder.
+    huf_read_writer_t *input;
+    huf_read_writer_t *output;
+    void *bufin;
+    void *bufout;
+
+    // Buffers of the one-shot calls.
+    uint8_t *compressed;
+    size_t compressed_cap;
+    uint8_t *decompressed;
+
+    // Allocator of the encoder and decoder.
+    counter_allocator_t counter;
+} latency_context_t;
+
+
+// latency_op_t is a measured call.
+typedef struct latency_op {
+    // Name of the API.
+    const char *api;
+
+    // Name of the operation.
+    const char *operation;
+
+    // Prepare the call with the specified message, the
+    // preparation is not measured.
+    huf_error_t (*prepare)(latency_context_t *ctx, size_t message);
+
+    // Make the call with the specified message.
+    huf_error_t (*run)(latency_context_t *ctx, size_t message);
+} latency_op_t;
+
+
+// Replace the content of the memory stream with the specified data.
+static huf_error_t
+reset_stream(huf_read_writer_t *stream, const void *buf, size_t len)
+{
+    huf_error_t err = huf_memrewind(stream);
+    if (err != HUF_ERROR_SUCCESS || !len) {
+        return err;
+    }
+
+    return stream->write(stream->stream, buf, len);
+}
+
+
+static huf_error_t
+stream_encode_prepare(latency_context_t *ctx, size_t message)
+{
+    huf_error_t err = reset_stream(ctx->input, ctx->messages[message].base,
+            ctx->messages[message].len);
+    if (err != HUF_ERROR_SUCCESS) {
+        return err;
+    }
+
+    return huf_memrewind(ctx->output);
+}
+
+
+static huf_error_t
+stream_encode(latency_context_t *ctx, size_t message)
+{
+    huf_config_t config = {
+        .length = ctx->messages[message].len,
+        .reader = ctx->input,
+        .writer = ctx->output,
+        .reader_buffer_size = HUF_1KIB_BUFFER,
+        .writer_buffer_size = HUF_1KIB_BUFFER,
+        .allocator = counter_allocator(&ctx->counter),
+    };
+
+    return huf_encode(&config);
+}
+
+
+static huf_error_t
+stream_decode_prepare(latency_context_t *ctx, size_t message)
+{
+    huf_error_t err = reset_stream(ctx->input, ctx->encodings[message].base,
+            ctx->encodings[message].len);
+    if (err != HUF_ERROR_SUCCESS) {
+        return err;
+    }
+
+    return huf_memrewind(ctx->output);
+}
+
+
+static huf_error_t
+stream_decode(latency_context_t *ctx, size_t message)
+{
+    huf_config_t config = {
+        .length = ctx->encodings[message].len,
+        .reader = ctx->input,
+        .writer = ctx->output,
+        .reader_buffer_size = HUF_1KIB_BUFFER,
+        .writer_buffer_size = HUF_1KIB_BUFFER,
+        .allocator = counter_allocator(&ctx->counter),
+    };
+
+    return huf_decode(&config);
+}
+
+
+static huf_error_t
+oneshot_compress(latency_context_t *ctx, size_t message)
+{
+    size_t len = 0;
+
+    return huf_compress(ctx->compressed, ctx->compressed_cap,
+            ctx->messages[message].base, ctx->messages[message].len, &len);
+}
+
+
+static huf_error_t
+oneshot_decompress(latency_context_t *ctx, size_t message)
+{
+    size_t len = 0;
+
+    huf_error_t err = huf_decompress(ctx->decompressed, ctx->length,
+            ctx->encodings[message].base, ctx->encodings[message].len, &len);
+    if (err == HUF_ERROR_SUCCESS && len != ctx->length) {
+        return HUF_ERROR_BLOCK_CORRUPTED;
+    }
+
+    return err;
+}
+
+
+static huf_error_t
+shared_decompress(latency_context_t *ctx, size_t message)
+{
+    size_t len = 0;
+
+    huf_error_t err = huf_decompress_shared(ctx->decompressed, ctx->length,
+            ctx->table.base, ctx->table.len, ctx->shared[message].base,
+            ctx->shared[message].len, &len);
+    if (err == HUF_ERROR_SUCCESS && len != ctx->length) {
+        return HUF_ERROR_BLOCK_CORRUPTED;
+    }
+
+    return err;
+}
+
+
+static const latency_op_t ops[] = {
+    {"stream", "encode", stream_encode_prepare, stream_encode},
+    {"stream", "decode", stream_decode_prepare, stream_decode},
+    {"oneshot", "encode", NULL, oneshot_compress},
+    {"oneshot", "decode", NULL, oneshot_decompress},
+    {"shared", "decode", NULL, shared_decompress},
+};
+
+
+// Release memory occupied by the context.
+static void
+latency_context_free(latency_context_t *ctx)
+{
+    if (ctx->input) {
+        huf_memclose(&ctx->input);
+    }
+
+    if (ctx->output) {
+        huf_memclose(&ctx->output);
+    }
+
+    free(ctx->bufin);
+    free(ctx->bufout);
+    free(ctx->compressed);
+    free(ctx->decompressed);
+    free(ctx->messages[0].base);
+    free(ctx->encodings[0].base);
+}
+
+
+// Generate the messages of the specified length and encode them, the
+// messages are the consecutive slices of the corpus.
+static huf_error_t
+latency_context_init(latency_context_t *ctx, corpus_t corpus, size_t length,
+        uint64_t seed)
+{
+    huf_error_t err;
+
+    size_t bound = huf_compress_bound(length);
+    size_t encodings_cap = HUF_COMPRESS_BLOCK_OVERHEAD + bound * LATENCY_MESSAGES * 2;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->length = length;
+
+    uint8_t *data = malloc(length * LATENCY_MESSAGES + 1);
+    uint8_t *encodings = malloc(encodings_cap);
+
+    ctx->messages[0].base = data;
+    ctx->encodings[0].base = encodings;
+
+    ctx->compressed_cap = bound;
+    ctx->compressed = malloc(bound);
+    ctx->decompressed = malloc(length + 1);
+
+    if (!data || !encodings || !ctx->compressed || !ctx->decompressed) {
+        return HUF_ERROR_MEMORY_ALLOCATION;
+    }
+
+    corpus_fill(corpus, data, length * LATENCY_MESSAGES, seed);
+
+    for (size_t index = 0; index < LATENCY_MESSAGES; index++) {
+        ctx->messages[index].base = data + index * length;
+        ctx->messages[index].len = length;
+    }
+
+    // Encodings of the separate messages are followed by the encodings
+    // with the shared table.
+    err = huf_encode_batch(encodings, bound * LATENCY_MESSAGES, ctx->messages,
+            ctx->encodings, LATENCY_MESSAGES, NULL);
+    if (err != HUF_ERROR_SUCCESS) {
+        return err;
+    }
+
+    size_t offset = bound * LATENCY_MESSAGES;
+
+    err = huf_encode_batch(encodings + offset, encodings_cap - offset, ctx->messages,
+            ctx->shared, LATENCY_MESSAGES, &ctx->table);
+    if (err != HUF_ERROR_SUCCESS) {
+        return err;
+    }
+
+    if ((err = huf_memopen(&ctx->input, &ctx->bufin, bound)) != HUF_ERROR_SUCCESS ||
+            (err = huf_memopen(&ctx->output, &ctx->bufout, bound)) != HUF_ERROR_SUCCESS) {
+        return err;
+    }
+
+    // Count the calls of the allocator used by default.
+    return huf_pool_default_allocator(&ctx->counter.wrapped);
+}
+
+
+static int
+compare_samples(const void *a, const void *b)
+{
+    uint64_t left = *(const uint64_t*)a;
+    uint64_t right = *(const uint64_t*)b;
+
+    return (left > right) - (left < right);
+}
+
+
+// Return the sample of the specified percentile of the sorted samples.
+static uint64_t
+percentile(const uint64_t *samples, size_t len, double rank)
+{
+    size_t index = (size_t)(rank * len);
+    return samples[index < len ? index : len - 1];
+}
+
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -c NAME  corpus: text,skewed,uniform,zeros,samples (default: text)\n"
+        "  -n LIST  lengths of the messages in bytes (default: 64,256,1024,4096)\n"
+        "  -N NUM   count of the measured calls of each operation (default: 100000)\n"
+        "  -w NUM   count of the warm-up calls (default: 1000)\n"
+        "  -S NUM   seed of the corpus generator (default: 1)\n"
+        "\n"
+        "Each result is printed as a JSON object on a separate line.\n",
+        name);
+}
+
+
+// Parse the comma-separated list of numbers, returns the
+// count of the numbers or zero on failure.
+static size_t
+parse_numbers(const char *arg, uint64_t *values, size_t len)
+{
+    size_t count = 0;
+    char *end = NULL;
+
+    while (*arg && count < len) {
+        values[count++] = strtoull(arg, &end, 0);
+
+        if (end == arg || (*end && *end != ',') || !values[count - 1]) {
+            return 0;
+        }
+
+        arg = *end ? end + 1 : end;
+    }
+
+    return *arg ? 0 : count;
+}
+
+
+int main(int argc, char **argv)
+{
+    uint64_t lengths[LATENCY_LIST_LEN] = {64, 256, 1024, 4096};
+    size_t lengths_len = 4;
+
+    corpus_t corpus = CORPUS_TEXT;
+    size_t calls = 100000;
+    size_t warmup = 1000;
+    uint64_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:N:w:S:h")) != -1) {
+        int valid = 1;
+
+        switch (opt) {
+        case 'c':
+            corpus = corpus_parse(optarg);
+            valid = corpus != CORPUS_COUNT;
+            break;
+        case 'n':
+            lengths_len = parse_numbers(optarg, lengths, LATENCY_LIST_LEN);
+            valid = lengths_len > 0;
+            break;
+        case 'N':
+            calls = strtoull(optarg, NULL, 0);
+            valid = calls > 0;
+            break;
+        case 'w':
+            warmup = strtoull(optarg, NULL, 0);
+            break;
+        case 'S':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            valid = 0;
+            break;
+        }
+
+        if (!valid) {
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    uint64_t *samples = malloc(calls * sizeof(uint64_t));
+    if (!samples) {
+        fprintf(stderr, "%s\n", huf_error_string(HUF_ERROR_MEMORY_ALLOCATION));
+        return 1;
+    }
+
+    for (size_t pos = 0; pos < lengths_len; pos++) {
+        latency_context_t ctx;
+
+        huf_error_t err = latency_context_init(&ctx, corpus, lengths[pos], seed);
+
+        for (size_t index = 0; index < sizeof(ops) / sizeof(*ops) && !err; index++) {
+            const latency_op_t *op = &ops[index];
+            uint64_t total = 0;
+
+            for (size_t call = 0; call < warmup + calls && !err; call++) {
+                size_t message = call % LATENCY_MESSAGES;
+
+                if (op->prepare && (err = op->prepare(&ctx, message))) {
+                    break;
+                }
+
+                // Allocations of the warm-up calls are not counted.
+                if (call == warmup) {
+                    ctx.counter.allocations = 0;
+                }
+
+                counter_sample_t begin = counter_read(-1);
+                err = op->run(&ctx, message);
+                counter_sample_t end = counter_read(-1);
+
+                if (call >= warmup) {
+                    samples[call - warmup] = end.ns - begin.ns;
+                    total += end.ns - begin.ns;
+                }
+            }
+
+            if (err) {
+                break;
+            }
+
+            qsort(samples, calls, sizeof(*samples), compare_samples);
+
+            printf("{\"api\": \"%s\", \"operation\": \"%s\", \"corpus\": \"%s\", "
+                    "\"length\": %zu, \"calls\": %zu, \"mean_ns\": %.1f, "
+                    "\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, "
+                    "\"max_ns\": %llu, \"allocations_per_call\": %.2f}\n",
+                    op->api, op->operation, corpus_name(corpus), ctx.length, calls,
+                    (double)total / calls,
+                    (unsigned long long)percentile(samples, calls, 0.5),
+                    (unsigned long long)percentile(samples, calls, 0.99),
+                    (unsigned long long)percentile(samples, calls, 0.999),
+                    (unsigned long long)samples[calls - 1],
+                    (double)ctx.counter.allocations / calls);
+            fflush(stdout);
+        }
+
+        latency_context_free(&ctx);
+
+        if (err) {
+            fprintf(stderr, "%s: %s\n", corpus_name(corpus), huf_error_string(err));
+            free(samples);
+            return 1;
+        }
+    }
+
+    free(samples);
+
+    return 0;
+}
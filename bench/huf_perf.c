@@ -0,0 +1,356 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <huffman.h>
+
+#include "corpus.h"
+#include "counter.h"
+
+
+// Maximum count of the baseline entries.
+#define PERF_ENTRIES_LEN 64
+
+// Default fraction of the baseline throughput, which the measured
+// throughput could fall below without failing the check.
+#define PERF_TOLERANCE 0.25
+
+
+// perf_entry_t is a benchmark of the baseline file.
+typedef struct perf_entry {
+    // Name of the benchmark.
+    char name[64];
+
+    // Corpus encoded by the benchmark.
+    corpus_t corpus;
+
+    // Length of the encoded data.
+    size_t length;
+
+    // Size of the encoding block.
+    uint64_t blocksize;
+
+    // Count of the interleaved streams.
+    size_t streams;
+
+    // Throughput of the encoder and decoder in MB/s.
+    double encode_mbps;
+    double decode_mbps;
+
+    // Count of the allocations of the encoder and decoder.
+    size_t allocations;
+} perf_entry_t;
+
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options] BASELINE\n"
+        "  -t FRAC  allowed drop of the throughput below the baseline\n"
+        "           (default: $HUF_PERF_TOLERANCE or 0.25)\n"
+        "  -i NUM   count of the measured runs (default: 5)\n"
+        "  -u       write the measured values into the baseline file\n",
+        name);
+}
+
+
+// Read the entries of the baseline file, returns the count of the
+// entries or -1 on failure. Empty lines and lines starting with '#'
+// are ignored.
+static int
+read_baseline(const char *path, perf_entry_t *entries, size_t len)
+{
+    char line[512];
+    char corpus[64];
+    int count = 0;
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        perf_entry_t *entry = &entries[count];
+        unsigned long long length, blocksize;
+
+        if (line[strspn(line, " \t\n")] == '\0' || line[0] == '#') {
+            continue;
+        }
+
+        if ((size_t)count == len) {
+            fprintf(stderr, "%s: too many entries\n", path);
+            count = -1;
+            break;
+        }
+
+        int fields = sscanf(line, "%63s %63s %llu %llu %zu %lf %lf %zu",
+                entry->name, corpus, &length, &blocksize, &entry->streams,
+                &entry->encode_mbps, &entry->decode_mbps, &entry->allocations);
+
+        entry->corpus = corpus_parse(corpus);
+        entry->length = length;
+        entry->blocksize = blocksize;
+
+        if (fields != 8 || entry->corpus == CORPUS_COUNT) {
+            fprintf(stderr, "%s: malformed entry: %s", path, line);
+            count = -1;
+            break;
+        }
+
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+
+// Write the entries into the baseline file.
+static int
+write_baseline(const char *path, const perf_entry_t *entries, size_t len)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(file,
+        "# Baseline of the performance tests, regenerate with `huf_perf -u`.\n"
+        "#\n"
+        "# name corpus length blocksize streams encode_mbps decode_mbps allocations\n");
+
+    for (size_t index = 0; index < len; index++) {
+        const perf_entry_t *entry = &entries[index];
+
+        fprintf(file, "%s %s %zu %llu %zu %.0f %.0f %zu\n", entry->name,
+                corpus_name(entry->corpus), entry->length,
+                (unsigned long long)entry->blocksize, entry->streams,
+                entry->encode_mbps, entry->decode_mbps, entry->allocations);
+    }
+
+    return fclose(file) ? -1 : 0;
+}
+
+
+// Replace the content of the memory stream with the specified data.
+static huf_error_t
+reset_stream(huf_read_writer_t *stream, const void *buf, size_t len)
+{
+    huf_error_t err = huf_memrewind(stream);
+    if (err != HUF_ERROR_SUCCESS || !len) {
+        return err;
+    }
+
+    return stream->write(stream->stream, buf, len);
+}
+
+
+// Encode and decode the corpus of the entry, the measured values
+// are written into the result.
+static huf_error_t
+perf_run(const perf_entry_t *entry, size_t iterations, perf_entry_t *result)
+{
+    huf_error_t err;
+    huf_read_writer_t *input = NULL, *output = NULL;
+    void *bufin = NULL, *bufout = NULL;
+    uint8_t *data = NULL, *encoded = NULL;
+
+    counter_allocator_t counter = {0};
+    size_t encoded_length = 0;
+    uint64_t encode_ns = 0, decode_ns = 0;
+
+    *result = *entry;
+
+    data = malloc(entry->length + 1);
+    if (!data) {
+        return HUF_ERROR_MEMORY_ALLOCATION;
+    }
+
+    corpus_fill(entry->corpus, data, entry->length, 1);
+
+    if ((err = huf_memopen(&input, &bufin, entry->length)) != HUF_ERROR_SUCCESS ||
+            (err = huf_memopen(&output, &bufout, entry->length)) != HUF_ERROR_SUCCESS) {
+        goto cleanup;
+    }
+
+    huf_config_t config = {
+        .length = entry->length,
+        .blocksize = entry->blocksize,
+        .reader_buffer_size = HUF_64KIB_BUFFER,
+        .writer_buffer_size = HUF_64KIB_BUFFER,
+        .streams = entry->streams,
+        .reader = input,
+        .writer = output,
+        .allocator = counter_allocator(&counter),
+    };
+
+    for (size_t index = 0; index < iterations; index++) {
+        if ((err = reset_stream(input, data, entry->length)) != HUF_ERROR_SUCCESS ||
+                (err = huf_memrewind(output)) != HUF_ERROR_SUCCESS) {
+            goto cleanup;
+        }
+
+        counter.allocations = 0;
+        counter_sample_t begin = counter_read(-1);
+
+        if ((err = huf_encode(&config)) != HUF_ERROR_SUCCESS) {
+            goto cleanup;
+        }
+
+        uint64_t elapsed = counter_read(-1).ns - begin.ns;
+        if (!index || elapsed < encode_ns) {
+            encode_ns = elapsed;
+        }
+    }
+
+    result->allocations = counter.allocations;
+
+    if ((err = huf_memlen(output, &encoded_length)) != HUF_ERROR_SUCCESS) {
+        goto cleanup;
+    }
+
+    encoded = malloc(encoded_length + 1);
+    if (!encoded) {
+        err = HUF_ERROR_MEMORY_ALLOCATION;
+        goto cleanup;
+    }
+
+    memcpy(encoded, bufout, encoded_length);
+    config.length = encoded_length;
+
+    for (size_t index = 0; index < iterations; index++) {
+        if ((err = reset_stream(input, encoded, encoded_length)) != HUF_ERROR_SUCCESS ||
+                (err = huf_memrewind(output)) != HUF_ERROR_SUCCESS) {
+            goto cleanup;
+        }
+
+        counter.allocations = 0;
+        counter_sample_t begin = counter_read(-1);
+
+        if ((err = huf_decode(&config)) != HUF_ERROR_SUCCESS) {
+            goto cleanup;
+        }
+
+        uint64_t elapsed = counter_read(-1).ns - begin.ns;
+        if (!index || elapsed < decode_ns) {
+            decode_ns = elapsed;
+        }
+    }
+
+    result->allocations += counter.allocations;
+
+    size_t decoded_length = 0;
+    if ((err = huf_memlen(output, &decoded_length)) != HUF_ERROR_SUCCESS) {
+        goto cleanup;
+    }
+
+    if (decoded_length != entry->length || memcmp(bufout, data, entry->length)) {
+        err = HUF_ERROR_BLOCK_CORRUPTED;
+        goto cleanup;
+    }
+
+    result->encode_mbps = encode_ns ? entry->length * 1e3 / encode_ns : 0;
+    result->decode_mbps = decode_ns ? entry->length * 1e3 / decode_ns : 0;
+
+cleanup:
+    free(data);
+    free(encoded);
+    huf_memclose(&input);
+    huf_memclose(&output);
+    free(bufin);
+    free(bufout);
+
+    return err;
+}
+
+
+int main(int argc, char **argv)
+{
+    perf_entry_t entries[PERF_ENTRIES_LEN];
+    perf_entry_t results[PERF_ENTRIES_LEN];
+
+    double tolerance = PERF_TOLERANCE;
+    size_t iterations = 5;
+    int update = 0;
+
+    const char *env = getenv("HUF_PERF_TOLERANCE");
+    if (env) {
+        tolerance = strtod(env, NULL);
+    }
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:i:uh")) != -1) {
+        switch (opt) {
+        case 't':
+            tolerance = strtod(optarg, NULL);
+            break;
+        case 'i':
+            iterations = strtoull(optarg, NULL, 0);
+            break;
+        case 'u':
+            update = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (optind != argc - 1 || !iterations || tolerance < 0 || tolerance >= 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const char *path = argv[optind];
+
+    int count = read_baseline(path, entries, PERF_ENTRIES_LEN);
+    if (count < 0) {
+        return 2;
+    }
+
+    int failed = 0;
+
+    for (int index = 0; index < count; index++) {
+        const perf_entry_t *entry = &entries[index];
+        perf_entry_t *result = &results[index];
+
+        huf_error_t err = perf_run(entry, iterations, result);
+        if (err != HUF_ERROR_SUCCESS) {
+            fprintf(stderr, "%s: %s\n", entry->name, huf_error_string(err));
+            return 1;
+        }
+
+        // Allocations don't depend on the machine, so any growth fails.
+        int slow = result->encode_mbps < entry->encode_mbps * (1 - tolerance) ||
+            result->decode_mbps < entry->decode_mbps * (1 - tolerance);
+        int alloc = result->allocations > entry->allocations;
+
+        if (!update && (slow || alloc)) {
+            failed++;
+        }
+
+        printf("%-4s %-16s encode %8.2f MB/s (baseline %8.2f)  "
+                "decode %8.2f MB/s (baseline %8.2f)  allocations %zu (baseline %zu)\n",
+                update ? "" : (slow || alloc) ? "FAIL" : "ok", entry->name,
+                result->encode_mbps, entry->encode_mbps,
+                result->decode_mbps, entry->decode_mbps,
+                result->allocations, entry->allocations);
+        fflush(stdout);
+    }
+
+    if (update) {
+        return write_baseline(path, results, count) ? 1 : 0;
+    }
+
+    if (failed) {
+        printf("%d of %d benchmarks regressed, tolerance %.2f\n", failed, count, tolerance);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,631 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <huffman.h>
+#include <huffman/histogram.h>
+#include <huffman/kernel.h>
+#include <huffman/tree.h>
+
+#include "corpus.h"
+#include "counter.h"
+
+
+// Maximum count of the values of the list options.
+#define STAGES_LIST_LEN 16
+
+
+// stage_context_t holds the input and the intermediate results of
+// the encoding, so each stage is measured in isolation.
+typedef struct stage_context {
+    // Data to encode.
+    const uint8_t *data;
+    size_t length;
+
+    // Kernels used to encode and decode the data.
+    const huf_kernels_t *kernels;
+
+    // Frequencies of the data, and their copy used to restore
+    // the histogram consumed by the tree construction.
+    huf_histogram_t *histogram;
+    uint64_t frequencies[HUF_HISTOGRAM_LEN];
+    size_t start;
+
+    // Huffman tree of the data.
+    huf_tree_t *tree;
+
+    // Tree rebuilt by the measured stages.
+    huf_tree_t *scratch_tree;
+
+    // Serialized Huffman tree.
+    int16_t tree_head[HUF_BTREE_LEN];
+    size_t tree_length;
+
+    // Packed codes of the symbols.
+    huf_code_t codes[HUF_ASCII_COUNT];
+    size_t max_length;
+
+    // Decoding table of the tree.
+    huf_decode_table_t table;
+
+    // Encoded and decoded data.
+    uint8_t *encoded;
+    size_t encoded_length;
+    uint8_t *decoded;
+} stage_context_t;
+
+
+// stage_t is a measured stage of the encoding or decoding.
+typedef struct stage {
+    // Name of the stage.
+    const char *name;
+
+    // Prepare the context for the next run, the preparation
+    // is not measured. Nil, when there is nothing to prepare.
+    huf_error_t (*prepare)(stage_context_t *ctx);
+
+    // Run the stage once.
+    huf_error_t (*run)(stage_context_t *ctx);
+
+    // Non-zero, when the stage runs the kernels, so it is
+    // measured for each of the selected kernels.
+    int kernel;
+} stage_t;
+
+
+// Names of the kernels in the order of huf_kernels_kind_t.
+static const char *kernels_names[] = {"portable", "bmi2"};
+
+#define KERNELS_COUNT (sizeof(kernels_names) / sizeof(*kernels_names))
+
+
+// Count the bytes with the histogram kernel directly, so the
+// stage is measured for each of the kernels.
+static huf_error_t
+stage_histogram(stage_context_t *ctx)
+{
+    huf_error_t err = huf_histogram_reset(ctx->histogram);
+    if (err != HUF_ERROR_SUCCESS) {
+        return err;
+    }
+
+    huf_histogram_t *histogram = ctx->histogram;
+    ctx->kernels->histogram(histogram->frequencies, ctx->data, ctx->length);
+
+    // Find the first non-zero frequency the same way as the histogram.
+    for (size_t element = 0; element < HUF_ASCII_COUNT; element++) {
+        if (histogram->frequencies[element]) {
+            histogram->start = element;
+            break;
+        }
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+// Restore the histogram consumed by the previous tree construction.
+static huf_error_t
+stage_tree_prepare(stage_context_t *ctx)
+{
+    memcpy(ctx->histogram->frequencies, ctx->frequencies, sizeof(ctx->frequencies));
+    ctx->histogram->start = ctx->start;
+
+    return huf_tree_reset(ctx->scratch_tree);
+}
+
+
+static huf_error_t
+stage_tree(stage_context_t *ctx)
+{
+    return huf_tree_from_histogram(ctx->scratch_tree, ctx->histogram);
+}
+
+
+// Build the packed codes of the symbols the same way as the encoder.
+static huf_error_t
+stage_codes(stage_context_t *ctx)
+{
+    uint8_t coding[HUF_1KIB_BUFFER];
+
+    ctx->max_length = 0;
+
+    for (size_t index = 0; index < HUF_ASCII_COUNT; index++) {
+        const huf_node_t *node = ctx->tree->leaves[index];
+        size_t position = sizeof(coding);
+
+        if (!node) {
+            continue;
+        }
+
+        huf_error_t err = huf_node_to_string(node, coding, &position);
+        if (err != HUF_ERROR_SUCCESS) {
+            return err;
+        }
+
+        if (position > ctx->max_length) {
+            ctx->max_length = position;
+        }
+
+        if (position <= HUF_KERNEL_CODE_LEN) {
+            uint64_t bits = 0;
+
+            for (size_t bit = position; bit > 0; bit--) {
+                bits = (bits << 1) | (coding[bit - 1] & 1);
+            }
+
+            ctx->codes[index].bits = bits << (64 - position);
+            ctx->codes[index].length = position;
+        }
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+static huf_error_t
+stage_serialize(stage_context_t *ctx)
+{
+    return huf_tree_serialize(ctx->tree, ctx->tree_head, &ctx->tree_length);
+}
+
+
+static huf_error_t
+stage_deserialize_prepare(stage_context_t *ctx)
+{
+    return huf_tree_reset(ctx->scratch_tree);
+}
+
+
+static huf_error_t
+stage_deserialize(stage_context_t *ctx)
+{
+    return huf_tree_deserialize(ctx->scratch_tree, ctx->tree_head, ctx->tree_length);
+}
+
+
+static huf_error_t
+stage_table(stage_context_t *ctx)
+{
+    return huf_decode_table_init(&ctx->table, ctx->tree);
+}
+
+
+static huf_error_t
+stage_encode(stage_context_t *ctx)
+{
+    huf_bit_writer_t writer = {0, 0};
+
+    ctx->encoded_length = ctx->kernels->encode(&writer, ctx->codes,
+            ctx->data, ctx->length, ctx->encoded);
+
+    // Pad the incomplete byte with zeros.
+    if (writer.count) {
+        ctx->encoded[ctx->encoded_length++] = writer.bits >> 56;
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+static huf_error_t
+stage_decode(stage_context_t *ctx)
+{
+    huf_bit_reader_t reader;
+
+    huf_bit_reader_init(&reader, ctx->encoded, ctx->encoded_length);
+
+    return ctx->kernels->decode(&reader, &ctx->table, ctx->tree->root,
+            ctx->decoded, ctx->length);
+}
+
+
+static const stage_t stages[] = {
+    {"histogram", NULL, stage_histogram, 1},
+    {"tree", stage_tree_prepare, stage_tree, 0},
+    {"codes", NULL, stage_codes, 0},
+    {"serialize", NULL, stage_serialize, 0},
+    {"deserialize", stage_deserialize_prepare, stage_deserialize, 0},
+    {"table", NULL, stage_table, 0},
+    {"encode", NULL, stage_encode, 1},
+    {"decode", NULL, stage_decode, 1},
+};
+
+
+// Release memory occupied by the context.
+static void
+stage_context_free(stage_context_t *ctx)
+{
+    if (ctx->histogram) {
+        huf_histogram_free(&ctx->histogram);
+    }
+
+    if (ctx->tree) {
+        huf_tree_free(&ctx->tree);
+    }
+
+    if (ctx->scratch_tree) {
+        huf_tree_free(&ctx->scratch_tree);
+    }
+
+    free(ctx->encoded);
+    free(ctx->decoded);
+}
+
+
+// Run all stages once to fill the context with the results of the
+// stages, that are the input of the following stages.
+static huf_error_t
+stage_context_init(stage_context_t *ctx, const uint8_t *data, size_t length)
+{
+    huf_error_t err;
+
+    memset(ctx, 0, sizeof(*ctx));
+
+    ctx->data = data;
+    ctx->length = length;
+    ctx->kernels = huf_kernels_default();
+
+    if ((err = huf_histogram_init(&ctx->histogram, 1, HUF_HISTOGRAM_LEN)) ||
+            (err = huf_tree_init(&ctx->tree)) ||
+            (err = huf_tree_init(&ctx->scratch_tree)) ||
+            (err = stage_histogram(ctx))) {
+        return err;
+    }
+
+    memcpy(ctx->frequencies, ctx->histogram->frequencies, sizeof(ctx->frequencies));
+    ctx->start = ctx->histogram->start;
+
+    if ((err = huf_tree_from_histogram(ctx->tree, ctx->histogram)) ||
+            (err = stage_codes(ctx)) ||
+            (err = stage_serialize(ctx)) ||
+            (err = stage_table(ctx))) {
+        return err;
+    }
+
+    // Codes of the kernels are limited in length.
+    if (ctx->max_length > HUF_KERNEL_CODE_LEN) {
+        return HUF_ERROR_FATAL;
+    }
+
+    ctx->encoded = malloc(length / 8 * ctx->max_length + ctx->max_length + 16);
+    ctx->decoded = malloc(length + 1);
+
+    if (!ctx->encoded || !ctx->decoded) {
+        return HUF_ERROR_MEMORY_ALLOCATION;
+    }
+
+    if ((err = stage_encode(ctx)) || (err = stage_decode(ctx))) {
+        return err;
+    }
+
+    if (memcmp(ctx->decoded, data, length)) {
+        return HUF_ERROR_BLOCK_CORRUPTED;
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+// Run the stage the specified count of times and return the total
+// cost of the runs. The preparation of the stage is excluded.
+static huf_error_t
+stage_measure(const stage_t *stage, stage_context_t *ctx, int fd,
+        size_t calls, counter_sample_t *cost)
+{
+    huf_error_t err = HUF_ERROR_SUCCESS;
+    counter_sample_t begin, end;
+
+    cost->ns = 0;
+    cost->cycles = 0;
+
+    if (!stage->prepare) {
+        begin = counter_read(fd);
+
+        for (size_t call = 0; call < calls && !err; call++) {
+            err = stage->run(ctx);
+        }
+
+        end = counter_read(fd);
+
+        cost->ns = end.ns - begin.ns;
+        cost->cycles = end.cycles - begin.cycles;
+
+        return err;
+    }
+
+    for (size_t call = 0; call < calls && !err; call++) {
+        if ((err = stage->prepare(ctx)) != HUF_ERROR_SUCCESS) {
+            break;
+        }
+
+        begin = counter_read(fd);
+        err = stage->run(ctx);
+        end = counter_read(fd);
+
+        cost->ns += end.ns - begin.ns;
+        cost->cycles += end.cycles - begin.cycles;
+    }
+
+    return err;
+}
+
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -c LIST  corpora: text,skewed,uniform,zeros,samples (default: text)\n"
+        "  -n LIST  lengths of the input in bytes (default: 1024,16384,262144,4194304)\n"
+        "  -s LIST  stages: histogram,tree,codes,serialize,deserialize,table,\n"
+        "           encode,decode (default: all)\n"
+        "  -k LIST  kernels: portable,bmi2 (default: all supported)\n"
+        "  -t MSEC  duration of each measured batch (default: 20)\n"
+        "  -r NUM   count of the batches, the cheapest is reported (default: 5)\n"
+        "  -S NUM   seed of the corpus generator (default: 1)\n"
+        "\n"
+        "Each result is printed as a JSON object on a separate line, the\n"
+        "cycles are null when perf_event_open is not available. The stages\n"
+        "running the kernels are measured for each selected kernel, the\n"
+        "kernel of other stages is null.\n",
+        name);
+}
+
+
+// Parse the comma-separated list of numbers, returns the
+// count of the numbers or zero on failure.
+static size_t
+parse_numbers(const char *arg, uint64_t *values, size_t len)
+{
+    size_t count = 0;
+    char *end = NULL;
+
+    while (*arg && count < len) {
+        values[count++] = strtoull(arg, &end, 0);
+
+        if (end == arg || (*end && *end != ',')) {
+            return 0;
+        }
+
+        arg = *end ? end + 1 : end;
+    }
+
+    return *arg ? 0 : count;
+}
+
+
+// Parse the comma-separated list of names, the bit of each found name
+// is set in the returned mask, zero is returned on failure.
+static uint32_t
+parse_names(const char *arg, const char *(*name)(size_t), size_t count)
+{
+    uint32_t mask = 0;
+
+    while (*arg) {
+        size_t len = strcspn(arg, ",");
+        size_t index = 0;
+
+        while (index < count && (strlen(name(index)) != len ||
+                    strncmp(name(index), arg, len))) {
+            index++;
+        }
+
+        if (index == count) {
+            return 0;
+        }
+
+        mask |= (uint32_t)1 << index;
+
+        arg += len;
+        arg += *arg == ',';
+    }
+
+    return mask;
+}
+
+
+static const char*
+corpus_at(size_t index)
+{
+    return corpus_name((corpus_t)index);
+}
+
+
+static const char*
+stage_at(size_t index)
+{
+    return stages[index].name;
+}
+
+
+static const char*
+kernel_at(size_t index)
+{
+    return kernels_names[index];
+}
+
+
+// Measure the stage in batches and print the cost of the cheapest batch.
+static huf_error_t
+stage_report(const stage_t *stage, stage_context_t *ctx, int fd,
+        uint64_t batch_ns, size_t batches, const char *corpus)
+{
+    huf_error_t err;
+    counter_sample_t cost, best = {0, 0};
+
+    // Size the batch to run for the requested duration.
+    if ((err = stage_measure(stage, ctx, fd, 1, &cost))) {
+        return err;
+    }
+
+    size_t calls = cost.ns ? batch_ns / cost.ns : batch_ns;
+    if (!calls) {
+        calls = 1;
+    }
+
+    for (size_t batch = 0; batch < batches && !err; batch++) {
+        err = stage_measure(stage, ctx, fd, calls, &cost);
+
+        if (!batch || cost.ns < best.ns) {
+            best = cost;
+        }
+    }
+
+    if (err) {
+        return err;
+    }
+
+    double ns = (double)best.ns / calls;
+
+    printf("{\"stage\": \"%s\", ", stage->name);
+
+    if (stage->kernel) {
+        printf("\"kernel\": \"%s\", ", kernels_names[ctx->kernels->kind]);
+    } else {
+        printf("\"kernel\": null, ");
+    }
+
+    printf("\"corpus\": \"%s\", \"length\": %zu, "
+            "\"calls\": %zu, \"ns_per_call\": %.1f, ",
+            corpus, ctx->length, calls, ns);
+
+    if (fd >= 0) {
+        printf("\"cycles_per_call\": %.1f, ", (double)best.cycles / calls);
+    } else {
+        printf("\"cycles_per_call\": null, ");
+    }
+
+    printf("\"mbps\": %.2f}\n", ns > 0 ? ctx->length / ns * 1e3 : 0);
+    fflush(stdout);
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+int main(int argc, char **argv)
+{
+    const size_t stages_len = sizeof(stages) / sizeof(*stages);
+
+    uint64_t lengths[STAGES_LIST_LEN] = {1024, 16384, 262144, 4194304};
+    size_t lengths_len = 4;
+
+    uint32_t corpora = 1 << CORPUS_TEXT;
+    uint32_t stage_mask = ((uint32_t)1 << stages_len) - 1;
+    uint32_t kernel_mask = ((uint32_t)1 << KERNELS_COUNT) - 1;
+
+    uint64_t batch_ns = 20000000;
+    size_t batches = 5;
+    uint64_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:s:k:t:r:S:h")) != -1) {
+        int valid = 1;
+
+        switch (opt) {
+        case 'c':
+            corpora = parse_names(optarg, corpus_at, CORPUS_COUNT);
+            valid = corpora != 0;
+            break;
+        case 'n':
+            lengths_len = parse_numbers(optarg, lengths, STAGES_LIST_LEN);
+            valid = lengths_len > 0;
+            break;
+        case 's':
+            stage_mask = parse_names(optarg, stage_at, stages_len);
+            valid = stage_mask != 0;
+            break;
+        case 'k':
+            kernel_mask = parse_names(optarg, kernel_at, KERNELS_COUNT);
+            valid = kernel_mask != 0;
+            break;
+        case 't':
+            batch_ns = strtoull(optarg, NULL, 0) * 1000000;
+            valid = batch_ns > 0;
+            break;
+        case 'r':
+            batches = strtoull(optarg, NULL, 0);
+            valid = batches > 0;
+            break;
+        case 'S':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            valid = 0;
+            break;
+        }
+
+        if (!valid) {
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    int fd = counter_open();
+
+    for (size_t corpus = 0; corpus < CORPUS_COUNT; corpus++) {
+        if (!(corpora & (1 << corpus))) {
+            continue;
+        }
+
+        for (size_t pos = 0; pos < lengths_len; pos++) {
+            size_t length = lengths[pos];
+            stage_context_t ctx;
+
+            uint8_t *data = malloc(length + 1);
+            if (!data) {
+                fprintf(stderr, "%s\n", huf_error_string(HUF_ERROR_MEMORY_ALLOCATION));
+                return 1;
+            }
+
+            corpus_fill((corpus_t)corpus, data, length, seed);
+
+            huf_error_t err = stage_context_init(&ctx, data, length);
+
+            for (size_t index = 0; index < stages_len && !err; index++) {
+                const stage_t *stage = &stages[index];
+
+                if (!(stage_mask & (1 << index))) {
+                    continue;
+                }
+
+                if (!stage->kernel) {
+                    err = stage_report(stage, &ctx, fd, batch_ns, batches,
+                            corpus_name((corpus_t)corpus));
+                    continue;
+                }
+
+                // Kernels not supported by the processor are skipped.
+                for (size_t kind = 0; kind < KERNELS_COUNT && !err; kind++) {
+                    const huf_kernels_t *kernels = huf_kernels_lookup(kind);
+
+                    if (!(kernel_mask & (1 << kind)) || !kernels) {
+                        continue;
+                    }
+
+                    ctx.kernels = kernels;
+                    err = stage_report(stage, &ctx, fd, batch_ns, batches,
+                            corpus_name((corpus_t)corpus));
+                }
+
+                ctx.kernels = huf_kernels_default();
+            }
+
+            stage_context_free(&ctx);
+            free(data);
+
+            if (err) {
+                fprintf(stderr, "%s: %s\n", corpus_name((corpus_t)corpus),
+                        huf_error_string(err));
+                counter_close(fd);
+                return 1;
+            }
+        }
+    }
+
+    counter_close(fd);
+
+    return 0;
+}
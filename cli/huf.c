@@ -0,0 +1,817 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <huffman.h>
+
+
+// Suffix of the compressed files.
+#define CLI_SUFFIX ".hm"
+
+// Count of the blocks encoded by each thread at once, the encoded
+// blocks of the chunk are wrapped into a frame.
+#define CLI_CHUNK_BLOCKS 16
+
+// Maximum count of the encoding threads.
+#define CLI_THREADS_MAX 256
+
+
+// cli_mode_t is the operation of the tool.
+typedef enum {
+    CLI_COMPRESS,
+    CLI_DECOMPRESS,
+    CLI_TEST,
+    CLI_BENCH,
+} cli_mode_t;
+
+
+// cli_level_t is a preset of the encoder parameters.
+typedef struct cli_level {
+    // Size of the encoding block.
+    uint64_t blocksize;
+
+    // Count of the interleaved streams.
+    size_t streams;
+} cli_level_t;
+
+
+// Larger blocks are encoded faster, and the interleaved streams are
+// decoded faster, while smaller blocks adapt to the local statistics
+// of the data at the cost of more trees.
+static const cli_level_t levels[] = {
+    {0, 0},
+    {HUF_1MIB_BUFFER, HUF_INTERLEAVED_STREAMS},
+    {HUF_256KIB_BUFFER, 0},
+    {HUF_64KIB_BUFFER, 0},
+};
+
+#define CLI_LEVEL_MAX (sizeof(levels) / sizeof(*levels) - 1)
+#define CLI_LEVEL_DEFAULT 2
+
+
+// cli_options_t holds parameters of the tool.
+typedef struct cli_options {
+    cli_mode_t mode;
+
+    // Write the output to the standard output.
+    int to_stdout;
+
+    // Overwrite the existing files and write to the terminal.
+    int force;
+
+    // Print the timing of each file.
+    int verbose;
+
+    // Name of the output file.
+    const char *output;
+
+    // Size of the encoding block, zero to use the level preset.
+    uint64_t blocksize;
+
+    // Size of the reader and writer buffers.
+    size_t buffer_size;
+
+    // Count of the encoding threads.
+    size_t threads;
+
+    // Preset of the encoder parameters.
+    size_t level;
+
+    // Count of the measured runs of the benchmark.
+    size_t iterations;
+} cli_options_t;
+
+
+// cli_span_t is a read-only stream of the memory buffer, which is
+// mapped by the encoder, so the data is not copied.
+typedef struct cli_span {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+} cli_span_t;
+
+
+// cli_chunk_t is a part of the input encoded by a single thread.
+typedef struct cli_chunk {
+    // Data of the chunk.
+    uint8_t *data;
+    size_t len;
+
+    // Encoded data of the chunk.
+    huf_read_writer_t *encoded;
+    void *encoded_buf;
+
+    // Configuration of the encoder.
+    const cli_options_t *options;
+
+    // Result of the encoding.
+    huf_error_t err;
+    pthread_t thread;
+} cli_chunk_t;
+
+
+// cli_result_t holds the measurements of the single file.
+typedef struct cli_result {
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    double seconds;
+} cli_result_t;
+
+
+static const char *program = "huf";
+
+
+static void
+usage(void)
+{
+    fprintf(stderr,
+        "Usage: %s [options] [FILE...]\n"
+        "Compress or decompress the files, or the standard input when no file\n"
+        "is specified or the file is '-'. Compressed files get the %s suffix.\n"
+        "\n"
+        "  -d       decompress\n"
+        "  -t       test the integrity of the compressed files\n"
+        "  -b       benchmark the compression and decompression of the files\n"
+        "  -c       write to the standard output\n"
+        "  -o FILE  write to the file\n"
+        "  -f       overwrite the output files, write compressed data to the terminal\n"
+        "  -v       print the timing of each file\n"
+        "  -l NUM   level from 1 (largest interleaved blocks) to %zu (smallest blocks),\n"
+        "           (default: %d)\n"
+        "  -B SIZE  size of the encoding block, overrides the level\n"
+        "  -r SIZE  size of the reader and writer buffers (default: 64K)\n"
+        "  -T NUM   count of the compression threads (default: 1)\n"
+        "  -i NUM   count of the benchmark runs, the fastest is reported (default: 3)\n"
+        "\n"
+        "Sizes accept K, M and G suffixes.\n",
+        program, CLI_SUFFIX, CLI_LEVEL_MAX, CLI_LEVEL_DEFAULT);
+}
+
+
+// Return the current time in seconds.
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// Parse the size with an optional K, M or G suffix, returns
+// zero when the size is malformed.
+static uint64_t
+parse_size(const char *arg)
+{
+    char *end = NULL;
+    uint64_t size = strtoull(arg, &end, 0);
+
+    if (end == arg) {
+        return 0;
+    }
+
+    switch (*end) {
+    case 'K': case 'k':
+        size <<= 10;
+        end++;
+        break;
+    case 'M': case 'm':
+        size <<= 20;
+        end++;
+        break;
+    case 'G': case 'g':
+        size <<= 30;
+        end++;
+        break;
+    }
+
+    return *end ? 0 : size;
+}
+
+
+static huf_error_t
+span_read(void *stream, void *buf, size_t *count)
+{
+    cli_span_t *span = stream;
+    size_t len = span->len - span->pos;
+
+    if (*count < len) {
+        len = *count;
+    }
+
+    memcpy(buf, span->buf + span->pos, len);
+    span->pos += len;
+    *count = len;
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+static huf_error_t
+span_map(void *stream, const void **buf, size_t *count)
+{
+    cli_span_t *span = stream;
+
+    *buf = span->buf + span->pos;
+    *count = span->len - span->pos;
+    span->pos = span->len;
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+// Discard the written data, used to test the integrity.
+static huf_error_t
+discard_write(void *stream, const void *buf, size_t count)
+{
+    return HUF_ERROR_SUCCESS;
+}
+
+
+// Return the encoder configuration of the options.
+static huf_config_t
+make_config(const cli_options_t *options)
+{
+    huf_config_t config = {
+        .blocksize = levels[options->level].blocksize,
+        .streams = levels[options->level].streams,
+        .reader_buffer_size = options->buffer_size,
+        .writer_buffer_size = options->buffer_size,
+    };
+
+    if (options->blocksize) {
+        config.blocksize = options->blocksize;
+    }
+
+    return config;
+}
+
+
+// Encode the chunk into the frame, runs in the encoding thread.
+static void*
+encode_chunk(void *arg)
+{
+    cli_chunk_t *chunk = arg;
+    cli_span_t span = {chunk->data, chunk->len, 0};
+
+    huf_read_writer_t reader = {
+        .stream = &span,
+        .read = span_read,
+        .map = span_map,
+    };
+
+    huf_config_t config = make_config(chunk->options);
+    config.length = chunk->len;
+    config.frame = 1;
+    config.reader = &reader;
+    config.writer = chunk->encoded;
+
+    chunk->err = huf_memrewind(chunk->encoded);
+    if (chunk->err == HUF_ERROR_SUCCESS) {
+        chunk->err = huf_encode(&config);
+    }
+
+    return NULL;
+}
+
+
+// Read as many bytes as possible into the buffer, the length is
+// less than requested only at the end of the reader.
+static huf_error_t
+read_full(huf_read_writer_t *reader, uint8_t *buf, size_t cap, size_t *len)
+{
+    huf_error_t err = HUF_ERROR_SUCCESS;
+    *len = 0;
+
+    while (*len < cap) {
+        size_t count = cap - *len;
+
+        err = reader->read(reader->stream, buf + *len, &count);
+        if (err != HUF_ERROR_SUCCESS || !count) {
+            break;
+        }
+
+        *len += count;
+    }
+
+    return err;
+}
+
+
+// Compress the reader into the writer. The input is split into chunks,
+// which are encoded by the threads into the separate frames and written
+// in the order of the input, so the length of the input is not needed.
+static huf_error_t
+compress_stream(const cli_options_t *options, huf_read_writer_t *reader,
+        huf_read_writer_t *writer, cli_result_t *result)
+{
+    huf_error_t err = HUF_ERROR_SUCCESS;
+    cli_chunk_t chunks[CLI_THREADS_MAX] = {{0}};
+
+    huf_config_t config = make_config(options);
+    size_t chunk_size = config.blocksize * CLI_CHUNK_BLOCKS;
+    size_t threads = options->threads;
+
+    for (size_t index = 0; index < threads && !err; index++) {
+        chunks[index].options = options;
+        chunks[index].data = malloc(chunk_size);
+
+        if (!chunks[index].data) {
+            err = HUF_ERROR_MEMORY_ALLOCATION;
+            break;
+        }
+
+        err = huf_memopen(&chunks[index].encoded, &chunks[index].encoded_buf,
+                huf_compress_bound(chunk_size));
+    }
+
+    int eof = 0;
+
+    while (!err && !eof) {
+        size_t count = 0;
+
+        // Read the chunk of each thread.
+        for (; count < threads && !eof; count++) {
+            cli_chunk_t *chunk = &chunks[count];
+
+            err = read_full(reader, chunk->data, chunk_size, &chunk->len);
+            if (err != HUF_ERROR_SUCCESS) {
+                break;
+            }
+
+            eof = chunk->len < chunk_size;
+            result->bytes_in += chunk->len;
+
+            // Empty input is encoded as an empty frame, so the
+            // output is recognized as the compressed data.
+            if (!chunk->len && (count || result->bytes_in)) {
+                break;
+            }
+        }
+
+        // The single thread encodes in place.
+        if (count == 1) {
+            encode_chunk(&chunks[0]);
+        } else {
+            for (size_t index = 0; index < count; index++) {
+                if (pthread_create(&chunks[index].thread, NULL, encode_chunk, &chunks[index])) {
+                    chunks[index].err = HUF_ERROR_FATAL;
+                    chunks[index].thread = pthread_self();
+                }
+            }
+
+            for (size_t index = 0; index < count; index++) {
+                if (!pthread_equal(chunks[index].thread, pthread_self())) {
+                    pthread_join(chunks[index].thread, NULL);
+                }
+            }
+        }
+
+        // Write the frames in the order of the input.
+        for (size_t index = 0; index < count && !err; index++) {
+            size_t len = 0;
+
+            err = chunks[index].err;
+            if (err == HUF_ERROR_SUCCESS) {
+                err = huf_memlen(chunks[index].encoded, &len);
+            }
+            if (err == HUF_ERROR_SUCCESS) {
+                err = writer->write(writer->stream, chunks[index].encoded_buf, len);
+            }
+
+            result->bytes_out += len;
+        }
+    }
+
+    for (size_t index = 0; index < threads; index++) {
+        free(chunks[index].data);
+
+        if (chunks[index].encoded) {
+            huf_memclose(&chunks[index].encoded);
+        }
+
+        free(chunks[index].encoded_buf);
+    }
+
+    return err;
+}
+
+
+// Decompress the reader into the writer until the end of the reader.
+static huf_error_t
+decompress_stream(const cli_options_t *options, huf_read_writer_t *reader,
+        huf_read_writer_t *writer, cli_result_t *result)
+{
+    huf_config_t config = {
+        .reader_buffer_size = options->buffer_size,
+        .writer_buffer_size = options->buffer_size,
+        .reader = reader,
+        .writer = writer,
+    };
+
+    huf_stats_t stats = {0};
+    config.stats = &stats;
+
+    huf_error_t err = huf_decode(&config);
+
+    result->bytes_in += stats.bytes_in;
+    result->bytes_out += stats.bytes_out;
+
+    return err;
+}
+
+
+// Read the whole file into the memory.
+static huf_error_t
+read_file(int fd, uint8_t **buf, size_t *len)
+{
+    huf_read_writer_t *reader = NULL;
+    size_t cap = HUF_1MIB_BUFFER;
+
+    huf_error_t err = huf_fdopen(&reader, fd);
+    if (err != HUF_ERROR_SUCCESS) {
+        return err;
+    }
+
+    *buf = NULL;
+    *len = 0;
+
+    for (;;) {
+        uint8_t *grown = realloc(*buf, cap);
+        if (!grown) {
+            err = HUF_ERROR_MEMORY_ALLOCATION;
+            break;
+        }
+
+        *buf = grown;
+
+        size_t count = 0;
+        err = read_full(reader, *buf + *len, cap - *len, &count);
+
+        *len += count;
+        if (err != HUF_ERROR_SUCCESS || *len < cap) {
+            break;
+        }
+
+        cap *= 2;
+    }
+
+    huf_fdclose(&reader);
+
+    return err;
+}
+
+
+// Compress and decompress the data in memory, and print the fastest run.
+static huf_error_t
+bench_file(const cli_options_t *options, const char *name, int fd)
+{
+    huf_read_writer_t *encoded = NULL, *decoded = NULL;
+    void *encoded_buf = NULL, *decoded_buf = NULL;
+    uint8_t *data = NULL;
+    size_t len = 0, encoded_len = 0, decoded_len = 0;
+
+    double encode_seconds = 0, decode_seconds = 0;
+
+    huf_error_t err = read_file(fd, &data, &len);
+    if (err != HUF_ERROR_SUCCESS) {
+        goto cleanup;
+    }
+
+    if ((err = huf_memopen(&encoded, &encoded_buf, huf_compress_bound(len))) ||
+            (err = huf_memopen(&decoded, &decoded_buf, len + 1))) {
+        goto cleanup;
+    }
+
+    for (size_t index = 0; index < options->iterations && !err; index++) {
+        cli_span_t span = {data, len, 0};
+        huf_read_writer_t reader = {.stream = &span, .read = span_read};
+        cli_result_t result = {0};
+
+        if ((err = huf_memrewind(encoded)) != HUF_ERROR_SUCCESS) {
+            break;
+        }
+
+        double start = now();
+
+        if ((err = compress_stream(options, &reader, encoded, &result))) {
+            break;
+        }
+
+        double elapsed = now() - start;
+        if (!index || elapsed < encode_seconds) {
+            encode_seconds = elapsed;
+        }
+    }
+
+    if (err || (err = huf_memlen(encoded, &encoded_len))) {
+        goto cleanup;
+    }
+
+    for (size_t index = 0; index < options->iterations && !err; index++) {
+        cli_span_t span = {encoded_buf, encoded_len, 0};
+        huf_read_writer_t reader = {.stream = &span, .read = span_read, .map = span_map};
+        cli_result_t result = {0};
+
+        if ((err = huf_memrewind(decoded)) != HUF_ERROR_SUCCESS) {
+            break;
+        }
+
+        double start = now();
+
+        if ((err = decompress_stream(options, &reader, decoded, &result))) {
+            break;
+        }
+
+        double elapsed = now() - start;
+        if (!index || elapsed < decode_seconds) {
+            decode_seconds = elapsed;
+        }
+    }
+
+    if (err || (err = huf_memlen(decoded, &decoded_len))) {
+        goto cleanup;
+    }
+
+    // Validate the decoded data, so broken changes are not measured.
+    if (decoded_len != len || memcmp(decoded_buf, data, len)) {
+        err = HUF_ERROR_BLOCK_CORRUPTED;
+        goto cleanup;
+    }
+
+    fprintf(stderr, "%s: %zu -> %zu (%.2f%%), compress %.1f MB/s, decompress %.1f MB/s\n",
+            name, len, encoded_len, len ? 100.0 * encoded_len / len : 0,
+            encode_seconds > 0 ? len / encode_seconds / 1e6 : 0,
+            decode_seconds > 0 ? len / decode_seconds / 1e6 : 0);
+
+cleanup:
+    if (encoded) {
+        huf_memclose(&encoded);
+    }
+
+    if (decoded) {
+        huf_memclose(&decoded);
+    }
+
+    free(encoded_buf);
+    free(decoded_buf);
+    free(data);
+
+    return err;
+}
+
+
+// Return the name of the output file, or nil when the output is the
+// standard output. The returned name should be released.
+static char*
+output_name(const cli_options_t *options, const char *input, int *failed)
+{
+    *failed = 0;
+
+    if (options->to_stdout || options->mode == CLI_TEST ||
+            options->mode == CLI_BENCH || !input) {
+        return NULL;
+    }
+
+    if (options->output) {
+        return strdup(options->output);
+    }
+
+    size_t len = strlen(input);
+    size_t suffix_len = strlen(CLI_SUFFIX);
+
+    if (options->mode == CLI_COMPRESS) {
+        char *name = malloc(len + suffix_len + 1);
+        if (name) {
+            memcpy(name, input, len);
+            memcpy(name + len, CLI_SUFFIX, suffix_len + 1);
+        }
+
+        return name;
+    }
+
+    if (len <= suffix_len || strcmp(input + len - suffix_len, CLI_SUFFIX)) {
+        fprintf(stderr, "%s: %s: unknown suffix, use -o or -c\n", program, input);
+        *failed = 1;
+        return NULL;
+    }
+
+    return strndup(input, len - suffix_len);
+}
+
+
+// Process the single file, the nil name means the standard input.
+static int
+process_file(const cli_options_t *options, const char *input)
+{
+    huf_read_writer_t *reader = NULL, *writer = NULL;
+    huf_read_writer_t discard = {.write = discard_write};
+    cli_result_t result = {0};
+    huf_error_t err = HUF_ERROR_SUCCESS;
+
+    int in_fd = STDIN_FILENO, out_fd = STDOUT_FILENO;
+    int failed = 0;
+
+    const char *name = input ? input : "(stdin)";
+
+    char *output = output_name(options, input, &failed);
+    if (failed) {
+        return 1;
+    }
+
+    if (input && (in_fd = open(input, O_RDONLY)) < 0) {
+        fprintf(stderr, "%s: %s: %s\n", program, input, strerror(errno));
+        free(output);
+        return 1;
+    }
+
+    if (options->mode == CLI_BENCH) {
+        err = bench_file(options, name, in_fd);
+        goto cleanup;
+    }
+
+    if (output) {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | (options->force ? 0 : O_EXCL);
+
+        if ((out_fd = open(output, flags, 0644)) < 0) {
+            fprintf(stderr, "%s: %s: %s\n", program, output, strerror(errno));
+            failed = 1;
+            goto cleanup;
+        }
+    } else if (options->mode == CLI_COMPRESS && !options->force && isatty(out_fd)) {
+        fprintf(stderr, "%s: compressed data not written to the terminal, use -f\n",
+                program);
+        failed = 1;
+        goto cleanup;
+    }
+
+    if ((err = huf_fdopen(&reader, in_fd)) != HUF_ERROR_SUCCESS) {
+        goto cleanup;
+    }
+
+    if (options->mode != CLI_TEST && (err = huf_fdopen(&writer, out_fd))) {
+        goto cleanup;
+    }
+
+    double start = now();
+
+    switch (options->mode) {
+    case CLI_COMPRESS:
+        err = compress_stream(options, reader, writer, &result);
+        break;
+    case CLI_DECOMPRESS:
+        err = decompress_stream(options, reader, writer, &result);
+        break;
+    case CLI_TEST:
+        err = decompress_stream(options, reader, &discard, &result);
+        break;
+    default:
+        break;
+    }
+
+    result.seconds = now() - start;
+
+    if (err == HUF_ERROR_SUCCESS && options->mode == CLI_TEST) {
+        fprintf(stderr, "%s: OK\n", name);
+    }
+
+    // The throughput is measured on the uncompressed data.
+    if (err == HUF_ERROR_SUCCESS && options->verbose) {
+        uint64_t len = options->mode == CLI_COMPRESS ? result.bytes_in : result.bytes_out;
+
+        fprintf(stderr, "%s: %llu -> %llu bytes in %.3f s, %.1f MB/s\n", name,
+                (unsigned long long)result.bytes_in, (unsigned long long)result.bytes_out,
+                result.seconds, result.seconds > 0 ? len / result.seconds / 1e6 : 0);
+    }
+
+cleanup:
+    if (reader) {
+        huf_fdclose(&reader);
+    }
+
+    if (writer) {
+        huf_fdclose(&writer);
+    }
+
+    if (input) {
+        close(in_fd);
+    }
+
+    if (output && out_fd >= 0) {
+        if (close(out_fd) && !err && !failed) {
+            fprintf(stderr, "%s: %s: %s\n", program, output, strerror(errno));
+            failed = 1;
+        }
+
+        // Remove the incomplete output.
+        if (err || failed) {
+            unlink(output);
+        }
+    }
+
+    if (err != HUF_ERROR_SUCCESS) {
+        fprintf(stderr, "%s: %s: %s\n", program, name, huf_error_string(err));
+        failed = 1;
+    }
+
+    free(output);
+
+    return failed;
+}
+
+
+int main(int argc, char **argv)
+{
+    cli_options_t options = {
+        .mode = CLI_COMPRESS,
+        .buffer_size = HUF_64KIB_BUFFER,
+        .threads = 1,
+        .level = CLI_LEVEL_DEFAULT,
+        .iterations = 3,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "dtbco:fvl:B:r:T:i:h")) != -1) {
+        int valid = 1;
+
+        switch (opt) {
+        case 'd':
+            options.mode = CLI_DECOMPRESS;
+            break;
+        case 't':
+            options.mode = CLI_TEST;
+            break;
+        case 'b':
+            options.mode = CLI_BENCH;
+            break;
+        case 'c':
+            options.to_stdout = 1;
+            break;
+        case 'o':
+            options.output = optarg;
+            break;
+        case 'f':
+            options.force = 1;
+            break;
+        case 'v':
+            options.verbose = 1;
+            break;
+        case 'l':
+            options.level = strtoull(optarg, NULL, 0);
+            valid = options.level >= 1 && options.level <= CLI_LEVEL_MAX;
+            break;
+        case 'B':
+            options.blocksize = parse_size(optarg);
+            valid = options.blocksize > 0 && options.blocksize <= HUF_COMPRESS_BLOCKSIZE;
+            break;
+        case 'r':
+            options.buffer_size = parse_size(optarg);
+            valid = options.buffer_size > 0;
+            break;
+        case 'T':
+            options.threads = strtoull(optarg, NULL, 0);
+            valid = options.threads >= 1 && options.threads <= CLI_THREADS_MAX;
+            break;
+        case 'i':
+            options.iterations = strtoull(optarg, NULL, 0);
+            valid = options.iterations > 0;
+            break;
+        default:
+            valid = 0;
+            break;
+        }
+
+        if (!valid) {
+            usage();
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    // Single output could not be shared by several files.
+    if (options.output && argc - optind > 1) {
+        fprintf(stderr, "%s: -o requires a single file\n", program);
+        return 2;
+    }
+
+    if (optind == argc) {
+        return process_file(&options, NULL);
+    }
+
+    int failed = 0;
+
+    for (int index = optind; index < argc; index++) {
+        const char *input = strcmp(argv[index], "-") ? argv[index] : NULL;
+        failed |= process_file(&options, input);
+    }
+
+    return failed;
+}
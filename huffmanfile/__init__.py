@@ -7,5 +7,9 @@ __all__ = [
     "HuffmanCompressor",
     "HuffmanDecompressor",
     "compress",
+    "compress_bound",
+    "compress_into",
     "decompress",
+    "decompress_into",
+    "open",
 ]
@@ -5,6 +5,10 @@ The interface provided by this module is very similar to that of the :mod:`bz2`
 Note that `HuffmanCompressor`, `HuffmanDecompressor`, and `HuffmanFile` are *not*
 thread-safe, so if you need to use a single instance of these classes from multiple
 threads, it is necessary to protect it with a lock.
+
+The compression functions and classes accept the *threads* argument, then the blocks
+are compressed concurrently by the native threads of the library, and the lock of the
+interpreter is released during the compression.
 """
 
 __all__ = [
@@ -13,11 +17,16 @@ __all__ = [
     "HuffmanCompressor",
     "HuffmanDecompressor",
     "compress",
+    "compress_bound",
+    "compress_into",
     "decompress",
+    "decompress_into",
+    "open",
 ]
 
 import io
 import os
+import sys
 from builtins import open as builtin_open
 
 from ._C import ffi, lib
@@ -26,6 +35,15 @@ from ._C import ffi, lib
 DEFAULT_BLOCK_SIZE = 131072
 DEFAULT_MEM_LIMIT = 262144
 
+# Huffman codes take at least one bit per symbol, so the decompressed data
+# is at most 8 times longer than the compressed data.
+MAX_EXPANSION = 8
+
+# Allocator of the scratch buffers, that are overwritten by the encoder and
+# decoder, so the memory is not cleared, and the pages of the large buffers
+# are not touched until the data is written.
+_scratch_new = ffi.new_allocator(should_clear_after_alloc=False)
+
 
 class HuffmanError(Exception):
     """The exception is raised when error occurs during compression or decompression."""
@@ -37,6 +55,49 @@ def unwrap_exc(err, message):
         raise HuffmanError(f"{err_str.decode('utf-8')}. {message}")
 
 
+def _view(data):
+    """Return the flat byte view of the object supporting the buffer protocol."""
+    view = memoryview(data)
+    if view.format != "B" or view.ndim != 1:
+        view = view.cast("B")
+    return view
+
+
+def _threads_count(threads):
+    """Return the count of the compression threads, all processors by default."""
+    if threads is None or threads <= 0:
+        return os.cpu_count() or 1
+    return threads
+
+
+def _compress_blocks(dst, dst_cap, src, src_len, blocksize, threads=1):
+    """Compress the source pointer into the destination pointer block by block.
+
+    Each block is compressed by the one-shot encoder, so the output is the same
+    as the output of the single stream encoder with the same block size. The blocks
+    are compressed by the specified count of native threads.
+    """
+    if not src_len:
+        return 0
+
+    dst_len = ffi.new("size_t *")
+
+    err = lib.huf_compress_parallel(dst, dst_cap, src, src_len, blocksize, threads,
+                                    dst_len)
+    unwrap_exc(err, "Failed to encode the data")
+
+    return dst_len[0]
+
+
+def _decompress(dst, dst_cap, src, src_len):
+    dst_len = ffi.new("size_t *")
+
+    err = lib.huf_decompress(dst, dst_cap, src, src_len, dst_len)
+    unwrap_exc(err, "Failed to decode the data")
+
+    return dst_len[0]
+
+
 _MODE_CLOSED = 0
 _MODE_READ = 1
 _MODE_WRITE = 2
@@ -53,29 +114,39 @@ class HuffmanFile(io.BufferedIOBase):
     """
 
     def __init__(self, filename, mode="w", blocksize=DEFAULT_BLOCK_SIZE,
-                 memlimit=DEFAULT_MEM_LIMIT):
+                 memlimit=DEFAULT_MEM_LIMIT, threads=1):
         """Open a Huffman-compressed file.
+
+        The file is read by chunks of *memlimit* bytes and decoded block by block,
+        so the memory used by the reader is proportional to the length of the block,
+        rather than to the length of the file.
+
+        The written data is compressed by *threads* native threads, see
+        `HuffmanCompressor` for the description of the argument.
         """
         self._fp = None
         self._mode = _MODE_CLOSED
         self._closefp = False
 
+        self._pos = 0
+
         if mode in ("", "r", "rb"):
             mode = "rb"
             mode_code = _MODE_READ
-            self._decompressor = HuffmanDecompressor(memlimit)
+            self._chunksize = memlimit
+            self._reset_reader()
         elif mode in ("w", "wb"):
             mode = "wb"
             mode_code = _MODE_WRITE
-            self._compressor = HuffmanCompressor(blocksize)
+            self._compressor = HuffmanCompressor(blocksize, threads)
         elif mode in ("x", "xb"):
             mode = "xb"
             mode_code = _MODE_WRITE
-            self._compressor = HuffmanCompressor(blocksize)
+            self._compressor = HuffmanCompressor(blocksize, threads)
         elif mode in ("a", "ab"):
             mode = "ab"
             mode_code = _MODE_WRITE
-            self._compressor = HuffmanCompressor(blocksize)
+            self._compressor = HuffmanCompressor(blocksize, threads)
         else:
             raise ValueError("Invalid mode: %r" % (mode,))
 
@@ -99,8 +170,9 @@ class HuffmanFile(io.BufferedIOBase):
             return
         try:
             if self._mode == _MODE_READ:
-                self._decompressor.close()
-                self._decompressor = None
+                self._decoder = None
+                self._block = None
+                self._block_view = None
             elif self._mode == _MODE_WRITE:
                 self._fp.write(self._compressor.flush())
                 self._compressor = None
@@ -129,7 +201,7 @@ class HuffmanFile(io.BufferedIOBase):
 
     def seekable(self):
         """Return whether the file supports seeking."""
-        return False
+        return self.readable() and self._fp.seekable()
 
     def readable(self):
         """Return whether the file was opened for reading."""
@@ -149,6 +221,69 @@ class HuffmanFile(io.BufferedIOBase):
         if not self.writable():
             raise io.UnsupportedOperation("File not open for writing")
 
+    def _reset_reader(self):
+        self._decoder = _BlockDecoder()
+        self._set_block(bytearray())
+        self._block_pos = 0
+        self._block_len = 0
+        self._pos = 0
+        self._eof = False
+        self._fp_eof = False
+
+    def _set_block(self, block):
+        # The block buffer is replaced rather than resized, so the view is kept.
+        self._block = block
+        self._block_view = memoryview(block)
+
+    def _decode_block(self, out=None, offset=0):
+        """Decode the next block into the *out* buffer or into the block buffer.
+
+        Returns the length of the block, zero at the end of the file, or None when
+        the block does not fit into the *out* buffer.
+        """
+        while True:
+            if out is None:
+                length = self._decoder.decode(self._block, 0, self._fp_eof)
+            else:
+                length = self._decoder.decode(out, offset, self._fp_eof)
+
+            if length:
+                return length
+            if length is not None:
+                # Header of the frame or the empty block.
+                continue
+
+            if self._decoder.need_output:
+                if out is not None:
+                    return None
+                self._set_block(bytearray(self._decoder.need_output))
+            elif self._decoder.need_input:
+                data = self._fp.read(max(self._decoder.need_input, self._chunksize))
+                if data:
+                    self._decoder.feed(data)
+                else:
+                    self._fp_eof = True
+            else:
+                self._eof = True
+                return 0
+
+    def _fill_block(self):
+        """Decode the next block into the block buffer, return False at the end."""
+        if self._eof:
+            return False
+        self._block_len = self._decode_block()
+        self._block_pos = 0
+        return self._block_len > 0
+
+    def _take(self, size):
+        """Return the view of at most size bytes of the current block."""
+        start = self._block_pos
+        stop = min(self._block_len, start + size)
+
+        self._block_pos = stop
+        self._pos += stop - start
+        return self._block_view[start:stop]
+
     def read(self, size=-1):
         """Read up to size uncompressed bytes from the file.
 
@@ -156,10 +291,149 @@ class HuffmanFile(io.BufferedIOBase):
         Returns b"" if the file is already at EOF.
         """
         self._check_can_read()
-        if size < 0:
-            size = io.DEFAULT_BUFFER_SIZE
-        data = self._fp.read(size)
-        return self._decompressor.decompress(data)
+        if size is None or size < 0:
+            size = sys.maxsize
+
+        chunks = []
+        while size > 0:
+            if self._block_pos == self._block_len and not self._fill_block():
+                break
+            chunk = self._take(size)
+            chunks.append(bytes(chunk))
+            size -= len(chunk)
+
+        return b"".join(chunks)
+
+    def read1(self, size=-1):
+        """Read up to size uncompressed bytes, decoding at most a single block.
+
+        Returns b"" if the file is at EOF.
+        """
+        self._check_can_read()
+        if size is None or size < 0:
+            size = sys.maxsize
+
+        if size == 0 or (self._block_pos == self._block_len and not self._fill_block()):
+            return b""
+        return bytes(self._take(size))
+
+    def readinto(self, b):
+        """Read bytes into a pre-allocated, writable bytes-like object b.
+
+        The blocks fitting into the rest of the buffer are decoded directly into
+        it. Returns the number of bytes read (0 for EOF).
+        """
+        self._check_can_read()
+
+        with memoryview(b) as view, view.cast("B") as out:
+            written = 0
+            while written < len(out):
+                if self._block_pos < self._block_len:
+                    chunk = self._take(len(out) - written)
+                    out[written:written+len(chunk)] = chunk
+                    written += len(chunk)
+                    continue
+
+                if self._eof:
+                    break
+
+                length = self._decode_block(out, written)
+                if length is None:
+                    self._fill_block()
+                elif length == 0:
+                    break
+                else:
+                    written += length
+                    self._pos += length
+
+            return written
+
+    def peek(self, size=0):
+        """Return buffered data without advancing the file position.
+
+        At least one byte of data will be returned, unless at EOF. The exact number
+        of bytes returned is unspecified.
+        """
+        self._check_can_read()
+        if self._block_pos == self._block_len and not self._fill_block():
+            return b""
+        return bytes(self._block_view[self._block_pos:self._block_len])
+
+    def readline(self, size=-1):
+        """Read a line of uncompressed bytes from the file.
+
+        The terminating newline (if present) is retained. If size is non-negative,
+        no more than size bytes will be read (in which case the line may be
+        incomplete). Returns b'' if already at EOF.
+        """
+        self._check_can_read()
+        if size is None or size < 0:
+            size = sys.maxsize
+
+        # The line usually ends within the current block.
+        start = self._block_pos
+        end = self._block.find(b"\n", start, min(self._block_len, start + size))
+        if end >= 0:
+            self._block_pos = end + 1
+            self._pos += end + 1 - start
+            return bytes(self._block_view[start:end+1])
+
+        chunks = []
+        while size > 0:
+            if self._block_pos == self._block_len and not self._fill_block():
+                break
+
+            end = self._block.find(b"\n", self._block_pos, self._block_len)
+            length = self._block_len - self._block_pos if end < 0 else end + 1 - self._block_pos
+
+            chunk = self._take(min(length, size))
+            chunks.append(bytes(chunk))
+            size -= len(chunk)
+
+            if end >= 0 and self._block_pos == end + 1:
+                break
+
+        return b"".join(chunks)
+
+    def seek(self, offset, whence=io.SEEK_SET):
+        """Change the file position.
+
+        The new position is specified by offset, relative to the position indicated
+        by whence. Returns the new file position.
+
+        Note that seeking is emulated, so depending on the parameters, this operation
+        may be extremely slow: the backward seek decodes the file from the beginning.
+        """
+        self._check_can_read()
+        if not self.seekable():
+            raise io.UnsupportedOperation("The underlying file object does not support seeking")
+
+        if whence == io.SEEK_CUR:
+            offset = self._pos + offset
+        elif whence == io.SEEK_END:
+            self._take(self._block_len - self._block_pos)
+            while self._fill_block():
+                self._take(self._block_len)
+            offset = self._pos + offset
+        elif whence != io.SEEK_SET:
+            raise ValueError("Invalid value for whence: %r" % (whence,))
+
+        if offset < self._pos:
+            self._fp.seek(0)
+            self._reset_reader()
+
+        # The rest of the block is skipped without copying.
+        while self._pos < offset:
+            if self._block_pos == self._block_len and not self._fill_block():
+                break
+            self._take(offset - self._pos)
+
+        return self._pos
+
+    def tell(self):
+        """Return the current file position."""
+        self._check_not_closed()
+        return self._pos
 
     def write(self, data):
         """Write a byte string to the file.
@@ -178,6 +452,7 @@ class HuffmanFile(io.BufferedIOBase):
 
         compressed = self._compressor.compress(data)
         self._fp.write(compressed)
+        self._pos += length
         return length
 
 
@@ -216,80 +491,101 @@ def open(filename, mode="rb", encoding=None, errors=None, newline=None):
         return binary_file
 
 
-class MemStream:
+class _BlockDecoder:
+    """Decoder of the blocks and frames split across the chunks of compressed data.
 
-    __slots__ = ["_len_ptr", "_buf_ptr", "_ptr"]
+    The compressed data is buffered only until the next block is complete, so the
+    memory is proportional to the length of the block.
+    """
 
-    def __init__(self, capacity):
-        self._len_ptr = ffi.new("size_t *")
+    __slots__ = ["_state", "_input", "_offset", "_dst_len", "_src_read"]
 
-        # Create pointer for membuf backend memory, it's much easier to
-        # access data through these pointers rather than copying content.
-        #
-        # Open memory buffers for reading and writing.
-        self._buf_ptr = ffi.new("void **")
-        self._ptr = ffi.new("huf_read_writer_t **")
+    def __init__(self, data=None):
+        """The complete compressed *data* is decoded in place without copying."""
+        self._state = ffi.new("huf_decompressor_t *")
+        self._input = bytearray() if data is None else data
+        self._offset = 0
 
-        err = lib.huf_memopen(self._ptr, self._buf_ptr, capacity)
-        unwrap_exc(err, f"Failed to allocate memory stream of {capacity} bytes long")
+        self._dst_len = ffi.new("size_t *")
+        self._src_read = ffi.new("size_t *")
 
     @property
-    def this(self):
-        return self._ptr[0]
-
-    def close(self):
-        err = lib.huf_memclose(self._ptr)
-        unwrap_exc(err, "Failed to close memory stream")
+    def need_input(self):
+        """Length of the compressed data required to decode the next block."""
+        return max(self._state.src_need - (len(self._input) - self._offset), 0)
 
-    def getvalue(self):
-        buf = ffi.cast("char *", self._buf_ptr[0])
-        return ffi.buffer(buf, len(self))[:]
+    @property
+    def need_output(self):
+        """Length of the output buffer required to decode the next block."""
+        return self._state.dst_need
+
+    def feed(self, data):
+        """Append the compressed data, consumed data is discarded."""
+        if not isinstance(self._input, bytearray):
+            self._input = bytearray(self._input[self._offset:])
+            self._offset = 0
+        if self._offset:
+            del self._input[:self._offset]
+            self._offset = 0
+        self._input += data
+
+    def decode(self, out, offset=0, last=False):
+        """Decode the next block into the *out* buffer starting from the *offset*.
+
+        Returns the length of the decoded data, or None when nothing is decoded,
+        then either `need_input` or `need_output` is set, unless the end of the
+        stream is reached. The *last* argument marks the end of the compressed data.
+        """
+        with ffi.from_buffer(self._input) as src, \
+                ffi.from_buffer(out, require_writable=True) as dst:
+            err = lib.huf_decompress_next(self._state, dst + offset, len(dst) - offset,
+                                          src + self._offset, len(src) - self._offset,
+                                          last, self._dst_len, self._src_read)
+        unwrap_exc(err, "Failed to decode the data")
 
-    def write(self, data):
-        err = self.this.write(self.this.stream, data, len(data))
-        unwrap_exc(err, "Failed to write data to the memory stream")
+        if not self._dst_len[0] and not self._src_read[0]:
+            return None
 
-    def seek(self, offset, whence=io.SEEK_SET):
-        if whence != io.SEEK_SET:
-            raise ValueError(
-                "Seek on in-memory stream allows only io.SEEK_SET; got "
-                f"{whence}, which is not supported"
-            )
-        if offset != 0:
-            raise ValueError(
-                "Seek on in-memory stream allows only rewinds; got "
-                f"offset = {offset} which is not supported"
-            )
-        err = lib.huf_memrewind(self.this)
-        unwrap_exc(err, "Failed to rewind memory stream")
-
-    def __len__(self):
-        err = lib.huf_memlen(self.this, self._len_ptr)
-        unwrap_exc(err, "Failed to retrieve length of the memory stream")
-        return self._len_ptr[0]
+        self._offset += self._src_read[0]
+        return self._dst_len[0]
 
 
 class HuffmanCompressor:
     """Create a new compressor object.
 
-    This object may be used to compress data incrementally.
+    This object may be used to compress data incrementally. The data is compressed
+    by the blocks of *blocksize* bytes, and the blocks are compressed concurrently
+    by *threads* native threads, or by a thread per processor when *threads* is zero
+    or None. Up to *threads* blocks are buffered until the next call, so each thread
+    gets a block. The output does not depend on the count of threads.
     """
 
-    def __init__(self, blocksize=DEFAULT_BLOCK_SIZE):
+    def __init__(self, blocksize=DEFAULT_BLOCK_SIZE, threads=1):
         self._blocksize = blocksize
+        self._threads = _threads_count(threads)
         self._flushed = False
 
-        self.istream = MemStream(blocksize)
-        self.ostream = MemStream(blocksize)
+        # Bytes of the incomplete batch of blocks, that are kept until the next call.
+        # The complete blocks are compressed directly from the memory of the caller.
+        self._batch = blocksize * self._threads
+        self._pending = bytearray()
+
+        self._scratch = ffi.NULL
+        self._scratch_cap = 0
 
-        # Initialize the encoding configuration, it's the same for the whole
-        # encoding process.
-        self._config = ffi.new("huf_config_t *")
-        self._config.blocksize = blocksize
-        self._config.reader_buffer_size = 0
-        self._config.writer_buffer_size = 0
-        self._config.reader = self.istream.this
-        self._config.writer = self.ostream.this
+    def _reserve(self, length):
+        """Return the scratch buffer of at least the specified length."""
+        if self._scratch_cap < length:
+            self._scratch = _scratch_new("uint8_t[]", length)
+            self._scratch_cap = length
+        return self._scratch
+
+    def _compress_pending(self, dst, dst_cap):
+        with ffi.from_buffer(self._pending) as src:
+            written = _compress_blocks(dst, dst_cap, src, len(self._pending),
+                                       self._blocksize, self._threads)
+        self._pending.clear()
+        return written
 
     def compress(self, data):
         """Provide data to the compressor object.
@@ -300,46 +596,39 @@ class HuffmanCompressor:
         When you have finished providing data to the compressor, call the `flush()`
         method to finish the compression process.
         """
-        encoding = bytes()
         if self._flushed:
-            return encoding()
-
-        buf_bytes = len(self.istream)
+            return bytes()
 
-        # Calculate the amount of bytes ready for encoding considering the content
-        # of the buffer in the input stream. If at least one block is available for
-        # encoding, run the encoder, put remaining bytes to the buffer, until the
-        # next `compress` or `flush` call.
-        all_bytes = buf_bytes + len(data)
-        num_blocks = all_bytes // self._blocksize
-        num_bytes = num_blocks * self._blocksize
+        data = _view(data)
 
-        # Calculate how much data is required to take from the input bytes and what
-        # to write the input stream until the next call.
-        max_bytes = num_bytes - buf_bytes
-        rem_bytes = len(data) - max_bytes
+        # Complete the pending batch first, then compress all complete blocks
+        # of the data in place, and keep the rest until the next call. Pending
+        # batch consists of the whole blocks, so the blocks stay aligned.
+        fill = 0
+        if self._pending:
+            fill = min(self._batch - len(self._pending), len(data))
+            self._pending += data[:fill]
 
-        if num_blocks > 0:
-            self.istream.write(data[:max_bytes])
+        pending_len = len(self._pending) if len(self._pending) == self._batch else 0
+        blocks_len = (len(data) - fill) // self._blocksize * self._blocksize
 
-            self._config.length = num_bytes
-            err = lib.huf_encode(self._config)
-            unwrap_exc(err, "Failed to encode the data")
+        dst_cap = (compress_bound(pending_len, self._blocksize) +
+                   compress_bound(blocks_len, self._blocksize))
+        dst = self._reserve(dst_cap)
 
-            encoding = self.ostream.getvalue()
+        written = 0
+        if pending_len:
+            written = self._compress_pending(dst, dst_cap)
 
-            # Reset input stream, to write next time a new portion of data. Reset
-            # output stream to discard content in the buffer.
-            self.istream.seek(0)
-            self.ostream.seek(0)
+        if blocks_len:
+            with ffi.from_buffer(data) as src:
+                written += _compress_blocks(dst + written, dst_cap - written,
+                                            src + fill, blocks_len, self._blocksize,
+                                            self._threads)
 
-        # Write the remaining bytes to the input buffer, so the encoding could
-        # continue. The istream can grow as large as necessary to fit all the
-        # remaining bytes.
-        if rem_bytes > 0:
-            self.istream.write(data[max_bytes:max_bytes+rem_bytes])
+        self._pending += data[fill+blocks_len:]
 
-        return encoding
+        return ffi.buffer(dst, written)[:]
     
     def flush(self):
         """Finish the compression process.
@@ -347,86 +636,153 @@ class HuffmanCompressor:
         Returns the compressed data left in internal buffers. The compressor object
         may not be used after this method is called.
         """
-        encoding = bytes()
-
         if self._flushed:
-            return encoding
+            return bytes()
 
-        self._config.length = len(self.istream)
+        dst_cap = compress_bound(len(self._pending), self._blocksize)
+        dst = self._reserve(dst_cap)
 
-        if self._config.length > 0:
-            err = lib.huf_encode(self._config)
-            unwrap_exc(err, "Failed to encode the data")
-            encoding = self.ostream.getvalue()
+        written = self._compress_pending(dst, dst_cap)
 
-        self.istream.close()
-        self.ostream.close()
+        self._scratch = ffi.NULL
+        self._scratch_cap = 0
         self._flushed = True
 
-        return encoding
+        return ffi.buffer(dst, written)[:]
 
 
 class HuffmanDecompressor:
     """Create a new decompressor object.
 
-    This object may be used to decompress data incrementally.
+    This object may be used to decompress data incrementally. The *memlimit*
+    argument is kept for compatibility, the compressed data is buffered only
+    until the block split across the calls is complete.
     """
 
     def __init__(self, memlimit=DEFAULT_MEM_LIMIT):
-        self.istream = MemStream(memlimit)
-        self.ostream = MemStream(memlimit)
-
-        self._config = ffi.new("huf_config_t *")
-        self._config.reader_buffer_size = 0
-        self._config.writer_buffer_size = 0
-        self._config.reader = self.istream.this
-        self._config.writer = self.ostream.this
+        self._decoder = _BlockDecoder()
+        self._block = bytearray()
 
     def decompress(self, data):
         """Decompress data (a `bytes` object), returning uncompressed data as `bytes`.
 
         If data is the concatenation of multiple distinct compressed blocks, decompress
-        all of these blocks, and return the concatenation of the results.
+        all of these blocks, and return the concatenation of the results. The block
+        split across the calls is returned, once the rest of the block is provided.
         """
-        self.istream.write(data)
-        self._config.length = len(self.istream)
+        self._decoder.feed(_view(data))
 
-        err = lib.huf_decode(self._config)
-        unwrap_exc(err, "Failed to decode the data")
+        decoding = []
+        while True:
+            length = self._decoder.decode(self._block)
+            if length:
+                decoding.append(bytes(memoryview(self._block)[:length]))
+            elif length is None:
+                if not self._decoder.need_output:
+                    break
+                self._block = bytearray(self._decoder.need_output)
 
-        decoding = self.ostream.getvalue()
-        self.ostream.seek(0)
-
-        return decoding
+        return b"".join(decoding)
 
     def close(self):
         """Release the decompressor resources."""
-        self._closed = True
-        self.istream.close()
-        self.ostream.close()
+        self._decoder = None
+        self._block = None
+
+
+def compress_bound(length, blocksize=DEFAULT_BLOCK_SIZE):
+    """Return the maximum length of the compressed data of the specified length.
+
+    The buffer of this length always fits the result of `compress_into` with the
+    same *blocksize*.
+    """
+    return lib.huf_compress_parallel_bound(length, blocksize)
+
 
+def compress_into(data, out, blocksize=DEFAULT_BLOCK_SIZE, threads=1):
+    """Compress *data* into the writable buffer *out*, returning the length
+    of the compressed data.
 
-def compress(data, blocksize=DEFAULT_BLOCK_SIZE):
+    Both buffers are passed to the encoder without copying. The buffer of
+    `compress_bound` length always fits the compressed data, otherwise
+    `HuffmanError` is raised when the buffer is too small. When more than one
+    thread is used, the buffer must be of `compress_bound` length, since the
+    blocks are compressed into their own parts of the buffer.
+    """
+    data, out = _view(data), _view(out)
+
+    with ffi.from_buffer(data) as src, ffi.from_buffer(out, require_writable=True) as dst:
+        return _compress_blocks(dst, len(out), src, len(data), blocksize,
+                                _threads_count(threads))
+
+
+def compress(data, blocksize=DEFAULT_BLOCK_SIZE, threads=1):
     """Compress *data*, returning the compressed data as a `bytes` object.
 
-    See `HuffmanCompressor` above for a description of the *blocksize* argument.
+    See `HuffmanCompressor` above for a description of the *blocksize* and
+    *threads* arguments.
 
     For incremental compression, use `HuffmanCompressor` instead.
     """
-    comp = HuffmanCompressor(blocksize)
+    comp = HuffmanCompressor(blocksize, threads)
     return comp.compress(data) + comp.flush()
 
 
+def decompress_into(data, out):
+    """Decompress *data* into the writable buffer *out*, returning the length
+    of the decompressed data.
+
+    Both buffers are passed to the decoder without copying, `HuffmanError` is
+    raised when the buffer is too small to fit the decompressed data.
+    """
+    data, out = _view(data), _view(out)
+
+    with ffi.from_buffer(data) as src, ffi.from_buffer(out, require_writable=True) as dst:
+        return _decompress(dst, len(out), src, len(data))
+
+
+def _content_size(data):
+    """Return the length of the decoded data declared by the frame header, or
+    None when the data does not start with the frame or the length is not set.
+    """
+    frame = ffi.new("huf_frame_t *")
+    header_len = ffi.new("size_t *", len(data))
+
+    with ffi.from_buffer(data) as src:
+        err = lib.huf_frame_read(frame, src, header_len)
+
+    if err != lib.HUF_ERROR_SUCCESS or not frame.flags & lib.HUF_FRAME_CONTENT_SIZE:
+        return None
+    return frame.size
+
+
 def decompress(data, memlimit=DEFAULT_MEM_LIMIT):
     """Decompress *data*, returning the uncompressed data as a `bytes` object.
 
     If *data* is the concatenation of multiple distinct compressed blocks,
     decompress all of these blocks, and return the concatenation of the results.
 
-    See `HuffmanDecompressor` above for a description of the *memlimit*
-    argument.
+    The output buffer is sized from the length declared by the frame header,
+    otherwise it grows by the length of each decoded block, so the memory is
+    proportional to the decompressed data. The *memlimit* argument is kept for
+    compatibility.
     """
-    decomp = HuffmanDecompressor(memlimit)
-    data_out = decomp.decompress(data)
-    decomp.close()
-    return data_out
+    data = _view(data)
+    decoder = _BlockDecoder(data)
+
+    # The declared length is not trusted beyond the largest possible output.
+    size = _content_size(data) or 0
+    out = bytearray(min(size, len(data) * MAX_EXPANSION))
+    out_len = 0
+
+    while True:
+        length = decoder.decode(out, out_len, last=True)
+        if length is not None:
+            out_len += length
+        elif decoder.need_output:
+            out += bytes(out_len + decoder.need_output - len(out))
+        else:
+            break
+
+    del out[out_len:]
+    return bytes(out)
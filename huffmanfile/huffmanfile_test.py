@@ -1,8 +1,10 @@
+import io
 from string import printable
 
 import pytest
 
 from . import huffmanfile
+from ._C import ffi, lib
 
 
 def test_compress_decompress():
@@ -12,12 +14,38 @@ def test_compress_decompress():
     assert d == data
 
 
+def test_compress_decompress_segments():
+    # Streams grow by segments of the block size.
+    data = printable.encode() * 100
+    c = huffmanfile.compress(data, blocksize=1000)
+    d = huffmanfile.decompress(c, memlimit=1000)
+    assert d == data
+
+
 def test_decompress_corrupted():
     with pytest.raises(huffmanfile.HuffmanError):
         data = b'\x08\x00\x00\x00\x00\x00\x00\x00\x02\x00'
         huffmanfile.decompress(data)
 
 
+def test_decompress_frame():
+    data = printable.encode() * 100
+    blocks = huffmanfile.compress(data, blocksize=1000)
+
+    frame = ffi.new("huf_frame_t *", {
+        "version": 1, "flags": lib.HUF_FRAME_CONTENT_SIZE, "size": len(data)})
+    header = ffi.new("uint8_t[32]")
+    header_len = ffi.new("size_t *", len(header))
+    assert lib.huf_frame_write(frame, header, header_len) == lib.HUF_ERROR_SUCCESS
+
+    end = b"\xff" * 8
+    c = ffi.buffer(header, header_len[0])[:] + blocks + end
+    assert huffmanfile.decompress(c) == data
+
+    # Frames are followed by the blocks without the frame.
+    assert huffmanfile.decompress(c + blocks) == data * 2
+
+
 def test_compress_incremental():
     def gen_data(parts=10, partsize=1000):
         for _ in range(parts):
@@ -34,6 +62,37 @@ def test_compress_incremental():
     assert huffmanfile.decompress(out) == data
 
 
+def test_compress_incremental_unaligned():
+    # Parts larger than the block complete the pending block first.
+    data = printable.encode() * 200
+    comp = huffmanfile.HuffmanCompressor(blocksize=1000)
+
+    out, offset = bytes(), 0
+    for size in (751, 1780, 1648, 223, 2455, 2279, 1832, 720, 1859, 2135):
+        out += comp.compress(memoryview(data)[offset:offset+size])
+        offset += size
+
+    out += comp.compress(data[offset:])
+    out += comp.flush()
+    assert out == huffmanfile.compress(data, blocksize=1000)
+    assert huffmanfile.decompress(out) == data
+
+
+def test_compress_decompress_into():
+    data = bytearray(printable.encode() * 100)
+
+    out = bytearray(huffmanfile.compress_bound(len(data), blocksize=1000))
+    out_len = huffmanfile.compress_into(data, out, blocksize=1000)
+    assert out[:out_len] == huffmanfile.compress(data, blocksize=1000)
+
+    dst = bytearray(len(data))
+    assert huffmanfile.decompress_into(memoryview(out)[:out_len], dst) == len(data)
+    assert dst == data
+
+    with pytest.raises(huffmanfile.HuffmanError):
+        huffmanfile.decompress_into(memoryview(out)[:out_len], bytearray(10))
+
+
 def test_write_file(tmp_path):
     data = """\
     Donec rhoncus quis sapien sit amet molestie. Fusce scelerisque vel augue
@@ -52,3 +111,84 @@ def test_write_file(tmp_path):
         content = f.read()
 
     assert content == data
+
+
+def make_lines(count=2000):
+    return b"".join(b"%d %s\n" % (i, printable[:i % 90].encode()) for i in range(count))
+
+
+def test_decompress_split_blocks():
+    data = make_lines()
+    c = huffmanfile.compress(data, blocksize=1000)
+
+    # Blocks split across the calls are decoded once complete.
+    decomp = huffmanfile.HuffmanDecompressor()
+    out = b"".join(decomp.decompress(c[i:i+333]) for i in range(0, len(c), 333))
+    assert out == data
+
+
+def test_read_file_streaming():
+    data = make_lines()
+    c = huffmanfile.compress(data, blocksize=1000)
+
+    with huffmanfile.HuffmanFile(io.BytesIO(c), "rb", memlimit=100) as f:
+        assert f.readline() == data.splitlines(True)[0]
+        assert list(f) == data.splitlines(True)[1:]
+
+    with huffmanfile.HuffmanFile(io.BytesIO(c), "rb") as f:
+        buf = bytearray(700)
+        out = bytearray()
+        while n := f.readinto(buf):
+            out += buf[:n]
+        assert out == data
+
+
+def test_read_file_seek():
+    data = make_lines()
+    c = huffmanfile.compress(data, blocksize=1000)
+
+    with huffmanfile.HuffmanFile(io.BytesIO(c), "rb") as f:
+        for offset in (100, 5, 3000, len(data) - 3, 0, len(data) + 5):
+            assert f.seek(offset) == min(offset, len(data))
+            assert f.read(17) == data[offset:offset+17]
+
+        assert f.seek(-10, io.SEEK_END) == len(data) - 10
+        assert f.read() == data[-10:]
+
+
+def test_read_file_seek_end():
+    data = make_lines()
+    c = huffmanfile.compress(data, blocksize=1000)
+
+    # The unread rest of the current block is counted as well.
+    with huffmanfile.HuffmanFile(io.BytesIO(c), "rb") as f:
+        assert f.read(10) == data[:10]
+        assert f.seek(0, io.SEEK_END) == len(data)
+        assert f.read() == b""
+
+        assert f.seek(-5, io.SEEK_END) == len(data) - 5
+        assert f.read() == data[-5:]
+
+
+def test_read_file_truncated():
+    c = huffmanfile.compress(make_lines(), blocksize=1000)
+
+    with pytest.raises(huffmanfile.HuffmanError):
+        with huffmanfile.HuffmanFile(io.BytesIO(c[:-5]), "rb") as f:
+            f.read()
+
+
+def test_compress_threads():
+    data = make_lines(5000)
+    expected = huffmanfile.compress(data, blocksize=1000)
+
+    for threads in (2, 3, 0):
+        assert huffmanfile.compress(data, blocksize=1000, threads=threads) == expected
+
+    # Small writes are batched, so each thread gets a block.
+    out = io.BytesIO()
+    with huffmanfile.HuffmanFile(out, "wb", blocksize=1000, threads=4) as f:
+        for line in data.splitlines(True):
+            f.write(line)
+
+    assert out.getvalue() == expected
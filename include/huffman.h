@@ -1,11 +1,15 @@
 #ifndef INCLUDE_huffman_h__
 #define INCLUDE_huffman_h__
 
+#include "huffman/compress.h"
 #include "huffman/decoder.h"
 #include "huffman/encoder.h"
 #include "huffman/bufio.h"
 #include "huffman/common.h"
 #include "huffman/errors.h"
+#include "huffman/frame.h"
 #include "huffman/io.h"
+#include "huffman/pool.h"
+#include "huffman/stats.h"
 
 #endif // INCLUDE_huffman_h__
@@ -1,9 +1,12 @@
 #ifndef INCLUDE_huffman_bufio_h__
 #define INCLUDE_huffman_bufio_h__
 
+#include <string.h>
+
 #include "huffman/common.h"
 #include "huffman/errors.h"
 #include "huffman/io.h"
+#include "huffman/malloc.h"
 
 #define CFFI_huffman_bufio_h__
 
@@ -27,6 +30,13 @@ typedef struct __huf_bufio_read_writer {
 
     // Read-Writer instance.
     huf_read_writer_t *read_writer;
+
+    // Non-zero value when the buffer is the memory of the mapped
+    // read-writer, such buffer is read-only and not released.
+    int mapped;
+
+    // Allocator of the buffer.
+    const huf_allocator_t *allocator;
 } huf_bufio_read_writer_t;
 
 
@@ -40,6 +50,31 @@ typedef struct __huf_bit_read_writer {
 } huf_bit_read_writer_t;
 
 
+// huf_bit_reader_t represents a reader of the bit stream, that
+// loads the stream into the 64-bit register.
+typedef struct __huf_bit_reader {
+    // Bits of the stream, the next bit to read is the most
+    // significant bit of the register.
+    uint64_t bits;
+
+    // Count of the valid bits in the register.
+    size_t count;
+
+    // Position of the next byte to load into the register.
+    const uint8_t *ptr;
+
+    // End of the readable window.
+    const uint8_t *end;
+
+    // Buffered reader used to refill the window. If set to nil,
+    // then only the window itself could be read.
+    huf_bufio_read_writer_t *bufio;
+
+    // Single byte window of the unbuffered reader.
+    uint8_t byte;
+} huf_bit_reader_t;
+
+
 // Write the first bit of the specified word into the
 // bit buffer.
 void
@@ -51,6 +86,31 @@ void
 huf_bit_read_writer_reset(huf_bit_read_writer_t *self);
 
 
+// Initialize the bit reader with the specified memory window.
+void
+huf_bit_reader_init(huf_bit_reader_t *self, const void *buf, size_t len);
+
+
+// Attach the bit reader to the window of the buffered reader,
+// the window is refilled from the buffered reader on demand.
+huf_error_t
+huf_bit_reader_attach(huf_bit_reader_t *self, huf_bufio_read_writer_t *bufio);
+
+
+// Skip the bits remaining in the current byte and return bytes
+// loaded but not consumed by the bit reader back to the buffered
+// reader, so it could be read again.
+huf_error_t
+huf_bit_reader_detach(huf_bit_reader_t *self);
+
+
+// Load as many bytes as possible into the register. For the reader
+// attached to the unbuffered reader, the next byte is read only when
+// the register is empty, so no bytes past the stream are consumed.
+huf_error_t
+huf_bit_reader_refill(huf_bit_reader_t *self);
+
+
 // Initialize a new instance of the read-write buffer
 // with the specified size in bytes.
 huf_error_t
@@ -60,11 +120,29 @@ huf_bufio_read_writer_init(
         size_t size);
 
 
+// Initialize a new instance of the read-write buffer with the specified
+// size in bytes. The allocator must outlive the buffer, if nil, then the
+// default allocator is used.
+huf_error_t
+huf_bufio_read_writer_init_allocator(
+        huf_bufio_read_writer_t **self,
+        huf_read_writer_t *read_writer,
+        size_t size,
+        const huf_allocator_t *allocator);
+
+
 // Release memory occupied by the read-write buffer.
 huf_error_t
 huf_bufio_read_writer_free(huf_bufio_read_writer_t **self);
 
 
+// Use the memory of the read-writer as a reader buffer, so bytes are
+// read without copying. Nothing is done, when the read-writer could not
+// be mapped into the memory. Should be called before any reads.
+huf_error_t
+huf_bufio_read_writer_map(huf_bufio_read_writer_t *self);
+
+
 // Flush the writer buffer.
 huf_error_t
 huf_bufio_read_writer_flush(huf_bufio_read_writer_t *self);
@@ -83,6 +161,36 @@ huf_error_t
 huf_bufio_read(huf_bufio_read_writer_t *self, void *buf, size_t size);
 
 
+// Return the pointer to the bytes of the reader buffer without copying
+// them. The len argument is the count of bytes requested by the caller,
+// the buffer is refilled when it keeps fewer bytes. On return the len
+// argument is the count of available bytes, it could be less than
+// requested at the end of the stream or when the request is larger
+// than the buffer capacity.
+huf_error_t
+huf_bufio_peek(huf_bufio_read_writer_t *self, const uint8_t **buf, size_t *len);
+
+
+// Mark the specified amount of bytes returned by the peek as read.
+huf_error_t
+huf_bufio_consume(huf_bufio_read_writer_t *self, size_t len);
+
+
+// Return the pointer to the free space of the writer buffer. The len
+// argument is the count of bytes requested by the caller, the buffer is
+// flushed when it has less free space. On return the len argument is
+// the count of available bytes, it could be less than requested when
+// the request is larger than the buffer capacity.
+huf_error_t
+huf_bufio_reserve(huf_bufio_read_writer_t *self, uint8_t **buf, size_t *len);
+
+
+// Mark the specified amount of bytes written into the reserved
+// space as written.
+huf_error_t
+huf_bufio_commit(huf_bufio_read_writer_t *self, size_t len);
+
+
 // Read the 8-bits word from the reader buffer into the specified pointer.
 huf_error_t
 huf_bufio_read_uint8(huf_bufio_read_writer_t *self, uint8_t *byte);
@@ -94,4 +202,70 @@ huf_bufio_write_uint8(huf_bufio_read_writer_t *self, uint8_t byte);
 
 
 #undef CFFI_huffman_bufio_h__
+
+
+// Load 8 bytes starting from the specified pointer into the 64-bit
+// word, so the first byte is the most significant byte of the word.
+static inline uint64_t
+__huf_bit_reader_load(const uint8_t *ptr)
+{
+    uint64_t word;
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) \
+    && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&word, ptr, sizeof(word));
+    word = __builtin_bswap64(word);
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    memcpy(&word, ptr, sizeof(word));
+#else
+    word = 0;
+    for (size_t index = 0; index < sizeof(word); index++) {
+        word = (word << 8) | ptr[index];
+    }
+#endif
+
+    return word;
+}
+
+
+// Load the next bytes of the window into the register. This is a faster
+// version of the refill, that does not leave the calling routine while
+// the window has enough bytes.
+static inline huf_error_t
+huf_bit_reader_fill(huf_bit_reader_t *self)
+{
+    // Load the next 8 bytes at once, but advance the position only by
+    // count of bytes fit into the register. The rest of the word is
+    // loaded again on the next refill.
+    if (self->end - self->ptr >= 8) {
+        self->bits |= __huf_bit_reader_load(self->ptr) >> self->count;
+        self->ptr += (63 - self->count) >> 3;
+        self->count |= 56;
+
+        return HUF_ERROR_SUCCESS;
+    }
+
+    return huf_bit_reader_refill(self);
+}
+
+
+// Return the specified number of the next bits in the stream without
+// consuming them. The count of bits should be in range [1, 56].
+static inline uint64_t
+huf_bit_reader_peek(const huf_bit_reader_t *self, size_t count)
+{
+    return self->bits >> (64 - count);
+}
+
+
+// Consume the specified number of bits, the count of bits should
+// not exceed the count of bits in the register.
+static inline void
+huf_bit_reader_consume(huf_bit_reader_t *self, size_t count)
+{
+    self->bits <<= count;
+    self->count -= count;
+}
+
+
 #endif // INCLUDE_huffman_bufio_h__
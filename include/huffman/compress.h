@@ -0,0 +1,150 @@
+#ifndef INCLUDE_huffman_compress_h__
+#define INCLUDE_huffman_compress_h__
+
+#include <sys/uio.h>
+
+#include "huffman/common.h"
+#include "huffman/errors.h"
+#include "huffman/io.h"
+
+// Maximum length of the block of the one-shot compression. Codes of
+// the shorter blocks always fit into the packing kernel.
+#define HUF_COMPRESS_BLOCKSIZE (1 << 30)
+
+// Maximum length of the block header: length of the block, length
+// of the serialized Huffman tree and the tree itself.
+#define HUF_COMPRESS_BLOCK_OVERHEAD 2058
+
+// Maximum count of the threads of the parallel compression.
+#define HUF_COMPRESS_THREADS_MAX 256
+
+#define CFFI_huffman_compress_h__
+
+
+// Return the maximum length of the compressed data of the specified
+// length. Destination buffer of this length always fits the result
+// of the compression.
+size_t
+huf_compress_bound(size_t len);
+
+
+// Compress the source buffer into the destination buffer in the
+// format of the single stream encoder. The memory is not allocated
+// from the heap, the length of the compressed data is returned in
+// the dst_len argument.
+huf_error_t
+huf_compress(void *dst, size_t dst_cap, const void *src, size_t src_len,
+        size_t *dst_len);
+
+
+// Return the maximum length of the compressed data of the specified
+// length split into the blocks of the specified length. Destination
+// buffer of this length always fits the result of the parallel
+// compression with any count of threads.
+size_t
+huf_compress_parallel_bound(size_t len, size_t blocksize);
+
+
+// Compress the source buffer split into the blocks of the specified
+// length with the specified count of threads, the output is the same
+// as the output of huf_compress called for each block in order. When
+// more than one thread is used, the destination buffer must be of the
+// huf_compress_parallel_bound length, since the blocks are compressed
+// into their own parts of the buffer before they are joined.
+huf_error_t
+huf_compress_parallel(void *dst, size_t dst_cap, const void *src,
+        size_t src_len, size_t blocksize, size_t threads, size_t *dst_len);
+
+
+// Decompress the source buffer encoded by the single stream encoder
+// into the destination buffer. The memory is not allocated from the
+// heap, the length of the decompressed data is returned in the
+// dst_len argument. Frames of the single stream blocks are
+// decompressed as well, and the skippable frames are skipped.
+huf_error_t
+huf_decompress(void *dst, size_t dst_cap, const void *src, size_t src_len,
+        size_t *dst_len);
+
+
+// huf_decompressor_t holds the state of the incremental decompression,
+// where the blocks and frames are split across the source buffers. The
+// zeroed state starts at the beginning of the stream.
+typedef struct __huf_decompressor {
+    // Set to non-zero value within the frame, the flags and the size
+    // of the current frame.
+    int frame;
+    uint8_t flags;
+    uint64_t size;
+
+    // Length of the data decompressed from the current frame.
+    uint64_t written;
+
+    // Length of the skippable frame data remaining to consume.
+    uint64_t skip;
+
+    // Length of the source buffer required to decompress the next
+    // block, when the last call did not consume any data.
+    size_t src_need;
+
+    // Length of the destination buffer required to decompress the
+    // next block, when the last call did not consume any data.
+    size_t dst_need;
+} huf_decompressor_t;
+
+
+// Decompress the next block of the source buffer into the destination
+// buffer. The headers and end markers of the frames, and the skippable
+// frames are consumed without the output. When the block does not fit
+// into the destination buffer, or the source buffer ends in the middle
+// of the block, nothing is consumed, and the required lengths are set
+// in the src_need and dst_need fields. When the last argument is set,
+// the source buffer is the end of the stream, so the truncated data is
+// reported as an error. Zero lengths without the required lengths
+// are returned at the end of the stream.
+huf_error_t
+huf_decompress_next(huf_decompressor_t *self, void *dst, size_t dst_cap,
+        const void *src, size_t src_len, int last, size_t *dst_len,
+        size_t *src_read);
+
+
+// Compress each of the source buffers into the destination buffer, the
+// outputs are returned in the dsts array of the same length. Each output
+// could be decompressed independently with huf_decompress.
+//
+// When the table is not nil, the symbols of all buffers are encoded
+// with a single Huffman tree, which is written once before the outputs
+// and returned in the table argument. Such outputs are decompressed with
+// huf_decompress_shared. The destination buffer of HUF_COMPRESS_BLOCK_OVERHEAD
+// bytes plus huf_compress_bound of each source buffer fits the outputs.
+huf_error_t
+huf_encode_batch(void *dst, size_t dst_cap, const huf_segment_t *srcs,
+        huf_segment_t *dsts, size_t count, huf_segment_t *table);
+
+
+// Decompress the output of huf_encode_batch compressed with the
+// shared table into the destination buffer.
+huf_error_t
+huf_decompress_shared(void *dst, size_t dst_cap, const void *table,
+        size_t table_len, const void *src, size_t src_len, size_t *dst_len);
+
+
+// Encode the data gathered from the memory segments into the writer in
+// the format of the single stream encoder, so the segments are not copied
+// into the contiguous buffer. When the writer supports the vectored
+// writes, the header of the block and the encoded data are written
+// with a single call.
+huf_error_t
+huf_encodev(huf_read_writer_t *writer, const struct iovec *iov, int iovcnt);
+
+
+// Decode the data gathered from the memory segments and encoded by the
+// single stream encoder, the decoded data is scattered over the memory
+// segments of the destination. The length of the decoded data is returned
+// in the dst_len argument.
+huf_error_t
+huf_decodev(const struct iovec *dst, int dstcnt, const struct iovec *src,
+        int srccnt, size_t *dst_len);
+
+
+#undef CFFI_huffman_compress_h__
+#endif // INCLUDE_huffman_compress_h__
@@ -4,13 +4,22 @@
 #include "huffman/common.h"
 #include "huffman/errors.h"
 #include "huffman/io.h"
+#include "huffman/malloc.h"
+#include "huffman/stats.h"
+
+// Count of the bit streams of the interleaved block layout.
+#define HUF_INTERLEAVED_STREAMS 4
 
 #define CFFI_huffman_config_h__
 
+// huf_config_t configures the encoder and the decoder. New fields are
+// appended to the end of the structure, so the offsets of the existing
+// fields stay the same for the binaries built with the older headers.
 typedef struct __huf_encoder_config {
     // Count of the reader bytes to encode. This is the only
     // mandatory parameter, if set to zero then no data will
-    // be compressed.
+    // be compressed. The decoder reads the data until the
+    // end of the reader, when the length is set to zero.
     uint64_t length;
 
     // Size of the encoding block. If set to zero then
@@ -33,6 +42,34 @@ typedef struct __huf_encoder_config {
     // Instance of the writer which will be used as
     // a consumer of the Huffman-encoded data.
     huf_read_writer_t *writer;
+
+    // Allocator of the encoder and decoder memory. If the alloc
+    // function is set to nil, then the default allocator is used.
+    huf_allocator_t allocator;
+
+    // Statistics of the run. If set to nil, then the statistics
+    // are not collected, otherwise they are reset and filled by
+    // the encoder or decoder, even when the run fails.
+    huf_stats_t *stats;
+
+    // Count of the independent bit streams each block is split
+    // into. If set to zero or one then each block is encoded as a
+    // single bit stream, otherwise it must be equal to
+    // HUF_INTERLEAVED_STREAMS. Data must be decoded with the same
+    // value it was encoded with.
+    size_t streams;
+
+    // Count of blocks buffered between the reader, encoder and writer
+    // threads of the pipelined encoder. If set to zero then blocks are
+    // read, encoded and written one after another in the calling thread.
+    // The decoder ignores this parameter.
+    size_t pipeline_depth;
+
+    // If set to non-zero value then the encoded data is wrapped into
+    // the frame, that starts with the signature and the length of the
+    // data, and ends with the end marker, so the data is decoded without
+    // the length. The decoder detects the frames without this parameter.
+    int frame;
 } huf_config_t;
 
 
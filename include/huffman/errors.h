@@ -24,6 +24,18 @@ typedef enum {
     // larger than the maximum theoretical size (1024 bytes) or is zero.
     HUF_ERROR_BTREE_OVERFLOW,
     HUF_ERROR_BTREE_CORRUPTED,
+
+    // Returned when the layout of the decoding block is inconsistent,
+    // e.g. the lengths of the block streams are impossible.
+    HUF_ERROR_BLOCK_CORRUPTED,
+
+    // Returned when the destination buffer is too small
+    // to store the result of the operation.
+    HUF_ERROR_BUFFER_OVERFLOW,
+
+    // Returned when the version or the flags of the frame
+    // are not supported by the decoder.
+    HUF_ERROR_FRAME_UNSUPPORTED,
 } huf_error_t;
 
 
@@ -0,0 +1,72 @@
+#ifndef INCLUDE_huffman_frame_h__
+#define INCLUDE_huffman_frame_h__
+
+#include "huffman/common.h"
+#include "huffman/errors.h"
+
+// Signature of the frame. The last byte is not zero, so the signature
+// read as the length of the block exceeds any length of the block,
+// and the frames are distinguished from the blocks without the frame.
+#define HUF_FRAME_MAGIC "\x89HUF\r\n\x1a\n"
+
+// Length of the frame signature in bytes.
+#define HUF_FRAME_MAGIC_LEN 8
+
+// Version of the frame format written by the encoder.
+#define HUF_FRAME_VERSION 1
+
+// Maximum length of the frame header: signature, version, flags
+// and the size of the content.
+#define HUF_FRAME_HEADER_LEN 18
+
+// Length of the block, that marks the end of the frame.
+#define HUF_FRAME_END UINT64_MAX
+
+#define CFFI_huffman_frame_h__
+
+// Enumeration of the frame flags.
+typedef enum {
+    // The header contains the length of the decoded data.
+    HUF_FRAME_CONTENT_SIZE = 1,
+
+    // Blocks of the frame are split into the interleaved streams.
+    HUF_FRAME_INTERLEAVED = 2,
+
+    // The header is followed by the data of the specified size,
+    // which is skipped by the decoder.
+    HUF_FRAME_SKIPPABLE = 4,
+} huf_frame_flags_t;
+
+
+// huf_frame_t describes the header of the frame.
+typedef struct __huf_frame {
+    // Version of the frame format.
+    uint8_t version;
+
+    // Combination of the frame flags.
+    uint8_t flags;
+
+    // Length of the decoded data when HUF_FRAME_CONTENT_SIZE flag is
+    // set, or length of the skipped data when HUF_FRAME_SKIPPABLE flag
+    // is set, otherwise is ignored.
+    uint64_t size;
+} huf_frame_t;
+
+
+// Write the frame header into the buffer. The len argument is the
+// capacity of the buffer, and the length of the header on return.
+huf_error_t
+huf_frame_write(const huf_frame_t *self, void *buf, size_t *len);
+
+
+// Read the frame header from the buffer. The len argument is the
+// length of the buffer, and the length of the header on return, so
+// the size of the decoded data is known before the decoding. When
+// the buffer does not start with the frame signature, the
+// HUF_ERROR_INVALID_ARGUMENT error is returned.
+huf_error_t
+huf_frame_read(huf_frame_t *self, const void *buf, size_t *len);
+
+
+#undef CFFI_huffman_frame_h__
+#endif // INCLUDE_huffman_frame_h__
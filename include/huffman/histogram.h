@@ -3,6 +3,7 @@
 
 #include <huffman/common.h>
 #include <huffman/errors.h>
+#include <huffman/malloc.h>
 
 #define CFFI_huffman_histogram_h__
 
@@ -25,6 +26,9 @@ typedef struct __huf_histogram {
     // be useful while iterating through frequencies to
     // skip empty values.
     size_t start;
+
+    // Allocator of the frequency chart.
+    const huf_allocator_t *allocator;
 } huf_histogram_t;
 
 
@@ -33,6 +37,13 @@ huf_error_t
 huf_histogram_init(huf_histogram_t **self, size_t iota, size_t length);
 
 
+// Initialize a new instance of the frequency histogram. The allocator
+// must outlive the histogram, if nil, then the default allocator is used.
+huf_error_t
+huf_histogram_init_allocator(huf_histogram_t **self, size_t iota,
+        size_t length, const huf_allocator_t *allocator);
+
+
 // Release memory occupied by the frequency histogram.
 huf_error_t
 huf_histogram_free(huf_histogram_t **self);
@@ -46,7 +57,7 @@ huf_histogram_reset(huf_histogram_t *self);
 // Increase the appropriate element of the frequencies chart by one if the element
 // was found in the specified buffer.
 huf_error_t
-huf_histogram_populate(huf_histogram_t *self, void *buf, size_t len);
+huf_histogram_populate(huf_histogram_t *self, const void *buf, size_t len);
 
 
 #undef CFFI_huffman_histogram_h__
@@ -3,11 +3,23 @@
 
 #include "huffman/common.h"
 #include "huffman/errors.h"
+#include "huffman/malloc.h"
 
 #define CFFI_huffman_io_h__
 
 
-// huf_read_writer_t groups reader and writer abstractions.
+// huf_segment_t is a contiguous part of the memory, like a part of
+// the segmented memory stream, it has the same layout as the struct iovec.
+typedef struct __huf_segment {
+    void *base;
+    size_t len;
+} huf_segment_t;
+
+
+// huf_read_writer_t groups reader and writer abstractions. The optional
+// functions are called whenever they are set, so the read-writers built
+// by the caller must be zero-initialized, like `huf_read_writer_t rw =
+// {.stream = ..., .read = ...}` or memory allocated with calloc.
 typedef struct __huf_read_writer {
     void *stream;
 
@@ -18,18 +30,68 @@ typedef struct __huf_read_writer {
     // Read the count of bytes into the buffer starting from the buf pointer.
     // The amount of read bytes are written into count argument.
     huf_error_t (*read)(void *stream, void *buf, size_t *count);
+
+    // Return the memory of the stream starting from the current read
+    // position and move the position to the end of the stream, so the
+    // rest of the stream could be read without copying. Optional, must
+    // be nil for streams that are not kept in memory.
+    huf_error_t (*map)(void *stream, const void **buf, size_t *count);
+
+    // Write all specified segments with a single call. Optional, must
+    // be nil for streams that write the segments one by one.
+    huf_error_t (*writev)(void *stream, const huf_segment_t *segments, size_t count);
 } huf_read_writer_t;
 
 
+// Mode of the file read-writers.
+typedef enum {
+    // The file is opened for reading starting from the
+    // current position of the file.
+    HUF_IO_READ,
+
+    // The file is opened for writing starting from the
+    // current position of the file.
+    HUF_IO_WRITE,
+} huf_io_mode_t;
+
+
 huf_error_t huf_memopen(huf_read_writer_t **self, void **buf, size_t capacity);
 huf_error_t huf_memlen(const huf_read_writer_t *self, size_t *len);
 huf_error_t huf_memcap(const huf_read_writer_t *self, size_t *cap);
 huf_error_t huf_memrewind(huf_read_writer_t *self);
 huf_error_t huf_memclose(huf_read_writer_t **self);
 
+// Open the memory stream, that appends the data into a chain of the
+// fixed-size segments, so the written data is never moved. Segments
+// are returned as an array, valid until the next write to the stream.
+// Truncated stream keeps the segments for the following writes. If the
+// allocator is nil, then the default allocator is used.
+huf_error_t huf_segopen(huf_read_writer_t **self, size_t segment_size,
+        const huf_allocator_t *allocator);
+huf_error_t huf_seglen(const huf_read_writer_t *self, size_t *len);
+huf_error_t huf_segments(const huf_read_writer_t *self,
+        const huf_segment_t **segments, size_t *count);
+huf_error_t huf_segrewind(huf_read_writer_t *self);
+huf_error_t huf_segtruncate(huf_read_writer_t *self, size_t len);
+huf_error_t huf_segclose(huf_read_writer_t **self);
+
 huf_error_t huf_fdopen(huf_read_writer_t **self, int fd);
 huf_error_t huf_fdclose(huf_read_writer_t **self);
 
+// Map the regular file into the memory. The mapping of the file opened
+// for writing grows on writes, so the file should be opened for both
+// reading and writing.
+huf_error_t huf_mmapopen(huf_read_writer_t **self, int fd, huf_io_mode_t mode);
+huf_error_t huf_mmapclose(huf_read_writer_t **self);
+
+// Open the file for asynchronous reads or writes through the io_uring
+// interface, so several requests are in flight while the data of the
+// previous ones is processed. Errors of the asynchronous writes are
+// returned by the following writes or by the close. When io_uring is
+// not supported, the file is read and written synchronously.
+huf_error_t huf_uringopen(huf_read_writer_t **self, int fd, huf_io_mode_t mode);
+huf_error_t huf_uringclose(huf_read_writer_t **self);
+
 
 #undef CFFI_huffman_io_h__
 #endif // INCLUDE_huffman_io_h__
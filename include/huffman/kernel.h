@@ -0,0 +1,123 @@
+#ifndef INCLUDE_huffman_kernel_h__
+#define INCLUDE_huffman_kernel_h__
+
+#include "huffman/bufio.h"
+#include "huffman/common.h"
+#include "huffman/config.h"
+#include "huffman/errors.h"
+#include "huffman/tree.h"
+
+// Maximum length of the code packed by the encoding kernel.
+#define HUF_KERNEL_CODE_LEN 56
+
+// Count of the stream bits resolved by a single lookup
+// into the decoding table.
+#define HUF_DECODE_TABLE_BITS 11
+
+// Length of the decoding table.
+#define HUF_DECODE_TABLE_LEN (1 << HUF_DECODE_TABLE_BITS)
+
+
+// A packed code of the symbol.
+typedef struct __huf_code {
+    // Bits of the code, the first bit of the code is the most
+    // significant bit of the word.
+    uint64_t bits;
+
+    // Length of the code in bits.
+    size_t length;
+} huf_code_t;
+
+
+// A writer of the bit stream, that accumulates bits in the
+// 64-bit register.
+typedef struct __huf_bit_writer {
+    // Pending bits, the next bit to write is the most significant
+    // bit of the register.
+    uint64_t bits;
+
+    // Count of the pending bits.
+    size_t count;
+} huf_bit_writer_t;
+
+
+// A decoding table, each element of the table contains a symbol
+// (the lowest 8 bits) and the length of its code for every prefix
+// of the bit stream. The zero element means that the code is longer
+// than the prefix.
+typedef struct __huf_decode_table {
+    uint16_t elements[HUF_DECODE_TABLE_LEN];
+} huf_decode_table_t;
+
+
+// Build the decoding table from the Huffman tree.
+huf_error_t
+huf_decode_table_init(huf_decode_table_t *self, const huf_tree_t *tree);
+
+
+// Enumeration of the kernels builds.
+typedef enum {
+    // Builds for any processor.
+    HUF_KERNELS_PORTABLE,
+
+    // Builds for processors with BMI2 extension.
+    HUF_KERNELS_BMI2,
+} huf_kernels_kind_t;
+
+
+// A set of hot encoding and decoding routines.
+typedef struct __huf_kernels {
+    // Kind of the kernels build.
+    huf_kernels_kind_t kind;
+
+    // Name of the kernels build.
+    const char *name;
+
+    // Increase the frequency of each byte of the buffer by one.
+    void (*histogram)(uint64_t *frequencies, const uint8_t *buf, size_t len);
+
+    // Pack codes of the symbols into the output and return the count
+    // of bytes written. All codes should be at most HUF_KERNEL_CODE_LEN
+    // bits long, and the output should have 8 bytes more than written.
+    // Bits of the incomplete byte are kept in the writer.
+    size_t (*encode)(huf_bit_writer_t *writer, const huf_code_t *codes,
+            const uint8_t *buf, size_t len, uint8_t *out);
+
+    // Decode the specified count of symbols from the bit stream.
+    huf_error_t (*decode)(huf_bit_reader_t *reader,
+            const huf_decode_table_t *table, const huf_node_t *root,
+            uint8_t *out, size_t len);
+
+    // Decode the specified count of symbols from each of the
+    // HUF_INTERLEAVED_STREAMS bit streams in the same loop.
+    huf_error_t (*decode_streams)(huf_bit_reader_t *readers,
+            const huf_decode_table_t *table, const huf_node_t *root,
+            uint8_t **out, const uint64_t *lens);
+} huf_kernels_t;
+
+
+// Return kernels of the specified kind, or nil when the
+// processor does not support them.
+const huf_kernels_t*
+huf_kernels_lookup(huf_kernels_kind_t kind);
+
+
+// Return the fastest kernels supported by the processor.
+const huf_kernels_t*
+huf_kernels_default(void);
+
+
+// Return the boundaries of the symbols encoded into the specified
+// stream of the interleaved block. All streams except the last one
+// are of the same length, the last stream takes the remainder.
+static inline void
+huf_stream_bounds(uint64_t len, size_t stream, uint64_t *begin, uint64_t *end)
+{
+    uint64_t segment = (len + HUF_INTERLEAVED_STREAMS - 1) / HUF_INTERLEAVED_STREAMS;
+
+    *begin = segment * stream < len ? segment * stream : len;
+    *end = *begin + segment < len ? *begin + segment : len;
+}
+
+
+#endif // INCLUDE_huffman_kernel_h__
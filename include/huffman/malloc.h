@@ -6,10 +6,46 @@
 
 #define CFFI_huffman_malloc_h__
 
+// huf_allocator_t represents a source of the memory. The allocator
+// with nil alloc function uses malloc and free of the standard library.
+typedef struct __huf_allocator {
+    // Allocate the memory block of the specified size in bytes, the
+    // content of the memory block is not initialized. Returns nil,
+    // when the memory could not be allocated.
+    void* (*alloc)(void *ctx, size_t size);
+
+    // Release the memory block allocated by the alloc function. Could
+    // be set to nil, when the memory is released by the owner of the
+    // allocator all at once.
+    void (*free)(void *ctx, void *ptr);
+
+    // Context passed to the allocator functions.
+    void *ctx;
+} huf_allocator_t;
+
+
 // Allocate the memory block of the specified size.
 huf_error_t
 huf_malloc(void** ptr, size_t size, size_t num);
 
 
+// Allocate the memory block of the specified size with the allocator,
+// the content of the memory block is not initialized. If the allocator
+// is nil, then the default allocator is used.
+huf_error_t
+huf_alloc(const huf_allocator_t *allocator, void **ptr, size_t size, size_t num);
+
+
+// Allocate the zero-filled memory block of the specified
+// size with the allocator.
+huf_error_t
+huf_calloc(const huf_allocator_t *allocator, void **ptr, size_t size, size_t num);
+
+
+// Release the memory block allocated with the allocator.
+void
+huf_free(const huf_allocator_t *allocator, void *ptr);
+
+
 #undef CFFI_huffman_malloc_h__
 #endif // INCLUDE_huffman_malloc_h__
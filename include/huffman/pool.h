@@ -0,0 +1,69 @@
+#ifndef INCLUDE_huffman_pool_h__
+#define INCLUDE_huffman_pool_h__
+
+#include "huffman/common.h"
+#include "huffman/errors.h"
+#include "huffman/malloc.h"
+
+// Size of the largest buffer cached by the pool, larger
+// buffers are allocated and released directly.
+#define HUF_POOL_MAX_SIZE 4194304
+
+// Maximum size in bytes of the buffers cached by each thread.
+#define HUF_POOL_CACHE_SIZE 2097152
+
+// Default size in bytes of the buffers shared between the threads.
+#define HUF_POOL_CAPACITY 33554432
+
+#define CFFI_huffman_pool_h__
+
+// huf_pool_t represents a thread-safe pool of the buffers. Released
+// buffers are kept in the cache of the releasing thread, so they are
+// reused without locks, the overflow of the cache is shared between
+// all threads of the pool.
+typedef struct __huf_pool huf_pool_t;
+
+
+// Initialize a new instance of the pool, that shares up to the
+// capacity bytes between the threads. If the capacity is set to
+// zero, then HUF_POOL_CAPACITY is used.
+huf_error_t
+huf_pool_init(huf_pool_t **self, size_t capacity);
+
+
+// Release memory occupied by the pool and all cached buffers. The
+// pool must not be used by any other thread at the same time.
+huf_error_t
+huf_pool_free(huf_pool_t **self);
+
+
+// Return the process-wide pool used by the encoders and the
+// decoders without an allocator.
+huf_error_t
+huf_pool_default(huf_pool_t **pool);
+
+
+// Take the buffer of at least the specified size from the pool,
+// the content of the buffer is not initialized.
+huf_error_t
+huf_pool_get(huf_pool_t *self, void **buf, size_t size);
+
+
+// Return the buffer to the pool.
+void
+huf_pool_put(huf_pool_t *self, void *buf);
+
+
+// Fill the allocator, that takes the memory from the pool.
+huf_error_t
+huf_pool_allocator(huf_pool_t *self, huf_allocator_t *allocator);
+
+
+// Fill the allocator, that takes the memory from the process-wide
+// pool, when the alloc function of the allocator is not set.
+huf_error_t
+huf_pool_default_allocator(huf_allocator_t *allocator);
+
+
+#undef CFFI_huffman_pool_h__
+#endif // INCLUDE_huffman_pool_h__
@@ -0,0 +1,47 @@
+#ifndef INCLUDE_huffman_probe_h__
+#define INCLUDE_huffman_probe_h__
+
+// Static tracepoints of the library, the probes of the "huffman"
+// provider are attached with bpftrace or perf, e.g.:
+//
+//  bpftrace -e 'usdt:./libhuffman.so:huffman:encode_block_end {
+//      @ratio = hist(arg0 * 100 / arg1); }'
+//
+// The probes are built only with the HUF_USDT definition, otherwise
+// they are compiled out, and the arguments are only evaluated. Enabled
+// probes cost a single no-op instruction, until the tracer is attached.
+
+#ifdef HUF_USDT
+
+#include <sys/sdt.h>
+
+#define huf_probe1_m(name, arg1) \
+    DTRACE_PROBE1(huffman, name, arg1) \
+
+
+#define huf_probe2_m(name, arg1, arg2) \
+    DTRACE_PROBE2(huffman, name, arg1, arg2) \
+
+
+#define huf_probe3_m(name, arg1, arg2, arg3) \
+    DTRACE_PROBE3(huffman, name, arg1, arg2, arg3) \
+
+
+#else
+
+#define huf_probe1_m(name, arg1) \
+    do { (void)(arg1); } while (0) \
+
+
+#define huf_probe2_m(name, arg1, arg2) \
+    do { (void)(arg1); (void)(arg2); } while (0) \
+
+
+#define huf_probe3_m(name, arg1, arg2, arg3) \
+    do { (void)(arg1); (void)(arg2); (void)(arg3); } while (0) \
+
+
+#endif // HUF_USDT
+
+
+#endif // INCLUDE_huffman_probe_h__
@@ -0,0 +1,72 @@
+#ifndef INCLUDE_huffman_queue_h__
+#define INCLUDE_huffman_queue_h__
+
+#include <pthread.h>
+
+#include "huffman/common.h"
+#include "huffman/errors.h"
+#include "huffman/malloc.h"
+
+
+// huf_queue_t represents a bounded queue of pointers, that
+// passes items between threads.
+typedef struct __huf_queue {
+    // Ring of the queued items.
+    void **items;
+
+    // Maximum count of the queued items.
+    size_t capacity;
+
+    // Position of the first item in the ring.
+    size_t head;
+
+    // Count of the queued items.
+    size_t length;
+
+    // Non-zero value when no more items are pushed.
+    int closed;
+
+    // Mutex guarding the queue.
+    pthread_mutex_t mutex;
+
+    // Signaled when an item is pushed or the queue is closed.
+    pthread_cond_t not_empty;
+
+    // Signaled when an item is popped or the queue is closed.
+    pthread_cond_t not_full;
+
+    // Allocator of the queue.
+    const huf_allocator_t *allocator;
+} huf_queue_t;
+
+
+// Initialize a new instance of the queue with the
+// specified capacity.
+huf_error_t
+huf_queue_init(huf_queue_t **self, size_t capacity,
+        const huf_allocator_t *allocator);
+
+
+// Release memory occupied by the queue.
+huf_error_t
+huf_queue_free(huf_queue_t **self);
+
+
+// Push the item to the end of the queue, wait while the queue is
+// full. Items could not be pushed to the closed queue.
+huf_error_t
+huf_queue_push(huf_queue_t *self, void *item);
+
+
+// Pop the item from the beginning of the queue, wait while the queue
+// is empty. Nil item is returned when the queue is closed and empty.
+huf_error_t
+huf_queue_pop(huf_queue_t *self, void **item);
+
+
+// Close the queue and wake up all waiting threads.
+huf_error_t
+huf_queue_close(huf_queue_t *self);
+
+
+#endif // INCLUDE_huffman_queue_h__
@@ -0,0 +1,92 @@
+#ifndef INCLUDE_huffman_stats_h__
+#define INCLUDE_huffman_stats_h__
+
+#include "huffman/common.h"
+#include "huffman/errors.h"
+#include "huffman/malloc.h"
+
+#define CFFI_huffman_stats_h__
+
+// huf_stats_t describes the single run of the encoder or decoder. The
+// statistics are reset in the beginning of each run.
+typedef struct __huf_stats {
+    // Count of the bytes read from the reader.
+    uint64_t bytes_in;
+
+    // Count of the bytes written to the writer.
+    uint64_t bytes_out;
+
+    // Count of the encoded or decoded blocks.
+    uint64_t blocks;
+
+    // Count of the encoded bytes taken by the headers: lengths of
+    // the blocks and trees, serialized trees, tables of the stream
+    // lengths, and headers and end markers of the frames.
+    uint64_t header_bytes;
+
+    // Count of the encoded bytes taken by the bit streams.
+    uint64_t payload_bytes;
+
+    // Count of the encoded or decoded symbols.
+    uint64_t symbols;
+
+    // Total length of the codes of the symbols in bits. The decoder
+    // counts the bits of the bit streams, including the padding.
+    uint64_t code_bits;
+
+    // Length of the longest code in bits, which is the depth of
+    // the deepest Huffman tree.
+    uint64_t max_depth;
+
+    // Time in nanoseconds spent on the histograms of the blocks.
+    uint64_t histogram_ns;
+
+    // Time in nanoseconds spent on the construction, serialization
+    // and de-serialization of the Huffman trees and code tables.
+    uint64_t tree_ns;
+
+    // Time in nanoseconds spent on the encoding or decoding of the
+    // bit streams, including the writes of the encoded data.
+    uint64_t coding_ns;
+
+    // Time in nanoseconds of the whole run.
+    uint64_t total_ns;
+
+    // Count of the memory blocks taken from the allocator.
+    uint64_t allocations;
+} huf_stats_t;
+
+
+// Return the average length of the code in bits per symbol.
+double
+huf_stats_code_length(const huf_stats_t *self);
+
+
+#undef CFFI_huffman_stats_h__
+
+
+// huf_stats_allocator_t counts the allocations of the wrapped allocator.
+typedef struct __huf_stats_allocator {
+    // Wrapped allocator.
+    huf_allocator_t allocator;
+
+    // Statistics updated by the allocator.
+    huf_stats_t *stats;
+} huf_stats_allocator_t;
+
+
+// Return the monotonic time in nanoseconds, or zero when the
+// statistics are nil, so the clock is read only on demand.
+uint64_t
+huf_stats_clock(const huf_stats_t *self);
+
+
+// Replace the allocator with the one counting the allocations in the
+// statistics. The wrapper keeps the original allocator and must
+// outlive the replaced allocator.
+huf_error_t
+huf_stats_allocator(huf_stats_allocator_t *self, huf_stats_t *stats,
+        huf_allocator_t *allocator);
+
+
+#endif // INCLUDE_huffman_stats_h__
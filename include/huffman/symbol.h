@@ -3,6 +3,7 @@
 
 #include <huffman/common.h>
 #include <huffman/errors.h>
+#include <huffman/malloc.h>
 
 #define CFFI_huffman_symbol_h__
 
@@ -13,6 +14,9 @@ typedef struct __huf_symbol_mapping_element {
 
     // Binary symbol coding.
     uint8_t *coding;
+
+    // Allocator of the element.
+    const huf_allocator_t *allocator;
 } huf_symbol_mapping_element_t;
 
 
@@ -25,6 +29,16 @@ huf_symbol_mapping_element_init(
         size_t length);
 
 
+// Initialize a new instance of the symbol mapping element. If the
+// allocator is nil, then the default allocator is used.
+huf_error_t
+huf_symbol_mapping_element_init_allocator(
+        huf_symbol_mapping_element_t **self,
+        const uint8_t *coding,
+        size_t length,
+        const huf_allocator_t *allocator);
+
+
 // Release memory occupied by the symbol
 // mapping element.
 huf_error_t
@@ -39,6 +53,9 @@ typedef struct __huf_symbol_mapping {
 
     // Array of the symbols encodings.
     huf_symbol_mapping_element_t **symbols;
+
+    // Allocator of the mapping.
+    const huf_allocator_t *allocator;
 } huf_symbol_mapping_t;
 
 
@@ -49,6 +66,15 @@ huf_symbol_mapping_init(
         size_t length);
 
 
+// Initialize a new instance of the symbol mapping. The allocator must
+// outlive the mapping, if nil, then the default allocator is used.
+huf_error_t
+huf_symbol_mapping_init_allocator(
+        huf_symbol_mapping_t **self,
+        size_t length,
+        const huf_allocator_t *allocator);
+
+
 // Release memory occupied by the symbol mapping.
 huf_error_t
 huf_symbol_mapping_free(
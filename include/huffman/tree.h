@@ -4,6 +4,7 @@
 #include "huffman/common.h"
 #include "huffman/errors.h"
 #include "huffman/histogram.h"
+#include "huffman/malloc.h"
 
 // The count of ASCII symbols
 #define HUF_ASCII_COUNT 256
@@ -50,6 +51,9 @@ typedef struct __huf_tree {
 
     // Root element of the Huffman tree.
     huf_node_t *root;
+
+    // Allocator of the tree nodes.
+    const huf_allocator_t *allocator;
 } huf_tree_t;
 
 
@@ -58,6 +62,12 @@ huf_error_t
 huf_tree_init(huf_tree_t **self);
 
 
+// Initialize a new instance of the Huffman tree. The allocator must
+// outlive the tree, if nil, then the default allocator is used.
+huf_error_t
+huf_tree_init_allocator(huf_tree_t **self, const huf_allocator_t *allocator);
+
+
 // Release memory occupied by the Huffman tree.
 huf_error_t
 huf_tree_free(huf_tree_t **self);
@@ -82,5 +92,11 @@ huf_error_t
 huf_tree_from_histogram(huf_tree_t *self, huf_histogram_t *histogram);
 
 
+// Return in the depth argument the depth of the Huffman tree, which
+// is the length of the longest code in bits.
+huf_error_t
+huf_tree_depth(const huf_tree_t *self, size_t *depth);
+
+
 #undef CFFI_huffman_tree_h__
 #endif // INCLUDE_huffman_tree_h__
@@ -4,7 +4,7 @@ from setuptools import setup
 
 setup(
     name="huffmanfile",
-    version="1.0.3",
+    version="2.0.0",
 
     long_description=Path("README.md").read_text(),
     long_description_content_type="text/markdown",
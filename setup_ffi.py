@@ -29,14 +29,18 @@ def make_library_header(headers: List[str]) -> str:
 
 headers = [
     "huffman/errors.h",
+    "huffman/malloc.h",
+    "huffman/pool.h",
     "huffman/io.h",
+    "huffman/stats.h",
     "huffman/config.h",
     "huffman/common.h",
+    "huffman/compress.h",
+    "huffman/frame.h",
     "huffman/decoder.h",
     "huffman/encoder.h",
     "huffman/bufio.h",
     "huffman/histogram.h",
-    "huffman/malloc.h",
     "huffman/symbol.h",
     "huffman/sys.h",
     "huffman/tree.h",
@@ -44,15 +48,22 @@ headers = [
 
 sources = [
     "src/bufio.c",
+    "src/compress.c",
     "src/config.c",
     "src/decoder.c",
     "src/encoder.c",
     "src/errors.c",
+    "src/frame.c",
     "src/histogram.c",
     "src/io.c",
+    "src/kernel.c",
     "src/malloc.c",
+    "src/pool.c",
+    "src/queue.c",
+    "src/stats.c",
     "src/symbol.c",
     "src/tree.c",
+    "src/uring.c",
 ]
 
 
@@ -62,6 +73,7 @@ ffibuilder.set_source(
     make_library_header(headers),
     include_dirs=["include"],
     sources=sources,
+    libraries=["pthread"],
 )
 ffibuilder.cdef(make_library_prototypes(headers))
 
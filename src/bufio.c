@@ -2,6 +2,7 @@
 
 #include "huffman/bufio.h"
 #include "huffman/malloc.h"
+#include "huffman/probe.h"
 #include "huffman/sys.h"
 
 
@@ -32,6 +33,178 @@ huf_bit_read_writer_reset(huf_bit_read_writer_t *self)
 }
 
 
+// Initialize the bit reader with the specified memory window.
+void
+huf_bit_reader_init(huf_bit_reader_t *self, const void *buf, size_t len)
+{
+    self->bits = 0;
+    self->count = 0;
+    self->ptr = buf;
+    self->end = self->ptr + len;
+    self->bufio = NULL;
+}
+
+
+// Attach the bit reader to the window of the buffered reader,
+// the window is refilled from the buffered reader on demand.
+huf_error_t
+huf_bit_reader_attach(huf_bit_reader_t *self, huf_bufio_read_writer_t *bufio)
+{
+    routine_m();
+    routine_param_m(self);
+    routine_param_m(bufio);
+
+    huf_bit_reader_init(self, NULL, 0);
+    self->bufio = bufio;
+
+    if (bufio->capacity) {
+        self->ptr = bufio->bytes + bufio->offset;
+        self->end = bufio->bytes + bufio->length;
+    }
+
+    routine_yield_m();
+}
+
+
+// Mark bytes before the bit reader position as read in
+// the buffered reader.
+static void
+__huf_bit_reader_sync(huf_bit_reader_t *self)
+{
+    huf_bufio_read_writer_t *bufio = self->bufio;
+
+    // Unbuffered reader accounts the bytes on read.
+    if (!bufio->capacity) {
+        return;
+    }
+
+    size_t offset = self->ptr - bufio->bytes;
+
+    bufio->have_been_processed += offset - bufio->offset;
+    bufio->offset = offset;
+}
+
+
+// Skip the bits remaining in the current byte and return bytes
+// loaded but not consumed by the bit reader back to the buffered
+// reader, so it could be read again.
+huf_error_t
+huf_bit_reader_detach(huf_bit_reader_t *self)
+{
+    routine_m();
+    routine_param_m(self);
+    routine_param_m(self->bufio);
+
+    // The rest of the partially consumed byte is a padding.
+    self->ptr -= self->count / 8;
+    self->bits = 0;
+    self->count = 0;
+
+    __huf_bit_reader_sync(self);
+    self->bufio = NULL;
+
+    routine_yield_m();
+}
+
+
+// Read the next window of the bit reader from the buffered reader.
+static huf_error_t
+__huf_bit_reader_fill(huf_bit_reader_t *self)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_bufio_read_writer_t *bufio = self->bufio;
+
+    size_t len = 0;
+
+    if (!bufio->capacity) {
+        // Read only a single byte from the unbuffered reader.
+        len = sizeof(self->byte);
+
+        err = __read_m(bufio->read_writer, &self->byte, &len);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        bufio->have_been_processed += len;
+
+        self->ptr = &self->byte;
+        self->end = self->ptr + len;
+
+        routine_success_m();
+    }
+
+    // The whole window was consumed, so it's safe to overwrite it.
+    __huf_bit_reader_sync(self);
+
+    bufio->offset = 0;
+    bufio->length = bufio->capacity;
+
+    err = __read_m(bufio->read_writer, bufio->bytes, &bufio->length);
+    if (err != HUF_ERROR_SUCCESS) {
+        bufio->length = 0;
+        routine_error_m(err);
+    }
+
+    huf_probe1_m(bufio_refill, bufio->length);
+
+    self->ptr = bufio->bytes;
+    self->end = bufio->bytes + bufio->length;
+
+    routine_yield_m();
+}
+
+
+// Load as many bytes as possible into the register. For the reader
+// attached to the unbuffered reader, the next byte is read only when
+// the register is empty, so no bytes past the stream are consumed.
+huf_error_t
+huf_bit_reader_refill(huf_bit_reader_t *self)
+{
+    routine_m();
+    routine_param_m(self);
+
+    if (self->end - self->ptr >= 8) {
+        huf_error_t err = huf_bit_reader_fill(self);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        routine_success_m();
+    }
+
+    while (self->count < 56) {
+        if (self->ptr == self->end) {
+            // Bytes of the previous window could be returned to the buffered
+            // reader only before the window is refilled, so refill it, when
+            // the register does not keep whole bytes.
+            if (!self->bufio || self->count >= 8) {
+                break;
+            }
+            if (!self->bufio->capacity && self->count) {
+                break;
+            }
+
+            huf_error_t err = __huf_bit_reader_fill(self);
+            if (err != HUF_ERROR_SUCCESS) {
+                routine_error_m(err);
+            }
+
+            // There is no more data in the reader.
+            if (self->ptr == self->end) {
+                break;
+            }
+        }
+
+        self->bits |= (uint64_t)(*self->ptr++) << (56 - self->count);
+        self->count += 8;
+    }
+
+    routine_yield_m();
+}
+
+
 // Initialize a new instance of the read-write buffer
 // with the specified size in bytes.
 huf_error_t
@@ -39,6 +212,19 @@ huf_bufio_read_writer_init(
         huf_bufio_read_writer_t **self,
         huf_read_writer_t *read_writer,
         size_t capacity)
+{
+    return huf_bufio_read_writer_init_allocator(self, read_writer, capacity, NULL);
+}
+
+
+// Initialize a new instance of the read-write buffer with the
+// specified size in bytes and allocator.
+huf_error_t
+huf_bufio_read_writer_init_allocator(
+        huf_bufio_read_writer_t **self,
+        huf_read_writer_t *read_writer,
+        size_t capacity,
+        const huf_allocator_t *allocator)
 {
     routine_m();
 
@@ -47,13 +233,14 @@ huf_bufio_read_writer_init(
     routine_param_m(self);
     routine_param_m(read_writer);
 
-    huf_error_t err = huf_malloc(void_pptr_m(&self_ptr),
+    huf_error_t err = huf_calloc(allocator, void_pptr_m(&self_ptr),
             sizeof(huf_bufio_read_writer_t), 1);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     *self = self_ptr;
+    self_ptr->allocator = allocator;
 
     // If zero value provided for capacity, then use 64 KiB buffer by default.
     //if (!capacity) {
@@ -61,7 +248,9 @@ huf_bufio_read_writer_init(
     //}
 
     if (capacity) {
-        err = huf_malloc(void_pptr_m(&self_ptr->bytes), sizeof(uint8_t), capacity);
+        // The buffer is always written before it is read.
+        err = huf_alloc(allocator, void_pptr_m(&self_ptr->bytes),
+                sizeof(uint8_t), capacity);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
@@ -83,8 +272,10 @@ huf_bufio_read_writer_free(huf_bufio_read_writer_t **self)
 
     huf_bufio_read_writer_t *self_ptr = *self;
 
-    free(self_ptr->bytes);
-    free(self_ptr);
+    if (!self_ptr->mapped) {
+        huf_free(self_ptr->allocator, self_ptr->bytes);
+    }
+    huf_free(self_ptr->allocator, self_ptr);
 
     *self = NULL;
 
@@ -92,6 +283,47 @@ huf_bufio_read_writer_free(huf_bufio_read_writer_t **self)
 }
 
 
+// Use the memory of the read-writer as a reader buffer, so bytes are
+// read without copying.
+huf_error_t
+huf_bufio_read_writer_map(huf_bufio_read_writer_t *self)
+{
+    routine_m();
+    routine_param_m(self);
+
+    huf_read_writer_t *read_writer = self->read_writer;
+
+    const void *buf = NULL;
+    size_t len = 0;
+
+    if (!read_writer->map || self->mapped) {
+        routine_success_m();
+    }
+
+    // Bytes of the buffer would be lost otherwise.
+    if (self->offset != self->length) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    huf_error_t err = read_writer->map(read_writer->stream, &buf, &len);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    huf_free(self->allocator, self->bytes);
+
+    // The buffer is never written, since there is
+    // nothing to read into it.
+    self->bytes = (uint8_t*)buf;
+    self->offset = 0;
+    self->length = len;
+    self->capacity = len;
+    self->mapped = 1;
+
+    routine_yield_m();
+}
+
+
 // Flush the writer buffer.
 huf_error_t
 huf_bufio_read_writer_flush(huf_bufio_read_writer_t *self)
@@ -109,8 +341,8 @@ huf_bufio_read_writer_flush(huf_bufio_read_writer_t *self)
         routine_error_m(err);
     }
 
+    huf_probe1_m(bufio_flush, self->length);
     self->length = 0;
-    self->have_been_processed += self->length;
 
     routine_yield_m();
 }
@@ -130,8 +362,10 @@ __huf_bufio_read_writer_flush(huf_bufio_read_writer_t *self)
             routine_error_m(err);
         }
 
-        // Renew byte length
-        self->have_been_processed += self->length;
+        huf_probe1_m(bufio_flush, self->length);
+
+        // Renew byte length, the bytes are already counted as
+        // processed when they were written into the buffer.
         self->length = 0;
 
         if (self->length) {
@@ -191,6 +425,38 @@ huf_bufio_write(huf_bufio_read_writer_t *self, const void *buf, size_t len)
 }
 
 
+// Read at least the specified amount of bytes into the buffer of the
+// specified capacity. Pipes and sockets return fewer bytes than requested,
+// so the reader is read until the request is satisfied or the reader
+// is exhausted.
+static huf_error_t
+__huf_bufio_read_least(huf_read_writer_t *read_writer, uint8_t *buf,
+        size_t capacity, size_t least, size_t *len)
+{
+    routine_m();
+
+    *len = 0;
+
+    while (*len < least) {
+        size_t count = capacity - *len;
+
+        huf_error_t err = __read_m(read_writer, buf + *len, &count);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        // There is no more data in the reader.
+        if (!count) {
+            break;
+        }
+
+        *len += count;
+    }
+
+    routine_yield_m();
+}
+
+
 // Read the specified amount of bytes from the reader buffer
 // starting from the provided pointer.
 huf_error_t
@@ -237,8 +503,8 @@ huf_bufio_read(huf_bufio_read_writer_t *self, void *buf, size_t len)
     // than buffer capacity, then just read it directly to the
     // destination buffer.
     if (len >= self->capacity) {
-        size_t rem_len = len;
-        err = __read_m(self->read_writer, buf_ptr, &rem_len);
+        size_t rem_len = 0;
+        err = __huf_bufio_read_least(self->read_writer, buf_ptr, len, len, &rem_len);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
@@ -256,17 +522,17 @@ huf_bufio_read(huf_bufio_read_writer_t *self, void *buf, size_t len)
         routine_success_m();
     }
 
-    // Try to fill available buffer.
-    self->length = self->capacity;
-
     // In case when buffer size is larger that requested
     // data. Read bytes into buffer first and then copy
     // bytes to the destination.
-    err = __read_m(self->read_writer, self->bytes, &self->length);
+    err = __huf_bufio_read_least(self->read_writer, self->bytes,
+            self->capacity, len, &self->length);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
+    huf_probe1_m(bufio_refill, self->length);
+
     // There is still not enough memory to satisfy the request, exit with an error.
     if (len > self->length) {
         routine_error_m(HUF_ERROR_READ_WRITE);
@@ -287,6 +553,142 @@ huf_bufio_read(huf_bufio_read_writer_t *self, void *buf, size_t len)
 }
 
 
+// Return the pointer to the bytes of the reader buffer without copying
+// them, the buffer is refilled when it keeps fewer bytes than requested.
+huf_error_t
+huf_bufio_peek(huf_bufio_read_writer_t *self, const uint8_t **buf, size_t *len)
+{
+    routine_m();
+
+    routine_param_m(self);
+    routine_param_m(buf);
+    routine_param_m(len);
+
+    // Unbuffered reader does not keep any bytes.
+    if (!self->capacity) {
+        *buf = NULL;
+        *len = 0;
+        routine_success_m();
+    }
+
+    size_t available = self->length - self->offset;
+    size_t requested = *len;
+
+    if (requested > self->capacity) {
+        requested = self->capacity;
+    }
+
+    // The mapped buffer already keeps the rest of the stream.
+    if (available < requested && !self->mapped) {
+        // Move the remaining bytes to the beginning of the buffer,
+        // so the requested bytes are placed next to them.
+        memmove(self->bytes, self->bytes + self->offset, available);
+
+        self->offset = 0;
+        self->length = available;
+
+        while (self->length < requested) {
+            size_t read_len = self->capacity - self->length;
+
+            huf_error_t err = __read_m(self->read_writer,
+                    self->bytes + self->length, &read_len);
+            if (err != HUF_ERROR_SUCCESS) {
+                routine_error_m(err);
+            }
+
+            // There is no more data in the reader.
+            if (!read_len) {
+                break;
+            }
+
+            self->length += read_len;
+        }
+
+        huf_probe1_m(bufio_refill, self->length - available);
+    }
+
+    *buf = self->bytes + self->offset;
+    *len = self->length - self->offset;
+
+    routine_yield_m();
+}
+
+
+// Mark the specified amount of bytes returned by the peek as read.
+huf_error_t
+huf_bufio_consume(huf_bufio_read_writer_t *self, size_t len)
+{
+    routine_m();
+    routine_param_m(self);
+
+    if (len > self->length - self->offset) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    self->offset += len;
+    self->have_been_processed += len;
+
+    routine_yield_m();
+}
+
+
+// Return the pointer to the free space of the writer buffer, the
+// buffer is flushed when it has less free space than requested.
+huf_error_t
+huf_bufio_reserve(huf_bufio_read_writer_t *self, uint8_t **buf, size_t *len)
+{
+    routine_m();
+
+    routine_param_m(self);
+    routine_param_m(buf);
+    routine_param_m(len);
+
+    // Unbuffered writer does not have any space.
+    if (!self->capacity) {
+        *buf = NULL;
+        *len = 0;
+        routine_success_m();
+    }
+
+    size_t requested = *len;
+
+    if (requested > self->capacity) {
+        requested = self->capacity;
+    }
+
+    if (self->capacity - self->length < requested) {
+        huf_error_t err = huf_bufio_read_writer_flush(self);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+    }
+
+    *buf = self->bytes + self->length;
+    *len = self->capacity - self->length;
+
+    routine_yield_m();
+}
+
+
+// Mark the specified amount of bytes written into the reserved
+// space as written.
+huf_error_t
+huf_bufio_commit(huf_bufio_read_writer_t *self, size_t len)
+{
+    routine_m();
+    routine_param_m(self);
+
+    if (len > self->capacity - self->length) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    self->length += len;
+    self->have_been_processed += len;
+
+    routine_yield_m();
+}
+
+
 // Read the 8-bits word from the reader buffer into the specified pointer.
 huf_error_t
 huf_bufio_read_uint8(huf_bufio_read_writer_t *self, uint8_t *byte)
@@ -0,0 +1,1554 @@
+#include <pthread.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "huffman/compress.h"
+#include "huffman/frame.h"
+#include "huffman/histogram.h"
+#include "huffman/kernel.h"
+#include "huffman/malloc.h"
+#include "huffman/pool.h"
+#include "huffman/sys.h"
+#include "huffman/tree.h"
+
+
+// Length of the memory arena, that fits the histogram, the Huffman
+// tree and the nodes of the longest serialized tree.
+#define HUF_COMPRESS_ARENA_LEN (HUF_1KIB_BUFFER * 40)
+
+// Length of the buffer used to pack the tail of the block, when the
+// destination buffer does not fit the unconditional stores.
+#define HUF_COMPRESS_TAIL_LEN 64
+
+// Length of the buffer of the data encoded from the memory segments.
+#define HUF_ENCODEV_BUFFER_LEN HUF_64KIB_BUFFER
+
+// Length of the buffer used to decode the bit stream around the
+// borders of the memory segments.
+#define HUF_DECODEV_BRIDGE_LEN 256
+
+
+// huf_arena_t represents the memory on the stack, that is
+// released all at once.
+typedef struct __huf_arena {
+    // Memory of the arena.
+    uint8_t bytes[HUF_COMPRESS_ARENA_LEN];
+
+    // Length of the allocated memory.
+    size_t length;
+} huf_arena_t;
+
+
+static void*
+__huf_arena_alloc(void *ctx, size_t size)
+{
+    huf_arena_t *arena = ctx;
+
+    // Keep the alignment of the allocated blocks.
+    size = (size + 15) & ~(size_t)15;
+
+    if (size > sizeof(arena->bytes) - arena->length) {
+        return NULL;
+    }
+
+    void *ptr = arena->bytes + arena->length;
+    arena->length += size;
+
+    return ptr;
+}
+
+
+// Return the maximum length of the compressed data of the specified
+// length. A single Huffman code can be longer than 8 bits, but the
+// average length never is, since a fixed 8-bit code is a valid prefix
+// code as well, so only the headers of the blocks are added.
+size_t
+huf_compress_bound(size_t len)
+{
+    size_t blocks = len / HUF_COMPRESS_BLOCKSIZE + 1;
+
+    return len + blocks * HUF_COMPRESS_BLOCK_OVERHEAD;
+}
+
+
+// huf_cursor_t is a position in the array of the memory segments.
+typedef struct __huf_cursor {
+    // Segments of the memory.
+    const huf_segment_t *segments;
+    size_t count;
+
+    // Position of the cursor.
+    size_t index;
+    size_t offset;
+} huf_cursor_t;
+
+
+// Initialize the cursor at the beginning of the segments.
+static void
+__huf_cursor_init(huf_cursor_t *self, const huf_segment_t *segments, size_t count)
+{
+    self->segments = segments;
+    self->count = count;
+    self->index = 0;
+    self->offset = 0;
+}
+
+
+// Return the memory starting from the cursor position, the length is
+// reduced to the length of the contiguous part. Empty segments are
+// skipped, zero length is returned at the end of the segments.
+static uint8_t*
+__huf_cursor_peek(huf_cursor_t *self, size_t *len)
+{
+    while (self->index < self->count &&
+            self->offset >= self->segments[self->index].len) {
+        self->index++;
+        self->offset = 0;
+    }
+
+    if (self->index == self->count) {
+        *len = 0;
+        return NULL;
+    }
+
+    size_t available = self->segments[self->index].len - self->offset;
+    if (*len > available) {
+        *len = available;
+    }
+
+    return (uint8_t*)self->segments[self->index].base + self->offset;
+}
+
+
+// Move the cursor forward by the specified count of bytes.
+static void
+__huf_cursor_advance(huf_cursor_t *self, size_t len)
+{
+    while (len > 0) {
+        size_t chunk = len;
+        if (!__huf_cursor_peek(self, &chunk)) {
+            break;
+        }
+
+        self->offset += chunk;
+        len -= chunk;
+    }
+}
+
+
+// Move the cursor backward by the specified count of bytes.
+static void
+__huf_cursor_rewind(huf_cursor_t *self, size_t len)
+{
+    while (len > self->offset && self->index > 0) {
+        len -= self->offset;
+        self->index--;
+        self->offset = self->segments[self->index].len;
+    }
+
+    self->offset -= len < self->offset ? len : self->offset;
+}
+
+
+// Copy the specified count of bytes into the buffer and move the
+// cursor forward. Returns the count of copied bytes.
+static size_t
+__huf_cursor_read(huf_cursor_t *self, void *buf, size_t len)
+{
+    uint8_t *buf_ptr = buf;
+    size_t copied = 0;
+
+    while (copied < len) {
+        size_t chunk = len - copied;
+        const uint8_t *ptr = __huf_cursor_peek(self, &chunk);
+        if (!ptr) {
+            break;
+        }
+
+        memcpy(buf_ptr + copied, ptr, chunk);
+        self->offset += chunk;
+        copied += chunk;
+    }
+
+    return copied;
+}
+
+
+// Return the count of bytes after the cursor position.
+static uint64_t
+__huf_cursor_len(const huf_cursor_t *self)
+{
+    uint64_t len = 0;
+
+    for (size_t index = self->index; index < self->count; index++) {
+        len += self->segments[index].len;
+    }
+
+    return len - (self->index < self->count ? self->offset : 0);
+}
+
+
+// huf_coding_t holds the Huffman coding of the compressed blocks.
+typedef struct __huf_coding {
+    // Serialized Huffman tree.
+    int16_t tree_head[HUF_BTREE_LEN];
+    size_t tree_length;
+
+    // Packed codes of the symbols.
+    huf_code_t codes[HUF_ASCII_COUNT];
+
+    // Length of the longest code.
+    size_t max_length;
+} huf_coding_t;
+
+
+// Pack the codes of the leaves by walking the tree from each
+// leaf to the root. Returns the length of the longest code.
+static size_t
+__huf_compress_codes(const huf_tree_t *tree, huf_code_t *codes)
+{
+    size_t max_length = 0;
+
+    memset(codes, 0, sizeof(huf_code_t) * HUF_ASCII_COUNT);
+
+    for (size_t index = 0; index < HUF_ASCII_COUNT; index++) {
+        const huf_node_t *node = tree->leaves[index];
+        if (!node) {
+            continue;
+        }
+
+        while (node->parent && codes[index].length < 64) {
+            uint64_t bit = node->parent->right == node;
+
+            codes[index].bits = (codes[index].bits >> 1) | (bit << 63);
+            codes[index].length++;
+            node = node->parent;
+        }
+
+        if (codes[index].length > max_length) {
+            max_length = codes[index].length;
+        }
+    }
+
+    return max_length;
+}
+
+
+// Build the Huffman coding from the frequencies of the symbols of
+// the specified count of bytes starting from the cursor position.
+static huf_error_t
+__huf_coding_init(huf_coding_t *self, huf_cursor_t cursor, uint64_t len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_arena_t arena;
+    huf_histogram_t *histogram = NULL;
+    huf_tree_t *tree = NULL;
+
+    arena.length = 0;
+    huf_allocator_t allocator = {__huf_arena_alloc, NULL, &arena};
+
+    err = huf_histogram_init_allocator(&histogram, 1, HUF_HISTOGRAM_LEN, &allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    while (len > 0) {
+        size_t chunk = len;
+        const uint8_t *buf = __huf_cursor_peek(&cursor, &chunk);
+
+        if (!chunk) {
+            routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+        }
+
+        err = huf_histogram_populate(histogram, buf, chunk);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        __huf_cursor_advance(&cursor, chunk);
+        len -= chunk;
+    }
+
+    err = huf_tree_init_allocator(&tree, &allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_tree_from_histogram(tree, histogram);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_tree_serialize(tree, self->tree_head, &self->tree_length);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // Blocks are short enough to keep the codes in the packing kernel.
+    self->max_length = __huf_compress_codes(tree, self->codes);
+    if (self->max_length > HUF_KERNEL_CODE_LEN) {
+        routine_error_m(HUF_ERROR_FATAL);
+    }
+
+    routine_yield_m();
+}
+
+
+// Compress the block into the destination buffer, the block is preceded
+// by its length and the serialized Huffman tree. The tree of the shared
+// coding is not written, its length is set to zero instead.
+static huf_error_t
+__huf_compress_block(const huf_coding_t *coding, int shared, uint8_t *dst,
+        size_t dst_cap, const uint8_t *src, uint64_t len, size_t *dst_len)
+{
+    routine_m();
+
+    huf_bit_writer_t bit_writer = {0};
+    uint8_t tail[HUF_COMPRESS_TAIL_LEN];
+
+    const huf_kernels_t *kernels = huf_kernels_default();
+
+    size_t tree_length = shared ? 0 : coding->tree_length;
+    int16_t actual_tree_length = tree_length;
+
+    size_t header_len = sizeof(len) + sizeof(actual_tree_length) +
+        tree_length * sizeof(int16_t);
+
+    if (dst_cap < header_len) {
+        routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+    }
+
+    memcpy(dst, &len, sizeof(len));
+    memcpy(dst + sizeof(len), &actual_tree_length, sizeof(actual_tree_length));
+    memcpy(dst + sizeof(len) + sizeof(actual_tree_length), coding->tree_head,
+            tree_length * sizeof(int16_t));
+
+    uint8_t *out = dst + header_len;
+    uint8_t *out_end = dst + dst_cap;
+
+    while (len > 0) {
+        uint8_t *window = out;
+        size_t available = out_end - out;
+
+        // The kernel writes 8 bytes past the encoded data, so the tail
+        // of the block is packed into the separate buffer.
+        if (available < sizeof(tail)) {
+            window = tail;
+            available = sizeof(tail);
+        }
+
+        size_t chunk = ((available - 8) * 8 - 7) / coding->max_length;
+        if (chunk > len) {
+            chunk = len;
+        }
+
+        size_t written = kernels->encode(&bit_writer, coding->codes, src, chunk, window);
+
+        if (window == tail) {
+            if (written > (size_t)(out_end - out)) {
+                routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+            }
+
+            memcpy(out, tail, written);
+        }
+
+        out += written;
+        src += chunk;
+        len -= chunk;
+    }
+
+    // Write the last incomplete byte.
+    if (bit_writer.count) {
+        if (out == out_end) {
+            routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+        }
+
+        *out++ = bit_writer.bits >> 56;
+    }
+
+    *dst_len = out - dst;
+
+    routine_yield_m();
+}
+
+
+// Compress the source buffer into the destination buffer in the
+// format of the single stream encoder.
+huf_error_t
+huf_compress(void *dst, size_t dst_cap, const void *src, size_t src_len,
+        size_t *dst_len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_coding_t coding;
+
+    uint8_t *dst_ptr = dst;
+    const uint8_t *src_ptr = src;
+
+    size_t written = 0;
+
+    routine_param_m(dst);
+    routine_param_m(dst_len);
+
+    if (src_len) {
+        routine_param_m(src);
+    }
+
+    *dst_len = 0;
+
+    while (src_len > 0) {
+        size_t chunk = src_len;
+        if (chunk > HUF_COMPRESS_BLOCKSIZE) {
+            chunk = HUF_COMPRESS_BLOCKSIZE;
+        }
+
+        huf_segment_t block = {(void*)src_ptr, chunk};
+        huf_cursor_t cursor;
+
+        __huf_cursor_init(&cursor, &block, 1);
+
+        err = __huf_coding_init(&coding, cursor, chunk);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        err = __huf_compress_block(&coding, 0, dst_ptr, dst_cap,
+                src_ptr, chunk, &written);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        dst_ptr += written;
+        dst_cap -= written;
+        *dst_len += written;
+
+        src_ptr += chunk;
+        src_len -= chunk;
+    }
+
+    routine_yield_m();
+}
+
+
+// huf_compress_job_t is the state shared by the threads of the
+// parallel compression.
+typedef struct __huf_compress_job {
+    uint8_t *dst;
+    const uint8_t *src;
+    uint64_t src_len;
+    uint64_t blocksize;
+
+    // Bound of the compressed block, each block is compressed into
+    // its own part of the destination buffer of this length.
+    size_t block_bound;
+
+    // Compressed lengths of the blocks.
+    size_t *lens;
+    size_t blocks;
+
+    // Index of the next block to compress.
+    size_t next;
+
+    // The first error of the threads.
+    huf_error_t error;
+} huf_compress_job_t;
+
+
+// Compress the blocks of the job, until all blocks are taken
+// by the threads, or one of the threads fails.
+static void*
+__huf_compress_worker(void *arg)
+{
+    huf_compress_job_t *job = arg;
+
+    for (;;) {
+        size_t index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+
+        if (index >= job->blocks ||
+                __atomic_load_n(&job->error, __ATOMIC_RELAXED) != HUF_ERROR_SUCCESS) {
+            break;
+        }
+
+        uint64_t offset = index * job->blocksize;
+        uint64_t len = job->src_len - offset;
+        if (len > job->blocksize) {
+            len = job->blocksize;
+        }
+
+        huf_error_t err = huf_compress(job->dst + index * job->block_bound,
+                huf_compress_bound(len), job->src + offset, len, &job->lens[index]);
+        if (err != HUF_ERROR_SUCCESS) {
+            __atomic_store_n(&job->error, err, __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
+
+// Return the maximum length of the compressed data split into the
+// blocks, each block is compressed separately.
+size_t
+huf_compress_parallel_bound(size_t len, size_t blocksize)
+{
+    if (!blocksize) {
+        return huf_compress_bound(len);
+    }
+
+    size_t tail = len % blocksize;
+    size_t bound = len / blocksize * huf_compress_bound(blocksize);
+
+    return tail ? bound + huf_compress_bound(tail) : bound;
+}
+
+
+// Compress the blocks of the source buffer with the specified count
+// of threads, the calling thread compresses the blocks as well.
+huf_error_t
+huf_compress_parallel(void *dst, size_t dst_cap, const void *src,
+        size_t src_len, size_t blocksize, size_t threads, size_t *dst_len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_allocator_t allocator = {0};
+    huf_compress_job_t job = {0};
+
+    pthread_t workers[HUF_COMPRESS_THREADS_MAX];
+    size_t started = 0;
+
+    routine_param_m(dst);
+    routine_param_m(dst_len);
+
+    if (src_len) {
+        routine_param_m(src);
+    }
+    if (!blocksize) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    *dst_len = 0;
+
+    job.blocks = src_len / blocksize + (src_len % blocksize != 0);
+
+    if (threads > job.blocks) {
+        threads = job.blocks;
+    }
+    if (threads > HUF_COMPRESS_THREADS_MAX) {
+        threads = HUF_COMPRESS_THREADS_MAX;
+    }
+
+    // Blocks compressed in a single thread are written one after another.
+    if (threads <= 1) {
+        for (size_t offset = 0; offset < src_len; offset += blocksize) {
+            size_t len = src_len - offset < blocksize ? src_len - offset : blocksize;
+            size_t written = 0;
+
+            err = huf_compress((uint8_t*)dst + *dst_len, dst_cap - *dst_len,
+                    (const uint8_t*)src + offset, len, &written);
+            if (err != HUF_ERROR_SUCCESS) {
+                routine_error_m(err);
+            }
+
+            *dst_len += written;
+        }
+
+        routine_success_m();
+    }
+
+    job.dst = dst;
+    job.src = src;
+    job.src_len = src_len;
+    job.blocksize = blocksize;
+    job.block_bound = huf_compress_bound(blocksize);
+
+    // Each block is compressed into its own part of the buffer.
+    if (dst_cap < huf_compress_parallel_bound(src_len, blocksize)) {
+        routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+    }
+
+    err = huf_pool_default_allocator(&allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_alloc(&allocator, void_pptr_m(&job.lens), sizeof(size_t), job.blocks);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // When the thread could not be started, the blocks are compressed
+    // by the threads started before.
+    for (; started < threads - 1; started++) {
+        if (pthread_create(&workers[started], NULL, __huf_compress_worker, &job)) {
+            break;
+        }
+    }
+
+    __huf_compress_worker(&job);
+
+    for (size_t index = 0; index < started; index++) {
+        pthread_join(workers[index], NULL);
+    }
+
+    if (job.error != HUF_ERROR_SUCCESS) {
+        routine_error_m(job.error);
+    }
+
+    // Join the compressed blocks in order.
+    for (size_t index = 0; index < job.blocks; index++) {
+        memmove((uint8_t*)dst + *dst_len, job.dst + index * job.block_bound,
+                job.lens[index]);
+        *dst_len += job.lens[index];
+    }
+
+    routine_ensure_m();
+    huf_free(&allocator, job.lens);
+
+    routine_defer_m();
+}
+
+// Compress each of the source buffers into the destination buffer, so
+// each output could be decompressed independently.
+huf_error_t
+huf_encode_batch(void *dst, size_t dst_cap, const huf_segment_t *srcs,
+        huf_segment_t *dsts, size_t count, huf_segment_t *table)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_coding_t coding;
+
+    uint8_t *dst_ptr = dst;
+    size_t written = 0;
+
+    routine_param_m(dst);
+
+    if (count) {
+        routine_param_m(srcs);
+        routine_param_m(dsts);
+    }
+
+    if (table) {
+        huf_cursor_t cursor;
+        __huf_cursor_init(&cursor, srcs, count);
+
+        err = __huf_coding_init(&coding, cursor, __huf_cursor_len(&cursor));
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        int16_t tree_length = coding.tree_length;
+        size_t table_len = sizeof(tree_length) + coding.tree_length * sizeof(int16_t);
+
+        if (dst_cap < table_len) {
+            routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+        }
+
+        // The table is written once before all outputs.
+        memcpy(dst_ptr, &tree_length, sizeof(tree_length));
+        memcpy(dst_ptr + sizeof(tree_length), coding.tree_head,
+                coding.tree_length * sizeof(int16_t));
+
+        table->base = dst_ptr;
+        table->len = table_len;
+
+        dst_ptr += table_len;
+        dst_cap -= table_len;
+    }
+
+    for (size_t index = 0; index < count; index++) {
+        const uint8_t *src = srcs[index].base;
+        size_t src_len = srcs[index].len;
+
+        err = HUF_ERROR_BUFFER_OVERFLOW;
+
+        // Buffers expanded by the shared coding carry their own tree.
+        if (table) {
+            size_t cap = sizeof(uint64_t) + sizeof(int16_t) + src_len;
+            if (cap > dst_cap) {
+                cap = dst_cap;
+            }
+
+            err = __huf_compress_block(&coding, 1, dst_ptr, cap,
+                    src, src_len, &written);
+        }
+
+        if (err == HUF_ERROR_BUFFER_OVERFLOW) {
+            err = huf_compress(dst_ptr, dst_cap, src, src_len, &written);
+        }
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        dsts[index].base = dst_ptr;
+        dsts[index].len = written;
+
+        dst_ptr += written;
+        dst_cap -= written;
+    }
+
+    routine_yield_m();
+}
+
+
+// Write the pending header of the block and the encoded data.
+static huf_error_t
+__huf_encodev_flush(huf_read_writer_t *writer, const uint8_t *header,
+        size_t *header_len, const uint8_t *buf, size_t *len)
+{
+    routine_m();
+
+    huf_error_t err = HUF_ERROR_SUCCESS;
+
+    huf_segment_t segments[2];
+    size_t count = 0;
+
+    if (*header_len) {
+        segments[count].base = (void*)header;
+        segments[count++].len = *header_len;
+    }
+
+    if (*len) {
+        segments[count].base = (void*)buf;
+        segments[count++].len = *len;
+    }
+
+    if (count && writer->writev) {
+        err = writer->writev(writer->stream, segments, count);
+    } else {
+        for (size_t index = 0; index < count && err == HUF_ERROR_SUCCESS; index++) {
+            err = writer->write(writer->stream, segments[index].base,
+                    segments[index].len);
+        }
+    }
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    *header_len = 0;
+    *len = 0;
+
+    routine_yield_m();
+}
+
+
+// Encode the block starting from the cursor position into the writer,
+// the block is preceded by its length and the serialized Huffman tree.
+static huf_error_t
+__huf_encodev_block(const huf_coding_t *coding, huf_read_writer_t *writer,
+        uint8_t *buf, huf_cursor_t *cursor, uint64_t len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_bit_writer_t bit_writer = {0};
+
+    uint8_t header[HUF_COMPRESS_BLOCK_OVERHEAD];
+    int16_t tree_length = coding->tree_length;
+
+    const huf_kernels_t *kernels = huf_kernels_default();
+
+    size_t header_len = sizeof(len) + sizeof(tree_length) +
+        coding->tree_length * sizeof(int16_t);
+    size_t used = 0;
+
+    memcpy(header, &len, sizeof(len));
+    memcpy(header + sizeof(len), &tree_length, sizeof(tree_length));
+    memcpy(header + sizeof(len) + sizeof(tree_length), coding->tree_head,
+            coding->tree_length * sizeof(int16_t));
+
+    while (len > 0) {
+        size_t piece = len;
+        const uint8_t *src = __huf_cursor_peek(cursor, &piece);
+
+        if (!piece) {
+            routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+        }
+
+        __huf_cursor_advance(cursor, piece);
+        len -= piece;
+
+        // Symbols of the segments are packed into the same bit stream.
+        while (piece > 0) {
+            size_t available = HUF_ENCODEV_BUFFER_LEN - used;
+
+            // The kernel writes 8 bytes past the encoded data.
+            if (available < HUF_COMPRESS_TAIL_LEN) {
+                err = __huf_encodev_flush(writer, header, &header_len, buf, &used);
+                if (err != HUF_ERROR_SUCCESS) {
+                    routine_error_m(err);
+                }
+
+                available = HUF_ENCODEV_BUFFER_LEN;
+            }
+
+            size_t chunk = ((available - 8) * 8 - 7) / coding->max_length;
+            if (chunk > piece) {
+                chunk = piece;
+            }
+
+            used += kernels->encode(&bit_writer, coding->codes, src, chunk, buf + used);
+            src += chunk;
+            piece -= chunk;
+        }
+    }
+
+    // Write the last incomplete byte, the buffer always has the
+    // space of the unconditional stores.
+    if (bit_writer.count) {
+        buf[used++] = bit_writer.bits >> 56;
+    }
+
+    err = __huf_encodev_flush(writer, header, &header_len, buf, &used);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
+
+
+// Encode the data gathered from the memory segments into the writer
+// in the format of the single stream encoder.
+huf_error_t
+huf_encodev(huf_read_writer_t *writer, const struct iovec *iov, int iovcnt)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_coding_t coding;
+    huf_cursor_t cursor;
+    huf_allocator_t allocator = {0};
+
+    uint8_t *buf = NULL;
+
+    routine_param_m(writer);
+
+    if (iovcnt < 0 || (iovcnt && !iov)) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    // Segments have the layout of the struct iovec, as asserted in io.c.
+    __huf_cursor_init(&cursor, (const huf_segment_t*)iov, iovcnt);
+    uint64_t len = __huf_cursor_len(&cursor);
+
+    err = huf_pool_default_allocator(&allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_alloc(&allocator, void_pptr_m(&buf), sizeof(uint8_t),
+            HUF_ENCODEV_BUFFER_LEN);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    while (len > 0) {
+        uint64_t chunk = len;
+        if (chunk > HUF_COMPRESS_BLOCKSIZE) {
+            chunk = HUF_COMPRESS_BLOCKSIZE;
+        }
+
+        err = __huf_coding_init(&coding, cursor, chunk);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        err = __huf_encodev_block(&coding, writer, buf, &cursor, chunk);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        len -= chunk;
+    }
+
+    routine_ensure_m();
+    huf_free(&allocator, buf);
+
+    routine_defer_m();
+}
+
+
+// huf_decoding_t holds the Huffman decoding of the decompressed blocks.
+typedef struct __huf_decoding {
+    // Memory of the Huffman tree.
+    huf_arena_t arena;
+
+    // Huffman tree of the decoding.
+    huf_tree_t *tree;
+
+    // Decoding table built from the tree.
+    huf_decode_table_t table;
+} huf_decoding_t;
+
+
+// Build the Huffman decoding from the serialized tree, the tree
+// is copied, since the source buffer could be unaligned.
+static huf_error_t
+__huf_decoding_init(huf_decoding_t *self, const uint8_t *buf, size_t tree_length)
+{
+    routine_m();
+
+    huf_error_t err;
+    int16_t tree_head[HUF_BTREE_LEN];
+
+    self->arena.length = 0;
+    self->tree = NULL;
+
+    huf_allocator_t allocator = {__huf_arena_alloc, NULL, &self->arena};
+
+    memcpy(tree_head, buf, tree_length * sizeof(int16_t));
+
+    err = huf_tree_init_allocator(&self->tree, &allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_tree_deserialize(self->tree, tree_head, tree_length);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_decode_table_init(&self->table, self->tree);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
+
+
+// Decompress the block from the source buffer into the destination
+// buffer. Blocks without the tree are decoded with the shared decoding.
+// Lengths of the read and written data are returned.
+static huf_error_t
+__huf_decompress_block(const huf_decoding_t *shared, uint8_t *dst,
+        size_t dst_cap, const uint8_t *src, size_t src_len,
+        size_t *dst_len, size_t *src_read)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_decoding_t decoding;
+    huf_bit_reader_t reader;
+
+    const huf_decoding_t *block_decoding = shared;
+    const uint8_t *src_begin = src;
+
+    uint64_t len = 0;
+    int16_t tree_length = 0;
+
+    if (src_len < sizeof(len) + sizeof(tree_length)) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    memcpy(&len, src, sizeof(len));
+    memcpy(&tree_length, src + sizeof(len), sizeof(tree_length));
+
+    src += sizeof(len) + sizeof(tree_length);
+    src_len -= sizeof(len) + sizeof(tree_length);
+
+    // The length of the serialized Huffman tree can't be greater than 1024 bytes.
+    if (tree_length < 0 || tree_length > HUF_BTREE_LEN) {
+        routine_error_m(HUF_ERROR_BTREE_OVERFLOW);
+    }
+
+    if (src_len < tree_length * sizeof(int16_t)) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    if (len > dst_cap) {
+        routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+    }
+
+    if (tree_length) {
+        err = __huf_decoding_init(&decoding, src, tree_length);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        block_decoding = &decoding;
+    }
+
+    src += tree_length * sizeof(int16_t);
+    src_len -= tree_length * sizeof(int16_t);
+
+    if (len && (!block_decoding || !block_decoding->tree->root)) {
+        routine_error_m(HUF_ERROR_BTREE_CORRUPTED);
+    }
+
+    huf_bit_reader_init(&reader, src, src_len);
+
+    if (len) {
+        err = huf_kernels_default()->decode(&reader, &block_decoding->table,
+                block_decoding->tree->root, dst, len);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+    }
+
+    // The rest of the partially consumed byte is a padding, and
+    // the whole bytes of the register belong to the next block.
+    const uint8_t *src_end = reader.ptr - reader.count / 8;
+
+    *dst_len = len;
+    *src_read = src_end - src_begin;
+
+    routine_yield_m();
+}
+
+
+// Decompress the frame from the source buffer, the length of the
+// decompressed data and the length of the frame are returned.
+static huf_error_t
+__huf_decompress_frame(uint8_t *dst, size_t dst_cap, const uint8_t *src,
+        size_t src_len, size_t *dst_len, size_t *src_read)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_frame_t frame;
+
+    size_t written = 0;
+    size_t read = src_len;
+    uint64_t blocksize = 0;
+
+    *dst_len = 0;
+
+    err = huf_frame_read(&frame, src, &read);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    *src_read = read;
+    src += read;
+    src_len -= read;
+
+    if (frame.flags & HUF_FRAME_SKIPPABLE) {
+        if (frame.size > src_len) {
+            routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+        }
+
+        *src_read += frame.size;
+        routine_success_m();
+    }
+
+    // Blocks are decompressed as single streams.
+    if (frame.flags & HUF_FRAME_INTERLEAVED) {
+        routine_error_m(HUF_ERROR_FRAME_UNSUPPORTED);
+    }
+
+    // Fail before the decompression, when the content doesn't fit.
+    if ((frame.flags & HUF_FRAME_CONTENT_SIZE) && frame.size > dst_cap) {
+        routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+    }
+
+    for (;;) {
+        if (src_len < sizeof(blocksize)) {
+            routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+        }
+
+        memcpy(&blocksize, src, sizeof(blocksize));
+
+        if (blocksize == HUF_FRAME_END) {
+            *src_read += sizeof(blocksize);
+            break;
+        }
+
+        err = __huf_decompress_block(NULL, dst, dst_cap, src, src_len,
+                &written, &read);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        dst += written;
+        dst_cap -= written;
+        *dst_len += written;
+
+        src += read;
+        src_len -= read;
+        *src_read += read;
+    }
+
+    if ((frame.flags & HUF_FRAME_CONTENT_SIZE) && *dst_len != frame.size) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    routine_yield_m();
+}
+
+
+// Decompress all blocks of the source buffer.
+static huf_error_t
+__huf_decompress(const huf_decoding_t *shared, uint8_t *dst, size_t dst_cap,
+        const uint8_t *src, size_t src_len, size_t *dst_len)
+{
+    routine_m();
+
+    huf_error_t err;
+
+    size_t written = 0;
+    size_t read = 0;
+
+    *dst_len = 0;
+
+    while (src_len > 0) {
+        // Frames are distinguished from the blocks by the signature.
+        if (!shared && src_len >= HUF_FRAME_MAGIC_LEN &&
+                !memcmp(src, HUF_FRAME_MAGIC, HUF_FRAME_MAGIC_LEN)) {
+            err = __huf_decompress_frame(dst, dst_cap, src, src_len,
+                    &written, &read);
+        } else {
+            err = __huf_decompress_block(shared, dst, dst_cap, src, src_len,
+                    &written, &read);
+        }
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        dst += written;
+        dst_cap -= written;
+        *dst_len += written;
+
+        src += read;
+        src_len -= read;
+    }
+
+    routine_yield_m();
+}
+
+
+// Decompress the source buffer encoded by the single stream encoder
+// into the destination buffer.
+huf_error_t
+huf_decompress(void *dst, size_t dst_cap, const void *src, size_t src_len,
+        size_t *dst_len)
+{
+    routine_m();
+
+    routine_param_m(dst);
+    routine_param_m(dst_len);
+
+    if (src_len) {
+        routine_param_m(src);
+    }
+
+    huf_error_t err = __huf_decompress(NULL, dst, dst_cap, src, src_len, dst_len);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
+
+
+// Decompress the output of the batch compressed with the shared table.
+huf_error_t
+huf_decompress_shared(void *dst, size_t dst_cap, const void *table,
+        size_t table_len, const void *src, size_t src_len, size_t *dst_len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_decoding_t decoding;
+
+    const uint8_t *table_ptr = table;
+    int16_t tree_length = 0;
+
+    routine_param_m(dst);
+    routine_param_m(table);
+    routine_param_m(dst_len);
+
+    if (src_len) {
+        routine_param_m(src);
+    }
+
+    if (table_len < sizeof(tree_length)) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    memcpy(&tree_length, table_ptr, sizeof(tree_length));
+
+    if (tree_length < 0 || tree_length > HUF_BTREE_LEN) {
+        routine_error_m(HUF_ERROR_BTREE_OVERFLOW);
+    }
+
+    if (table_len - sizeof(tree_length) < tree_length * sizeof(int16_t)) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    err = __huf_decoding_init(&decoding, table_ptr + sizeof(tree_length), tree_length);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = __huf_decompress(&decoding, dst, dst_cap, src, src_len, dst_len);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
+
+
+// Decode the block starting from the input cursor position into the
+// segments of the output cursor. The bit stream is decoded in place, only
+// the bytes around the borders of the segments are copied into the bridge.
+static huf_error_t
+__huf_decodev_block(huf_cursor_t *in, huf_cursor_t *out, uint64_t *dst_cap,
+        size_t *dst_len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_decoding_t decoding;
+    huf_bit_reader_t reader;
+
+    int16_t tree_head[HUF_BTREE_LEN];
+    uint8_t bridge[HUF_DECODEV_BRIDGE_LEN];
+
+    uint64_t len = 0;
+    int16_t tree_length = 0;
+
+    const huf_kernels_t *kernels = huf_kernels_default();
+
+    if (__huf_cursor_read(in, &len, sizeof(len)) != sizeof(len) ||
+            __huf_cursor_read(in, &tree_length, sizeof(tree_length)) != sizeof(tree_length)) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    // The length of the serialized Huffman tree can't be greater than 1024 bytes.
+    if (tree_length < 0 || tree_length > HUF_BTREE_LEN) {
+        routine_error_m(HUF_ERROR_BTREE_OVERFLOW);
+    }
+
+    size_t tree_size = tree_length * sizeof(int16_t);
+    if (__huf_cursor_read(in, tree_head, tree_size) != tree_size) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    if (len > *dst_cap) {
+        routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+    }
+
+    err = __huf_decoding_init(&decoding, (const uint8_t*)tree_head, tree_length);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    const huf_node_t *root = decoding.tree->root;
+
+    // Each code fits into the window of the bridge length.
+    size_t max_length = 0;
+    err = huf_tree_depth(decoding.tree, &max_length);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (len && (!max_length || max_length > HUF_DECODEV_BRIDGE_LEN * 8)) {
+        routine_error_m(HUF_ERROR_BTREE_CORRUPTED);
+    }
+
+    huf_bit_reader_init(&reader, NULL, 0);
+
+    *dst_cap -= len;
+    *dst_len = len;
+
+    while (len > 0) {
+        size_t window_len = HUF_DECODEV_BRIDGE_LEN;
+        const uint8_t *window = __huf_cursor_peek(in, &window_len);
+
+        // Bytes around the border of the segments are decoded from the
+        // bridge, that keeps the end of the segment and the beginning of
+        // the following segments.
+        if (window_len < HUF_DECODEV_BRIDGE_LEN) {
+            huf_cursor_t bridge_cursor = *in;
+
+            window_len = __huf_cursor_read(&bridge_cursor, bridge, sizeof(bridge));
+            window = bridge;
+        } else {
+            window_len = in->segments[in->index].len - in->offset;
+        }
+
+        reader.ptr = window;
+        reader.end = window + window_len;
+
+        size_t piece = len;
+        uint8_t *dst = __huf_cursor_peek(out, &piece);
+
+        if (!piece) {
+            routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+        }
+
+        // Decode only symbols, which codes are in the window for sure,
+        // unless the window keeps the rest of the input.
+        uint64_t count = (window_len * 8 + reader.count) / max_length;
+        if (window_len < HUF_DECODEV_BRIDGE_LEN || count > piece) {
+            count = piece;
+        }
+
+        err = kernels->decode(&reader, &decoding.table, root, dst, count);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        __huf_cursor_advance(in, reader.ptr - window);
+        __huf_cursor_advance(out, count);
+        len -= count;
+    }
+
+    // The rest of the partially consumed byte is a padding, and
+    // the whole bytes of the register belong to the next block.
+    __huf_cursor_rewind(in, reader.count / 8);
+
+    routine_yield_m();
+}
+
+
+// Decode the data gathered from the memory segments into the memory
+// segments of the destination.
+huf_error_t
+huf_decodev(const struct iovec *dst, int dstcnt, const struct iovec *src,
+        int srccnt, size_t *dst_len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_cursor_t in, out;
+
+    size_t written = 0;
+
+    routine_param_m(dst_len);
+
+    if (dstcnt < 0 || (dstcnt && !dst) || srccnt < 0 || (srccnt && !src)) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    // Segments have the layout of the struct iovec, as asserted in io.c.
+    __huf_cursor_init(&in, (const huf_segment_t*)src, srccnt);
+    __huf_cursor_init(&out, (const huf_segment_t*)dst, dstcnt);
+
+    uint64_t dst_cap = __huf_cursor_len(&out);
+
+    *dst_len = 0;
+
+    while (__huf_cursor_len(&in) > 0) {
+        err = __huf_decodev_block(&in, &out, &dst_cap, &written);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        *dst_len += written;
+    }
+
+    routine_yield_m();
+}
+
+
+// Consume the header of the frame, the frame could be skippable,
+// otherwise the blocks of the frame are decompressed by the next calls.
+static huf_error_t
+__huf_decompress_next_frame(huf_decompressor_t *self, const uint8_t *src,
+        size_t src_len, size_t *src_read)
+{
+    routine_m();
+
+    huf_frame_t frame;
+    size_t read = src_len;
+
+    huf_error_t err = huf_frame_read(&frame, src, &read);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (frame.flags & HUF_FRAME_SKIPPABLE) {
+        self->skip = frame.size;
+    } else if (frame.flags & HUF_FRAME_INTERLEAVED) {
+        // Blocks are decompressed as single streams.
+        routine_error_m(HUF_ERROR_FRAME_UNSUPPORTED);
+    } else {
+        self->frame = 1;
+        self->flags = frame.flags;
+        self->size = frame.size;
+        self->written = 0;
+    }
+
+    *src_read = read;
+
+    routine_yield_m();
+}
+
+
+// Decompress the next block of the source buffer into the destination
+// buffer, the data split across the source buffers is decompressed
+// once the whole block is available.
+huf_error_t
+huf_decompress_next(huf_decompressor_t *self, void *dst, size_t dst_cap,
+        const void *src, size_t src_len, int last, size_t *dst_len,
+        size_t *src_read)
+{
+    routine_m();
+
+    huf_error_t err;
+
+    const uint8_t *src_ptr = src;
+
+    uint64_t len = 0;
+    int16_t tree_length = 0;
+    size_t header_len = sizeof(len) + sizeof(tree_length);
+
+    routine_param_m(self);
+    routine_param_m(dst_len);
+    routine_param_m(src_read);
+
+    if (src_len) {
+        routine_param_m(src);
+    }
+    if (dst_cap) {
+        routine_param_m(dst);
+    }
+
+    *dst_len = 0;
+    *src_read = 0;
+
+    self->src_need = 0;
+    self->dst_need = 0;
+
+    if (!src_len) {
+        // The stream could end only between the frames.
+        if (last && (self->frame || self->skip)) {
+            routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+        }
+
+        self->src_need = !last;
+        routine_success_m();
+    }
+
+    // The data of the skippable frame is consumed as it comes.
+    if (self->skip) {
+        *src_read = src_len < self->skip ? src_len : self->skip;
+        self->skip -= *src_read;
+
+        routine_success_m();
+    }
+
+    if (!self->frame) {
+        if (src_len < HUF_FRAME_MAGIC_LEN) {
+            if (last) {
+                routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+            }
+
+            self->src_need = header_len;
+            routine_success_m();
+        }
+
+        // The header of the frame is always followed by at least
+        // the end marker, so the header is read at once.
+        if (!memcmp(src_ptr, HUF_FRAME_MAGIC, HUF_FRAME_MAGIC_LEN)) {
+            if (src_len < HUF_FRAME_HEADER_LEN && !last) {
+                self->src_need = HUF_FRAME_HEADER_LEN;
+                routine_success_m();
+            }
+
+            err = __huf_decompress_next_frame(self, src_ptr, src_len, src_read);
+            if (err != HUF_ERROR_SUCCESS) {
+                routine_error_m(err);
+            }
+
+            routine_success_m();
+        }
+    } else {
+        if (src_len < sizeof(len)) {
+            if (last) {
+                routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+            }
+
+            self->src_need = sizeof(len);
+            routine_success_m();
+        }
+
+        memcpy(&len, src_ptr, sizeof(len));
+
+        if (len == HUF_FRAME_END) {
+            if ((self->flags & HUF_FRAME_CONTENT_SIZE) && self->written != self->size) {
+                routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+            }
+
+            self->frame = 0;
+            *src_read = sizeof(len);
+
+            routine_success_m();
+        }
+    }
+
+    if (src_len < header_len) {
+        if (last) {
+            routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+        }
+
+        self->src_need = header_len;
+        routine_success_m();
+    }
+
+    memcpy(&len, src_ptr, sizeof(len));
+    memcpy(&tree_length, src_ptr + sizeof(len), sizeof(tree_length));
+
+    // The length of the serialized Huffman tree can't be greater than 1024 bytes.
+    if (tree_length < 0 || tree_length > HUF_BTREE_LEN) {
+        routine_error_m(HUF_ERROR_BTREE_OVERFLOW);
+    }
+
+    header_len += tree_length * sizeof(int16_t);
+
+    if (len > SIZE_MAX - header_len) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    // Codes take at least one bit per symbol, so the shorter block is
+    // incomplete. It's checked before the destination buffer is requested,
+    // so the length of the corrupted block is not trusted.
+    if (src_len < header_len + len / 8) {
+        if (last) {
+            routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+        }
+
+        self->src_need = header_len + len / 8;
+        routine_success_m();
+    }
+
+    if (len > dst_cap) {
+        self->dst_need = len;
+        routine_success_m();
+    }
+
+    err = __huf_decompress_block(NULL, dst, dst_cap, src_ptr, src_len,
+            dst_len, src_read);
+
+    // The stream of the block ends past the source buffer. Codes are rarely
+    // longer than a byte on average, so the whole block is expected in the
+    // buffer of the block length, otherwise the buffer is doubled.
+    if (err == HUF_ERROR_READ_WRITE && !last) {
+        *dst_len = 0;
+        *src_read = 0;
+
+        self->src_need = header_len + len;
+        if (self->src_need <= src_len) {
+            self->src_need = src_len * 2;
+        }
+
+        routine_success_m();
+    }
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (self->frame) {
+        self->written += *dst_len;
+    }
+
+    routine_yield_m();
+}
@@ -3,9 +3,14 @@
 
 #include "huffman/bufio.h"
 #include "huffman/decoder.h"
+#include "huffman/frame.h"
 #include "huffman/malloc.h"
 #include "huffman/sys.h"
 #include "huffman/io.h"
+#include "huffman/kernel.h"
+#include "huffman/pool.h"
+#include "huffman/probe.h"
+#include "huffman/stats.h"
 #include "huffman/tree.h"
 
 
@@ -16,9 +21,6 @@ struct __huf_decoder {
     // Stores leaves and the root of the Huffman tree.
     huf_tree_t *huffman_tree;
 
-    // last_node stores pointer of the last decoded byte.
-    huf_node_t *last_node;
-
     // Read-writer instance.
     huf_read_writer_t *read_writer;
 
@@ -27,68 +29,306 @@ struct __huf_decoder {
 
     // Buffer for read operations.
     huf_bufio_read_writer_t *bufio_reader;
+
+    // Reader of the encoded bit stream.
+    huf_bit_reader_t bit_reader;
+
+    // Kernels used to decode the data.
+    const huf_kernels_t *kernels;
+
+    // Decoding table of the current block.
+    huf_decode_table_t table;
+
+    // Encoded streams of the interleaved block.
+    uint8_t *streams;
+    size_t streams_capacity;
+
+    // Decoded symbols, when they don't fit into the writer buffer.
+    uint8_t *symbols;
+    size_t symbols_capacity;
+
+    // Serialized Huffman tree of the current block.
+    int16_t tree_head[HUF_BTREE_LEN];
+
+    // Allocator of the decoder memory.
+    huf_allocator_t allocator;
+
+    // Allocator counting the allocations, when the statistics are collected.
+    huf_stats_allocator_t stats_allocator;
 };
 
 
+// Ensure that the buffer is capable to store the specified amount of
+// bytes, the content of the buffer is not preserved.
+static huf_error_t
+__huf_decoder_reserve(const huf_allocator_t *allocator,
+        uint8_t **buf, size_t *capacity, uint64_t len)
+{
+    routine_m();
+    routine_param_m(buf);
+    routine_param_m(capacity);
+
+    if (len <= *capacity) {
+        routine_success_m();
+    }
+
+    if (len > SIZE_MAX) {
+        routine_error_m(HUF_ERROR_MEMORY_ALLOCATION);
+    }
+
+    huf_free(allocator, *buf);
+    *buf = NULL;
+    *capacity = 0;
+
+    huf_error_t err = huf_alloc(allocator, void_pptr_m(buf), sizeof(uint8_t), len);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    *capacity = len;
+
+    routine_yield_m();
+}
+
+
+// Return the memory for the specified count of decoded symbols. Symbols
+// are decoded directly into the writer buffer when they fit into it,
+// otherwise the decoder buffer is used.
+static huf_error_t
+__huf_decoder_reserve_symbols(huf_decoder_t *self, uint64_t len, uint8_t **out)
+{
+    routine_m();
+
+    huf_error_t err;
+
+    routine_param_m(self);
+    routine_param_m(out);
+
+    size_t available = len;
+
+    err = huf_bufio_reserve(self->bufio_writer, out, &available);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (available >= len) {
+        routine_success_m();
+    }
+
+    err = __huf_decoder_reserve(&self->allocator,
+            &self->symbols, &self->symbols_capacity, len);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    *out = self->symbols;
+
+    routine_yield_m();
+}
+
+
+// Pass the decoded symbols to the writer.
+static huf_error_t
+__huf_decoder_commit_symbols(huf_decoder_t *self, const uint8_t *out, uint64_t len)
+{
+    routine_m();
+    routine_param_m(self);
+
+    huf_error_t err;
+
+    if (!len) {
+        routine_success_m();
+    }
+
+    // Symbols are already in the writer buffer.
+    if (out != self->symbols) {
+        err = huf_bufio_commit(self->bufio_writer, len);
+    } else {
+        err = huf_bufio_write(self->bufio_writer, out, len);
+    }
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
+
+
 // Decode the chunk of data.
 static huf_error_t
-__huf_decode_block(huf_decoder_t *self, size_t len)
+__huf_decode_block(huf_decoder_t *self, uint64_t len)
 {
     routine_m();
 
     huf_error_t err;
+    huf_bit_reader_t *reader = NULL;
 
-    uint8_t byte;
-    uint8_t bit_offset;
+    uint8_t *out;
+    uint64_t chunk;
 
-    size_t restored = 0;
+    uint64_t restored = 0;
 
     routine_param_m(self);
 
-    if (!self->last_node) {
-        self->last_node = self->huffman_tree->root;
+    const huf_node_t *root = self->huffman_tree->root;
+
+    if (!root && len) {
+        routine_error_m(HUF_ERROR_BTREE_CORRUPTED);
+    }
+
+    reader = &self->bit_reader;
+
+    err = huf_bit_reader_attach(reader, self->bufio_reader);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // Decode the block by chunks that fit into the writer buffer, or
+    // by 64 KiB chunks when the writer is unbuffered.
+    size_t chunk_size = self->bufio_writer->capacity;
+    if (!chunk_size) {
+        chunk_size = HUF_64KIB_BUFFER;
     }
+
     while (restored < len) {
-        // Read the next chunk of bit stream.
-        err = huf_bufio_read_uint8(self->bufio_reader, &byte);
+        chunk = len - restored;
+        if (chunk > chunk_size) {
+            chunk = chunk_size;
+        }
+
+        err = __huf_decoder_reserve_symbols(self, chunk, &out);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        for (bit_offset = 8; bit_offset > 0; bit_offset--) {
-            // If next bit equals to 1, then move to the right branch.
-            // Otherwise move to the left branch.
-            if ((byte >> (bit_offset - 1)) & 1) {
-                self->last_node = self->last_node->right;
-            } else {
-                self->last_node = self->last_node->left;
-            }
+        err = self->kernels->decode(reader, &self->table, root, out, chunk);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
 
-            // The decoding reached the bottom of the tree, but the decoding is
-            // not found. The tree is corrupted and cannot be used for decoding.
-            if (!self->last_node) {
-                routine_error_m(HUF_ERROR_BTREE_CORRUPTED);
-            }
+        err = __huf_decoder_commit_symbols(self, out, chunk);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
 
-            // Continue until the leaf (encoded byte) will be found.
-            if (self->last_node->left || self->last_node->right) {
-                continue;
-            }
+        restored += chunk;
+    }
 
-            err = huf_bufio_write_uint8(self->bufio_writer, self->last_node->index);
-            if (err != HUF_ERROR_SUCCESS) {
-                routine_error_m(err);
-            }
+    // Skip the bit fillers and return unused bytes to the reader.
+    err = huf_bit_reader_detach(reader);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
 
-            restored++;
+    routine_yield_m();
+}
 
-            // Reset last node value to tree root.
-            self->last_node = self->huffman_tree->root;
 
-            // Prevent unnecessary decoding of the bit fillers.
-            if (restored >= len) {
-                break;
-            }
+// Decode the chunk of data split into interleaved bit streams. Symbols
+// from all streams are decoded in the same loop, so decoding of the
+// streams does not depend on each other.
+static huf_error_t
+__huf_decode_streams(huf_decoder_t *self, uint64_t len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_bit_reader_t readers[HUF_INTERLEAVED_STREAMS];
+    uint8_t *outs[HUF_INTERLEAVED_STREAMS];
+
+    uint8_t *out = NULL;
+    const uint8_t *stream_ptr = NULL;
+    size_t available = 0;
+
+    uint64_t sizes[HUF_INTERLEAVED_STREAMS] = {0};
+    uint64_t counts[HUF_INTERLEAVED_STREAMS] = {0};
+    uint64_t begin, end, total = 0;
+    size_t stream;
+
+    routine_param_m(self);
+
+    const huf_node_t *root = self->huffman_tree->root;
+    if (!root && len) {
+        routine_error_m(HUF_ERROR_BTREE_CORRUPTED);
+    }
+
+    err = huf_bufio_read(self->bufio_reader, sizes, sizeof(sizes));
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    for (stream = 0; stream < HUF_INTERLEAVED_STREAMS; stream++) {
+        huf_stream_bounds(len, stream, &begin, &end);
+
+        // The code of each symbol is shorter than 256 bits, therefore
+        // the stream can't be longer than 32 bytes per symbol.
+        if (sizes[stream] / 32 > end - begin) {
+            routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+        }
+        total += sizes[stream];
+    }
+
+    // Each symbol takes at least one bit, so the untrusted length is
+    // rejected before the memory for the symbols is reserved.
+    if (len / 8 + (len % 8 != 0) > total) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    // Decode streams in place, when they fit into the reader buffer,
+    // otherwise copy them into the decoder buffer.
+    available = total;
+
+    err = huf_bufio_peek(self->bufio_reader, &stream_ptr, &available);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (available < total) {
+        err = __huf_decoder_reserve(&self->allocator,
+                &self->streams, &self->streams_capacity, total);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        err = huf_bufio_read(self->bufio_reader, self->streams, total);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        stream_ptr = self->streams;
+        available = 0;
+    }
+
+    err = __huf_decoder_reserve_symbols(self, len, &out);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    for (stream = 0; stream < HUF_INTERLEAVED_STREAMS; stream++) {
+        huf_stream_bounds(len, stream, &begin, &end);
+
+        huf_bit_reader_init(&readers[stream], stream_ptr, sizes[stream]);
+        outs[stream] = out + begin;
+
+        stream_ptr += sizes[stream];
+        counts[stream] = end - begin;
+    }
+
+    err = self->kernels->decode_streams(readers, &self->table, root, outs, counts);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = __huf_decoder_commit_symbols(self, out, len);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // Release the decoded streams of the reader buffer.
+    if (available) {
+        err = huf_bufio_consume(self->bufio_reader, total);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
         }
     }
 
@@ -108,14 +348,47 @@ huf_decoder_init(huf_decoder_t **self, const huf_config_t *config)
     routine_param_m(self);
     routine_param_m(config);
 
+    // Block could be either a single stream or split into the
+    // fixed count of interleaved streams.
+    if (config->streams > 1 && config->streams != HUF_INTERLEAVED_STREAMS) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
     // Allocate memory for a new decoder instance.
-    huf_error_t err = huf_malloc(void_pptr_m(&self_ptr), sizeof(huf_decoder_t), 1);
+    // Decoders without an allocator take the memory from the
+    // process-wide pool, so the buffers are reused between calls.
+    huf_allocator_t decoder_allocator = config->allocator;
+
+    huf_error_t err = huf_pool_default_allocator(&decoder_allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_calloc(&decoder_allocator, void_pptr_m(&self_ptr),
+            sizeof(huf_decoder_t), 1);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     *self = self_ptr;
 
+    // Keep the allocator, so the decoder could be released
+    // after the release of the configuration.
+    self_ptr->allocator = decoder_allocator;
+    const huf_allocator_t *allocator = &self_ptr->allocator;
+
+    // Count the allocations of the decoder, the decoder itself is
+    // allocated before the allocator is replaced.
+    if (config->stats) {
+        config->stats->allocations++;
+
+        err = huf_stats_allocator(&self_ptr->stats_allocator,
+                config->stats, &self_ptr->allocator);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+    }
+
     // Create a new instance of the decoder configuration.
     err = huf_config_init(&decoder_config);
     if (err != HUF_ERROR_SUCCESS) {
@@ -124,9 +397,10 @@ huf_decoder_init(huf_decoder_t **self, const huf_config_t *config)
 
     memcpy(decoder_config, config, sizeof(*config));
     self_ptr->config = decoder_config;
+    self_ptr->kernels = huf_kernels_default();
 
     // Allocate memory for Huffman tree.
-    err = huf_tree_init(&self_ptr->huffman_tree);
+    err = huf_tree_init_allocator(&self_ptr->huffman_tree, allocator);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
@@ -134,9 +408,10 @@ huf_decoder_init(huf_decoder_t **self, const huf_config_t *config)
     // Create buffered writer instance. If writer buffer
     // size set to zero, the 64 KiB buffer will be used
     // by default.
-    err = huf_bufio_read_writer_init(&self_ptr->bufio_writer,
+    err = huf_bufio_read_writer_init_allocator(&self_ptr->bufio_writer,
             self_ptr->config->writer,
-            self_ptr->config->writer_buffer_size);
+            self_ptr->config->writer_buffer_size,
+            allocator);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
@@ -144,9 +419,16 @@ huf_decoder_init(huf_decoder_t **self, const huf_config_t *config)
     // Create buffered reader instance. If reader buffer
     // size set to zero, the 64 KiB buffer will be used
     // by default.
-    err = huf_bufio_read_writer_init(&self_ptr->bufio_reader,
+    err = huf_bufio_read_writer_init_allocator(&self_ptr->bufio_reader,
             self_ptr->config->reader,
-            self_ptr->config->reader_buffer_size);
+            self_ptr->config->reader_buffer_size,
+            allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // Read the mapped input directly from its memory.
+    err = huf_bufio_read_writer_map(self_ptr->bufio_reader);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
@@ -168,6 +450,11 @@ huf_decoder_free(huf_decoder_t **self)
 
     self_ptr = *self;
 
+    // Nothing to release, the decoder was not initialized.
+    if (!self_ptr) {
+        routine_success_m();
+    }
+
     err = huf_tree_free(&self_ptr->huffman_tree);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
@@ -188,7 +475,11 @@ huf_decoder_free(huf_decoder_t **self)
         routine_error_m(err);
     }
 
-    free(self_ptr);
+    huf_allocator_t allocator = self_ptr->allocator;
+
+    huf_free(&allocator, self_ptr->streams);
+    huf_free(&allocator, self_ptr->symbols);
+    huf_free(&allocator, self_ptr);
 
     *self = NULL;
 
@@ -196,83 +487,423 @@ huf_decoder_free(huf_decoder_t **self)
 }
 
 
-// Decodes the data according to the provide
-// configuration.
-huf_error_t
-huf_decode(const huf_config_t *config)
+// Count the block in the statistics of the decoder.
+static huf_error_t
+__huf_decode_stats_block(huf_decoder_t *self, uint64_t len,
+        size_t tree_length, size_t streams)
 {
     routine_m();
 
-    huf_decoder_t *self = NULL;
-    huf_error_t err;
+    huf_stats_t *stats = NULL;
+    size_t depth = 0;
+
+    routine_param_m(self);
+
+    stats = self->config->stats;
+
+    huf_error_t err = huf_tree_depth(self->huffman_tree, &depth);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (depth > stats->max_depth) {
+        stats->max_depth = depth;
+    }
+
+    stats->blocks++;
+    stats->symbols += len;
+
+    // Length of the block, length of the tree and the tree itself.
+    stats->header_bytes += sizeof(uint64_t) + sizeof(int16_t) +
+        tree_length * sizeof(int16_t);
+
+    if (streams > 1) {
+        stats->header_bytes += HUF_INTERLEAVED_STREAMS * sizeof(uint64_t);
+    }
 
-    int16_t *tree_head = NULL;
+    routine_yield_m();
+}
+
+
+// Decode the block, which length is already read from the reader.
+static huf_error_t
+__huf_decode_chunk(huf_decoder_t *self, uint64_t len, size_t streams)
+{
+    routine_m();
+
+    huf_error_t err;
     int16_t tree_length = 0;
 
-    // Create a new decoder instance.
-    err = huf_decoder_init(&self, config);
+    huf_stats_t *stats = NULL;
+    uint64_t clock = 0;
+
+    routine_param_m(self);
+
+    stats = self->config->stats;
+    clock = huf_stats_clock(stats);
+
+    // The length of the block is already read.
+    uint64_t consumed = self->bufio_reader->have_been_processed - sizeof(uint64_t);
+
+    // Read the length of the serialized Huffman tree.
+    err = huf_bufio_read(self->bufio_reader, &tree_length, sizeof(tree_length));
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // The length of the serialized Huffman tree can't be greater than 1024 bytes.
+    if (tree_length < 0 || tree_length > HUF_BTREE_LEN) {
+        routine_error_m(HUF_ERROR_BTREE_OVERFLOW);
+    }
+
+    // Read serialized Huffman tree.
+    err = huf_bufio_read(self->bufio_reader, self->tree_head,
+            tree_length * sizeof(int16_t));
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // Create linked tree structure.
+    err = huf_tree_deserialize(self->huffman_tree, self->tree_head, tree_length);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_decode_table_init(&self->table, self->huffman_tree);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    huf_probe2_m(decode_block_start, len, tree_length);
+
+    if (stats) {
+        err = __huf_decode_stats_block(self, len, tree_length, streams);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        stats->tree_ns += huf_stats_clock(stats) - clock;
+        clock = huf_stats_clock(stats);
+    }
+
+    // Decode the next chunk of data.
+    if (streams > 1) {
+        err = __huf_decode_streams(self, len);
+    } else {
+        err = __huf_decode_block(self, len);
+    }
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (stats) {
+        stats->coding_ns += huf_stats_clock(stats) - clock;
+    }
+
+    huf_probe3_m(decode_block_end, len,
+            self->bufio_reader->have_been_processed - consumed, tree_length);
+
+    err = huf_tree_reset(self->huffman_tree);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
-    while (self->config->length > self->bufio_reader->have_been_processed) {
-        // Read the length of the next chunk (the original length of encoded bytes).
-        err = huf_bufio_read(self->bufio_reader, &self->config->blocksize,
-                sizeof(self->config->blocksize));
+    routine_yield_m();
+}
+
+
+// Read the length of the next block or the signature of the frame. When
+// the reader is exhausted before the first byte, the eof flag is set.
+static huf_error_t
+__huf_decoder_read_head(huf_decoder_t *self, uint8_t *head, int *eof)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_bufio_read_writer_t *reader = NULL;
+    huf_read_writer_t *read_writer = NULL;
+
+    const uint8_t *buf = NULL;
+    size_t available = HUF_FRAME_MAGIC_LEN;
+    size_t len = 0;
+
+    routine_param_m(self);
+    routine_param_m(head);
+    routine_param_m(eof);
+
+    reader = self->bufio_reader;
+    *eof = 0;
+
+    if (reader->capacity) {
+        err = huf_bufio_peek(reader, &buf, &available);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        if (!available) {
+            *eof = 1;
+            routine_success_m();
+        }
+
+        err = huf_bufio_read(reader, head, HUF_FRAME_MAGIC_LEN);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        routine_success_m();
+    }
+
+    // Unbuffered reader keeps no bytes, so it is read directly.
+    read_writer = reader->read_writer;
+
+    while (len < HUF_FRAME_MAGIC_LEN) {
+        available = HUF_FRAME_MAGIC_LEN - len;
+
+        err = read_writer->read(read_writer->stream, head + len, &available);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        //if (self->config->blocksize == 0) {
-        //    routine_error_m(HUF_ERROR_CORRUPTED);
-        //}
+        if (!available) {
+            break;
+        }
+
+        len += available;
+    }
+
+    reader->have_been_processed += len;
+
+    if (!len) {
+        *eof = 1;
+    } else if (len < HUF_FRAME_MAGIC_LEN) {
+        routine_error_m(HUF_ERROR_READ_WRITE);
+    }
+
+    routine_yield_m();
+}
+
+
+// Skip the specified amount of bytes of the reader.
+static huf_error_t
+__huf_decoder_skip(huf_decoder_t *self, uint64_t len)
+{
+    routine_m();
+
+    huf_error_t err;
+    uint8_t scratch[HUF_1KIB_BUFFER];
+
+    const uint8_t *buf = NULL;
+    size_t available = 0;
+
+    routine_param_m(self);
+
+    while (len > 0) {
+        available = len < SIZE_MAX ? len : SIZE_MAX;
 
-        // Read the length of the serialized Huffman tree.
-        err = huf_bufio_read(self->bufio_reader, &tree_length, sizeof(tree_length));
+        // Release the buffered bytes without copying.
+        err = huf_bufio_peek(self->bufio_reader, &buf, &available);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        // The length of the serialized Huffman tree can't be greater than 1024 bytes.
-        if (tree_length < 0 || tree_length > HUF_BTREE_LEN) {
-            routine_error_m(HUF_ERROR_BTREE_OVERFLOW);
+        if (available) {
+            if (available > len) {
+                available = len;
+            }
+
+            err = huf_bufio_consume(self->bufio_reader, available);
+        } else {
+            available = len < sizeof(scratch) ? len : sizeof(scratch);
+            err = huf_bufio_read(self->bufio_reader, scratch, available);
+        }
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
         }
 
-        // Allocate memory for serialized Huffman tree.
-        err = huf_malloc(void_pptr_m(&tree_head), sizeof(int16_t), tree_length);
+        len -= available;
+    }
+
+    routine_yield_m();
+}
+
+
+// Decode the frame, which signature is already read from the reader.
+static huf_error_t
+__huf_decode_frame(huf_decoder_t *self)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_frame_t frame;
+
+    uint8_t header[HUF_FRAME_HEADER_LEN];
+    size_t header_len = HUF_FRAME_MAGIC_LEN + 2;
+
+    uint64_t blocksize = 0;
+    uint64_t decoded = 0;
+
+    routine_param_m(self);
+
+    memcpy(header, HUF_FRAME_MAGIC, HUF_FRAME_MAGIC_LEN);
+
+    // Read the version and the flags of the frame.
+    err = huf_bufio_read(self->bufio_reader, header + HUF_FRAME_MAGIC_LEN, 2);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // The flags are followed by the size.
+    if (header[HUF_FRAME_MAGIC_LEN + 1] & (HUF_FRAME_CONTENT_SIZE | HUF_FRAME_SKIPPABLE)) {
+        err = huf_bufio_read(self->bufio_reader, header + header_len, sizeof(uint64_t));
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        // Read serialized Huffman tree.
-        err = huf_bufio_read(self->bufio_reader, tree_head,
-                tree_length * sizeof(int16_t));
+        header_len += sizeof(uint64_t);
+    }
+
+    err = huf_frame_read(&frame, header, &header_len);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (self->config->stats) {
+        self->config->stats->header_bytes += header_len;
+    }
+
+    if (frame.flags & HUF_FRAME_SKIPPABLE) {
+        err = __huf_decoder_skip(self, frame.size);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        // Create linked tree structure.
-        err = huf_tree_deserialize(self->huffman_tree, tree_head, tree_length);
+        routine_success_m();
+    }
+
+    // The layout of the blocks is defined by the frame.
+    size_t streams = 1;
+    if (frame.flags & HUF_FRAME_INTERLEAVED) {
+        streams = HUF_INTERLEAVED_STREAMS;
+    }
+
+    for (;;) {
+        err = huf_bufio_read(self->bufio_reader, &blocksize, sizeof(blocksize));
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        // Decode the next chunk of data.
-        err = __huf_decode_block(self, self->config->blocksize);
+        if (blocksize == HUF_FRAME_END) {
+            if (self->config->stats) {
+                self->config->stats->header_bytes += sizeof(blocksize);
+            }
+            break;
+        }
+
+        if ((frame.flags & HUF_FRAME_CONTENT_SIZE) && blocksize > frame.size - decoded) {
+            routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+        }
+
+        err = __huf_decode_chunk(self, blocksize, streams);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        err = huf_tree_reset(self->huffman_tree);
+        decoded += blocksize;
+    }
+
+    if ((frame.flags & HUF_FRAME_CONTENT_SIZE) && decoded != frame.size) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    routine_yield_m();
+}
+
+
+// Count the bytes passed through the decoder in the statistics.
+static void
+__huf_decode_stats_finish(huf_decoder_t *self, uint64_t clock)
+{
+    huf_stats_t *stats = NULL;
+
+    if (!self || !self->config) {
+        return;
+    }
+
+    stats = self->config->stats;
+
+    if (self->bufio_reader) {
+        stats->bytes_in = self->bufio_reader->have_been_processed;
+    }
+
+    if (self->bufio_writer) {
+        stats->bytes_out = self->bufio_writer->have_been_processed;
+    }
+
+    if (stats->bytes_in > stats->header_bytes) {
+        stats->payload_bytes = stats->bytes_in - stats->header_bytes;
+    }
+
+    // The codes are not known to the decoder, so the
+    // whole bit streams are counted.
+    stats->code_bits = stats->payload_bytes * 8;
+    stats->total_ns = huf_stats_clock(stats) - clock;
+}
+
+
+// Decodes the data according to the provide
+// configuration.
+huf_error_t
+huf_decode(const huf_config_t *config)
+{
+    routine_m();
+
+    huf_decoder_t *self = NULL;
+    huf_error_t err;
+
+    uint8_t head[HUF_FRAME_MAGIC_LEN];
+    int eof = 0;
+
+    huf_stats_t *stats = config ? config->stats : NULL;
+    uint64_t clock = huf_stats_clock(stats);
+
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+
+    // Create a new decoder instance.
+    err = huf_decoder_init(&self, config);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // Without the length, the data is decoded until the end of the reader.
+    while (!self->config->length ||
+            self->config->length > self->bufio_reader->have_been_processed) {
+        err = __huf_decoder_read_head(self, head, &eof);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        self->last_node = NULL;
+        if (eof && self->config->length) {
+            routine_error_m(HUF_ERROR_READ_WRITE);
+        }
+
+        if (eof) {
+            break;
+        }
 
-        // TODO: make an optimization to reduce allocations.
-        free(tree_head);
-        tree_head = NULL;
+        // Frames are distinguished from the blocks by the signature,
+        // which is never a valid length of the block.
+        if (!memcmp(head, HUF_FRAME_MAGIC, HUF_FRAME_MAGIC_LEN)) {
+            err = __huf_decode_frame(self);
+        } else {
+            // Read the length of the next chunk (the original length of encoded bytes).
+            memcpy(&self->config->blocksize, head, sizeof(self->config->blocksize));
+            err = __huf_decode_chunk(self, self->config->blocksize, self->config->streams);
+        }
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
     }
 
     err = huf_bufio_read_writer_flush(self->bufio_writer);
@@ -281,6 +912,11 @@ huf_decode(const huf_config_t *config)
     }
 
     routine_ensure_m();
+
+    if (stats) {
+        __huf_decode_stats_finish(self, clock);
+    }
+
     huf_decoder_free(&self);
 
     routine_defer_m();
@@ -3,14 +3,83 @@
 
 #include "huffman/bufio.h"
 #include "huffman/encoder.h"
+#include "huffman/frame.h"
 #include "huffman/malloc.h"
 #include "huffman/sys.h"
 #include "huffman/histogram.h"
 #include "huffman/io.h"
+#include "huffman/kernel.h"
+#include "huffman/pool.h"
+#include "huffman/probe.h"
+#include "huffman/queue.h"
+#include "huffman/stats.h"
 #include "huffman/symbol.h"
 #include "huffman/tree.h"
 
 
+// Minimum space in the writer buffer to pack codes into it.
+#define HUF_ENCODE_MIN_WINDOW 64
+
+
+// huf_encoder_block_t is a block of data passed between
+// the stages of the pipelined encoder.
+typedef struct __huf_encoder_block {
+    // Data of the block to encode.
+    const uint8_t *data;
+
+    // Length of the data to encode.
+    uint64_t length;
+
+    // Buffer with the read data, when the input is not mapped.
+    uint8_t *buffer;
+
+    // Encoded data of the block.
+    uint8_t *encoded;
+
+    // Length of the encoded data.
+    size_t encoded_length;
+
+    // Size of the encoded data buffer.
+    size_t encoded_capacity;
+} huf_encoder_block_t;
+
+
+// huf_encoder_pipeline_t passes blocks from the reader thread to
+// the encoder, and from the encoder to the writer thread.
+typedef struct __huf_encoder_pipeline {
+    // Blocks passed through the pipeline.
+    huf_encoder_block_t *blocks;
+
+    // Count of the blocks.
+    size_t length;
+
+    // Blocks ready to be read.
+    huf_queue_t *free_blocks;
+
+    // Blocks ready to be encoded.
+    huf_queue_t *read_blocks;
+
+    // Blocks ready to be written.
+    huf_queue_t *encoded_blocks;
+
+    // Block being encoded.
+    huf_encoder_block_t *block;
+
+    // Writer collecting the encoded data into the current block.
+    huf_read_writer_t block_writer;
+
+    // The first error of the pipeline stages, the following errors
+    // are caused by the cancellation of the pipeline.
+    huf_error_t error;
+
+    // Mutex guarding the error.
+    pthread_mutex_t mutex;
+
+    // Allocator of the blocks.
+    const huf_allocator_t *allocator;
+} huf_encoder_pipeline_t;
+
+
 struct __huf_encoder {
     // Read-only field with encoder configuration.
     huf_config_t *config;
@@ -33,9 +102,193 @@ struct __huf_encoder {
 
     // Buffered writer instance.
     huf_bufio_read_writer_t *bufio_reader;
+
+    // Kernels used to encode the data.
+    const huf_kernels_t *kernels;
+
+    // Packed codes of the symbols.
+    huf_code_t codes[HUF_ASCII_COUNT];
+
+    // Length of the longest code in bits.
+    size_t max_length;
+
+    // Encoded data, when it does not fit into the writer buffer.
+    uint8_t *scratch;
+
+    // Stages of the pipelined encoder.
+    huf_encoder_pipeline_t *pipeline;
+
+    // Allocator of the encoder memory.
+    huf_allocator_t allocator;
+
+    // Allocator counting the allocations, when the statistics are collected.
+    huf_stats_allocator_t stats_allocator;
 };
 
 
+// Append the encoded data to the block being encoded.
+static huf_error_t
+__huf_encoder_block_write(void *stream, const void *buf, size_t count)
+{
+    routine_m();
+
+    huf_encoder_pipeline_t *pipeline = stream;
+    huf_encoder_block_t *block = NULL;
+    uint8_t *encoded = NULL;
+
+    routine_param_m(pipeline);
+    routine_param_m(buf);
+
+    block = pipeline->block;
+    size_t length = block->encoded_length + count;
+
+    if (length > block->encoded_capacity) {
+        size_t capacity = block->encoded_capacity * 2;
+        if (capacity < length) {
+            capacity = length;
+        }
+
+        huf_error_t err = huf_alloc(pipeline->allocator,
+                void_pptr_m(&encoded), sizeof(uint8_t), capacity);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        if (block->encoded_length) {
+            memcpy(encoded, block->encoded, block->encoded_length);
+        }
+
+        huf_free(pipeline->allocator, block->encoded);
+        block->encoded = encoded;
+        block->encoded_capacity = capacity;
+    }
+
+    memcpy(block->encoded + block->encoded_length, buf, count);
+    block->encoded_length = length;
+
+    routine_yield_m();
+}
+
+
+// Save the error and close all queues of the pipeline, so the waiting
+// threads are woken up and stop processing the blocks.
+static void
+__huf_encoder_pipeline_cancel(huf_encoder_pipeline_t *pipeline, huf_error_t err)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    if (pipeline->error == HUF_ERROR_SUCCESS) {
+        pipeline->error = err;
+    }
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    huf_queue_close(pipeline->free_blocks);
+    huf_queue_close(pipeline->read_blocks);
+    huf_queue_close(pipeline->encoded_blocks);
+}
+
+
+// Release memory occupied by the encoder pipeline.
+static huf_error_t
+__huf_encoder_pipeline_free(huf_encoder_pipeline_t **self)
+{
+    routine_m();
+
+    huf_encoder_pipeline_t *self_ptr = NULL;
+
+    routine_param_m(self);
+
+    self_ptr = *self;
+    if (!self_ptr) {
+        routine_success_m();
+    }
+
+    huf_queue_free(&self_ptr->free_blocks);
+    huf_queue_free(&self_ptr->read_blocks);
+    huf_queue_free(&self_ptr->encoded_blocks);
+
+    const huf_allocator_t *allocator = self_ptr->allocator;
+
+    if (self_ptr->blocks) {
+        for (size_t index = 0; index < self_ptr->length; index++) {
+            huf_free(allocator, self_ptr->blocks[index].buffer);
+            huf_free(allocator, self_ptr->blocks[index].encoded);
+        }
+    }
+
+    pthread_mutex_destroy(&self_ptr->mutex);
+
+    huf_free(allocator, self_ptr->blocks);
+    huf_free(allocator, self_ptr);
+
+    *self = NULL;
+
+    routine_yield_m();
+}
+
+
+// Create a new instance of the encoder pipeline with the
+// specified count of blocks.
+static huf_error_t
+__huf_encoder_pipeline_init(huf_encoder_pipeline_t **self, size_t length,
+        const huf_allocator_t *allocator)
+{
+    routine_m();
+
+    huf_encoder_pipeline_t *self_ptr = NULL;
+
+    routine_param_m(self);
+
+    huf_error_t err = huf_calloc(allocator, void_pptr_m(&self_ptr),
+            sizeof(huf_encoder_pipeline_t), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (pthread_mutex_init(&self_ptr->mutex, NULL)) {
+        huf_free(allocator, self_ptr);
+        routine_error_m(HUF_ERROR_FATAL);
+    }
+
+    *self = self_ptr;
+    self_ptr->allocator = allocator;
+
+    err = huf_calloc(allocator, void_pptr_m(&self_ptr->blocks),
+            sizeof(huf_encoder_block_t), length);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    self_ptr->length = length;
+    self_ptr->block_writer.stream = self_ptr;
+    self_ptr->block_writer.write = __huf_encoder_block_write;
+
+    err = huf_queue_init(&self_ptr->free_blocks, length, allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_queue_init(&self_ptr->read_blocks, length, allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_queue_init(&self_ptr->encoded_blocks, length, allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // All blocks are ready to be read in the beginning.
+    for (size_t index = 0; index < length; index++) {
+        err = huf_queue_push(self_ptr->free_blocks, &self_ptr->blocks[index]);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+    }
+
+    routine_yield_m();
+}
+
+
 // Create a mapping of 8-bit bytes to the Huffman encoding.
 static huf_error_t
 __huf_create_char_coding(huf_encoder_t *self)
@@ -49,6 +302,8 @@ __huf_create_char_coding(huf_encoder_t *self)
 
     routine_param_m(self);
 
+    self->max_length = 0;
+
     for (size_t index = 0; index < self->mapping->length; index++) {
         const huf_node_t *node = self->huffman_tree->leaves[index];
 
@@ -64,8 +319,25 @@ __huf_create_char_coding(huf_encoder_t *self)
             routine_error_m(err);
         }
 
+        if (position > self->max_length) {
+            self->max_length = position;
+        }
+
+        // Pack the code, the coding string starts from the leaf.
+        if (position <= HUF_KERNEL_CODE_LEN) {
+            uint64_t bits = 0;
+
+            for (size_t bit = position; bit > 0; bit--) {
+                bits = (bits << 1) | (coding[bit - 1] & 1);
+            }
+
+            self->codes[index].bits = bits << (64 - position);
+            self->codes[index].length = position;
+        }
+
         // Create mapping element and inialize it with coding string.
-        err = huf_symbol_mapping_element_init(&element, coding, position);
+        err = huf_symbol_mapping_element_init_allocator(&element, coding, position,
+                &self->allocator);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
@@ -81,9 +353,9 @@ __huf_create_char_coding(huf_encoder_t *self)
 }
 
 
-// Encode chunk of data.
+// Encode chunk of data bit by bit.
 static huf_error_t
-__huf_encode_block(huf_encoder_t* self, const uint8_t *buf, uint64_t len)
+__huf_encode_bits(huf_encoder_t* self, const uint8_t *buf, uint64_t len)
 {
     routine_m();
 
@@ -131,6 +403,157 @@ __huf_encode_block(huf_encoder_t* self, const uint8_t *buf, uint64_t len)
 }
 
 
+// Encode chunk of data with the packing kernel. Codes are packed directly
+// into the writer buffer, when it is large enough.
+static huf_error_t
+__huf_encode_packed(huf_encoder_t *self, const uint8_t *buf, uint64_t len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_bit_writer_t bit_writer = {0};
+    huf_bufio_read_writer_t *writer = NULL;
+
+    uint8_t *out;
+    size_t available, chunk, written;
+
+    routine_param_m(self);
+    routine_param_m(buf);
+
+    writer = self->bufio_writer;
+
+    while (len > 0) {
+        available = HUF_ENCODE_MIN_WINDOW;
+
+        // Pack codes into the free space of the writer buffer.
+        err = huf_bufio_reserve(writer, &out, &available);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        if (available < HUF_ENCODE_MIN_WINDOW) {
+            if (!self->scratch) {
+                err = huf_alloc(&self->allocator, void_pptr_m(&self->scratch),
+                        sizeof(uint8_t), HUF_64KIB_BUFFER);
+                if (err != HUF_ERROR_SUCCESS) {
+                    routine_error_m(err);
+                }
+            }
+
+            out = self->scratch;
+            available = HUF_64KIB_BUFFER;
+        }
+
+        // The kernel writes 8 bytes past the encoded data, and keeps
+        // up to 7 bits of the previous chunk.
+        chunk = ((available - 8) * 8 - 7) / self->max_length;
+        if (chunk > len) {
+            chunk = len;
+        }
+
+        written = self->kernels->encode(&bit_writer, self->codes, buf, chunk, out);
+
+        if (out == self->scratch) {
+            err = huf_bufio_write(writer, out, written);
+        } else {
+            err = huf_bufio_commit(writer, written);
+        }
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        buf += chunk;
+        len -= chunk;
+    }
+
+    // Write the last incomplete byte.
+    if (bit_writer.count) {
+        err = huf_bufio_write_uint8(writer, bit_writer.bits >> 56);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+    }
+
+    routine_yield_m();
+}
+
+
+// Encode chunk of data, encoding starts from the new byte.
+static huf_error_t
+__huf_encode_block(huf_encoder_t* self, const uint8_t *buf, uint64_t len)
+{
+    routine_m();
+
+    huf_error_t err;
+
+    routine_param_m(self);
+
+    // Packing kernel supports only codes of the limited length, longer
+    // codes are extremely rare, so they are encoded bit by bit.
+    if (self->max_length <= HUF_KERNEL_CODE_LEN) {
+        err = __huf_encode_packed(self, buf, len);
+    } else {
+        huf_bit_read_writer_reset(&self->bit_writer);
+        err = __huf_encode_bits(self, buf, len);
+    }
+
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
+
+
+// Encode chunk of data as a set of independent bit streams, preceded
+// by the table of the streams lengths in bytes.
+static huf_error_t
+__huf_encode_streams(huf_encoder_t *self, const uint8_t *buf, uint64_t len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_symbol_mapping_element_t *element = NULL;
+
+    uint64_t sizes[HUF_INTERLEAVED_STREAMS] = {0};
+    uint64_t begin, end, pos;
+    size_t stream;
+
+    routine_param_m(self);
+    routine_param_m(buf);
+
+    // Calculate the length of each stream in advance, so the decoder
+    // could locate streams before the decoding.
+    for (stream = 0; stream < HUF_INTERLEAVED_STREAMS; stream++) {
+        huf_stream_bounds(len, stream, &begin, &end);
+
+        for (pos = begin; pos < end; pos++) {
+            element = self->mapping->symbols[buf[pos]];
+            sizes[stream] += element->length;
+        }
+
+        // Each stream is padded up to the byte boundary.
+        sizes[stream] = (sizes[stream] + 7) / 8;
+    }
+
+    err = huf_bufio_write(self->bufio_writer, sizes, sizeof(sizes));
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    for (stream = 0; stream < HUF_INTERLEAVED_STREAMS; stream++) {
+        huf_stream_bounds(len, stream, &begin, &end);
+
+        err = __huf_encode_block(self, buf + begin, end - begin);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+    }
+
+    routine_yield_m();
+}
+
+
 // Create a new instance of the Huffman encoder.
 huf_error_t
 huf_encoder_init(huf_encoder_t **self, const huf_config_t *config)
@@ -143,13 +566,46 @@ huf_encoder_init(huf_encoder_t **self, const huf_config_t *config)
     routine_param_m(self);
     routine_param_m(config);
 
-    huf_error_t err = huf_malloc(void_pptr_m(&self_ptr), sizeof(huf_encoder_t), 1);
+    // Block could be either a single stream or split into the
+    // fixed count of interleaved streams.
+    if (config->streams > 1 && config->streams != HUF_INTERLEAVED_STREAMS) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    // Encoders without an allocator take the memory from the
+    // process-wide pool, so the buffers are reused between calls.
+    huf_allocator_t encoder_allocator = config->allocator;
+
+    huf_error_t err = huf_pool_default_allocator(&encoder_allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_calloc(&encoder_allocator, void_pptr_m(&self_ptr),
+            sizeof(huf_encoder_t), 1);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     *self = self_ptr;
 
+    // Keep the allocator, so the encoder could be released
+    // after the release of the configuration.
+    self_ptr->allocator = encoder_allocator;
+    const huf_allocator_t *allocator = &self_ptr->allocator;
+
+    // Count the allocations of the encoder, the encoder itself is
+    // allocated before the allocator is replaced.
+    if (config->stats) {
+        config->stats->allocations++;
+
+        err = huf_stats_allocator(&self_ptr->stats_allocator,
+                config->stats, &self_ptr->allocator);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+    }
+
     // Save the encoder configuration.
     err = huf_config_init(&encoder_config);
     if (err != HUF_ERROR_SUCCESS) {
@@ -165,38 +621,61 @@ huf_encoder_init(huf_encoder_t **self, const huf_config_t *config)
     }
 
     self_ptr->config = encoder_config;
+    self_ptr->kernels = huf_kernels_default();
 
     // Allocate memory for Huffman tree.
-    err = huf_tree_init(&self_ptr->huffman_tree);
+    err = huf_tree_init_allocator(&self_ptr->huffman_tree, allocator);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
-    err = huf_symbol_mapping_init(&self_ptr->mapping, HUF_ASCII_COUNT);
+    err = huf_symbol_mapping_init_allocator(&self_ptr->mapping, HUF_ASCII_COUNT,
+            allocator);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     // Allocate memory for the frequency histogram.
-    err = huf_histogram_init(&self_ptr->histogram, 1, HUF_HISTOGRAM_LEN);
+    err = huf_histogram_init_allocator(&self_ptr->histogram, 1, HUF_HISTOGRAM_LEN,
+            allocator);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     // Create buffered writer instance. If writer buffer size
     // set to zero, the 64 KiB buffer will be used by default.
-    err = huf_bufio_read_writer_init(&self_ptr->bufio_writer,
-            self_ptr->config->writer,
-            self_ptr->config->writer_buffer_size);
+    // The pipelined encoder collects encoded data into blocks,
+    // which are written by the writer thread.
+    huf_read_writer_t *writer = self_ptr->config->writer;
+
+    if (self_ptr->config->pipeline_depth) {
+        err = __huf_encoder_pipeline_init(&self_ptr->pipeline,
+                self_ptr->config->pipeline_depth, allocator);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        writer = &self_ptr->pipeline->block_writer;
+    }
+
+    err = huf_bufio_read_writer_init_allocator(&self_ptr->bufio_writer,
+            writer, self_ptr->config->writer_buffer_size, allocator);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     // Create buffered reader instance. If reader buffer size
     // set to zero, the 64 KiB buffer will be used by default.
-    err = huf_bufio_read_writer_init(&self_ptr->bufio_reader,
+    err = huf_bufio_read_writer_init_allocator(&self_ptr->bufio_reader,
             self_ptr->config->reader,
-            self_ptr->config->reader_buffer_size);
+            self_ptr->config->reader_buffer_size,
+            allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // Read the mapped input directly from its memory.
+    err = huf_bufio_read_writer_map(self_ptr->bufio_reader);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
@@ -218,6 +697,11 @@ huf_encoder_free(huf_encoder_t **self)
 
     self_ptr = *self;
 
+    // Nothing to release, the encoder was not initialized.
+    if (!self_ptr) {
+        routine_success_m();
+    }
+
     err = huf_tree_free(&self_ptr->huffman_tree);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
@@ -248,7 +732,15 @@ huf_encoder_free(huf_encoder_t **self)
         routine_error_m(err);
     }
 
-    free(self_ptr);
+    err = __huf_encoder_pipeline_free(&self_ptr->pipeline);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    huf_allocator_t allocator = self_ptr->allocator;
+
+    huf_free(&allocator, self_ptr->scratch);
+    huf_free(&allocator, self_ptr);
 
     *self = NULL;
 
@@ -256,118 +748,599 @@ huf_encoder_free(huf_encoder_t **self)
 }
 
 
-// Encode the data according to the provided
-// configuration.
-huf_error_t
-huf_encode(const huf_config_t *config)
+// Count the block in the statistics of the encoder, the frequencies of
+// the symbols are taken before the construction of the tree.
+static void
+__huf_encode_stats_block(huf_encoder_t *self, const uint64_t *frequencies,
+        uint64_t len, size_t tree_length)
 {
-    routine_m();
+    huf_stats_t *stats = self->config->stats;
 
-    huf_error_t err;
-    huf_encoder_t *self = NULL;
+    stats->blocks++;
+    stats->symbols += len;
+
+    // Length of the block, length of the tree and the tree itself.
+    stats->header_bytes += sizeof(uint64_t) + sizeof(int16_t) +
+        tree_length * sizeof(int16_t);
+
+    if (self->config->streams > 1) {
+        stats->header_bytes += HUF_INTERLEAVED_STREAMS * sizeof(uint64_t);
+    }
+
+    for (size_t index = 0; index < HUF_ASCII_COUNT; index++) {
+        if (frequencies[index]) {
+            stats->code_bits += frequencies[index] * self->mapping->symbols[index]->length;
+        }
+    }
+
+    if (self->max_length > stats->max_depth) {
+        stats->max_depth = self->max_length;
+    }
+}
+
+
+// Encode the chunk of data into the writer buffer, the chunk is preceded
+// by its length and the serialized Huffman tree.
+static huf_error_t
+__huf_encode_chunk(huf_encoder_t *self, const uint8_t *buf, uint64_t len)
+{
+    routine_m();
+
+    huf_error_t err;
 
-    uint8_t *buf = NULL;
     int16_t tree_head[HUF_BTREE_LEN] = {0};
 
     int16_t actual_tree_length = 0;
     size_t tree_length = 0;
 
-    err = huf_encoder_init(&self, config);
+    huf_stats_t *stats = NULL;
+    uint64_t frequencies[HUF_ASCII_COUNT];
+    uint64_t clock = 0;
+
+    routine_param_m(self);
+    routine_param_m(buf);
+
+    stats = self->config->stats;
+    clock = huf_stats_clock(stats);
+
+    // Length of the encoded data is reported at the end of the block.
+    uint64_t written = self->bufio_writer->have_been_processed;
+    huf_probe1_m(encode_block_start, len);
+
+    err = huf_histogram_populate(self->histogram, buf, len);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
-    err = huf_malloc(void_pptr_m(&buf), sizeof(uint8_t), self->config->blocksize);
+    // The tree construction consumes the frequencies, so they
+    // are copied to count the length of the codes.
+    if (stats) {
+        memcpy(frequencies, self->histogram->frequencies, sizeof(frequencies));
+        stats->histogram_ns += huf_stats_clock(stats) - clock;
+        clock = huf_stats_clock(stats);
+    }
+
+    err = huf_tree_from_histogram(self->huffman_tree, self->histogram);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
-    size_t left_to_read = self->config->length;
-    size_t need_to_read;
+    err = __huf_create_char_coding(self);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
 
-    while (left_to_read > 0) {
-        need_to_read = self->config->blocksize;
+    // Write serialized tree into buffer.
+    err = huf_tree_serialize(self->huffman_tree, tree_head, &tree_length);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
 
-        if (left_to_read < need_to_read) {
-            need_to_read = left_to_read;
-        }
+    actual_tree_length = tree_length;
+    huf_probe3_m(tree_build, len, tree_length, self->max_length);
+
+    if (stats) {
+        __huf_encode_stats_block(self, frequencies, len, tree_length);
+        stats->tree_ns += huf_stats_clock(stats) - clock;
+    }
+
+    // Write the size of the next chunk.
+    err = huf_bufio_write(self->bufio_writer, &len, sizeof(len));
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // Write the length of the serialized Huffman tree.
+    err = huf_bufio_write(self->bufio_writer,
+            &actual_tree_length, sizeof(actual_tree_length));
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // Write the serialized tree itself.
+    err = huf_bufio_write(self->bufio_writer, tree_head,
+            tree_length * sizeof(int16_t));
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    clock = huf_stats_clock(stats);
+
+    if (self->config->streams > 1) {
+        err = __huf_encode_streams(self, buf, len);
+    } else {
+        err = __huf_encode_block(self, buf, len);
+    }
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (stats) {
+        stats->coding_ns += huf_stats_clock(stats) - clock;
+    }
+
+    huf_probe3_m(encode_block_end, len,
+            self->bufio_writer->have_been_processed - written, tree_length);
+
+    // Prepare the encoder for the next chunk.
+    err = huf_tree_reset(self->huffman_tree);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_histogram_reset(self->histogram);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_symbol_mapping_reset(self->mapping);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
 
-        // Read the next chunk of data, that we are going to encode.
-        err = huf_bufio_read(self->bufio_reader, buf, need_to_read);
+
+// Read the data of the block in the reader thread. The mapped data is
+// used in place, since the mapped memory outlives the block.
+static huf_error_t
+__huf_encode_read_block(huf_encoder_t *self, huf_encoder_block_t *block)
+{
+    routine_m();
+
+    huf_error_t err;
+    size_t available = block->length;
+
+    routine_param_m(self);
+
+    if (self->bufio_reader->mapped) {
+        err = huf_bufio_peek(self->bufio_reader, &block->data, &available);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        err = huf_histogram_populate(self->histogram, buf, need_to_read);
+        if (available < block->length) {
+            routine_error_m(HUF_ERROR_READ_WRITE);
+        }
+
+        err = huf_bufio_consume(self->bufio_reader, block->length);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        err = huf_tree_from_histogram(self->huffman_tree, self->histogram);
+        routine_success_m();
+    }
+
+    if (!block->buffer) {
+        err = huf_alloc(&self->allocator, void_pptr_m(&block->buffer), sizeof(uint8_t),
+                self->config->blocksize);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
+    }
+
+    err = huf_bufio_read(self->bufio_reader, block->buffer, block->length);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    block->data = block->buffer;
+
+    routine_yield_m();
+}
+
+
+// Read blocks of the data one after another in the reader thread.
+static void*
+__huf_encode_reader(void *arg)
+{
+    huf_encoder_t *self = arg;
+    huf_encoder_pipeline_t *pipeline = self->pipeline;
+    huf_encoder_block_t *block = NULL;
+
+    huf_error_t err = HUF_ERROR_SUCCESS;
+    uint64_t left_to_read = self->config->length;
+
+    while (left_to_read > 0) {
+        err = huf_queue_pop(pipeline->free_blocks, void_pptr_m(&block));
+        if (err != HUF_ERROR_SUCCESS || !block) {
+            break;
+        }
 
-        err = __huf_create_char_coding(self);
+        block->length = self->config->blocksize;
+        if (left_to_read < block->length) {
+            block->length = left_to_read;
+        }
+
+        err = __huf_encode_read_block(self, block);
         if (err != HUF_ERROR_SUCCESS) {
-            routine_error_m(err);
+            break;
         }
 
-        // Write serialized tree into buffer.
-        err = huf_tree_serialize(self->huffman_tree, tree_head, &tree_length);
+        err = huf_queue_push(pipeline->read_blocks, block);
         if (err != HUF_ERROR_SUCCESS) {
-            routine_error_m(err);
+            break;
         }
 
-        actual_tree_length = tree_length;
+        left_to_read -= block->length;
+    }
 
-        // Write the size of the next chunk.
-        err = huf_bufio_write(self->bufio_writer, &need_to_read, sizeof(need_to_read));
+    if (err != HUF_ERROR_SUCCESS) {
+        __huf_encoder_pipeline_cancel(pipeline, err);
+    } else {
+        huf_queue_close(pipeline->read_blocks);
+    }
+
+    return NULL;
+}
+
+
+// Write encoded blocks one after another in the writer thread.
+static void*
+__huf_encode_writer(void *arg)
+{
+    huf_encoder_t *self = arg;
+    huf_encoder_pipeline_t *pipeline = self->pipeline;
+    huf_read_writer_t *writer = self->config->writer;
+    huf_encoder_block_t *block = NULL;
+
+    huf_error_t err = HUF_ERROR_SUCCESS;
+
+    for (;;) {
+        err = huf_queue_pop(pipeline->encoded_blocks, void_pptr_m(&block));
+        if (err != HUF_ERROR_SUCCESS || !block) {
+            break;
+        }
+
+        if (block->encoded_length) {
+            err = writer->write(writer->stream, block->encoded, block->encoded_length);
+            if (err != HUF_ERROR_SUCCESS) {
+                break;
+            }
+        }
+
+        // Return the block to the reader.
+        err = huf_queue_push(pipeline->free_blocks, block);
         if (err != HUF_ERROR_SUCCESS) {
-            routine_error_m(err);
+            break;
         }
+    }
+
+    if (err != HUF_ERROR_SUCCESS) {
+        __huf_encoder_pipeline_cancel(pipeline, err);
+    }
+
+    return NULL;
+}
+
 
-        // Write the length of the serialized Huffman tree.
-        err = huf_bufio_write(self->bufio_writer,
-                &actual_tree_length, sizeof(actual_tree_length));
+// Encode blocks passed by the reader thread, and pass the
+// encoded blocks to the writer thread.
+static huf_error_t
+__huf_encode_coder(huf_encoder_t *self)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_encoder_pipeline_t *pipeline = NULL;
+    huf_encoder_block_t *block = NULL;
+
+    routine_param_m(self);
+
+    pipeline = self->pipeline;
+
+    for (;;) {
+        err = huf_queue_pop(pipeline->read_blocks, void_pptr_m(&block));
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        // Write the serialized tree itself.
-        err = huf_bufio_write(self->bufio_writer, tree_head,
-                tree_length * sizeof(int16_t));
+        // All blocks are read.
+        if (!block) {
+            break;
+        }
+
+        // Collect the encoded data of the block.
+        pipeline->block = block;
+        block->encoded_length = 0;
+
+        err = __huf_encode_chunk(self, block->data, block->length);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        // Reset the bit writer before encoging the next chunk of data.
-        huf_bit_read_writer_reset(&self->bit_writer);
+        err = huf_bufio_read_writer_flush(self->bufio_writer);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
 
-        // Write data
-        err = __huf_encode_block(self, buf, need_to_read);
+        err = huf_queue_push(pipeline->encoded_blocks, block);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
+    }
 
-        left_to_read -= need_to_read;
+    routine_yield_m();
+}
 
-        // If there is no more data to read, then skip reset of the histogram.
-        if (!left_to_read) {
-            continue;
+
+// Encode the data with three threads: the reader thread reads the next
+// blocks, while the calling thread encodes the current block, and the
+// writer thread writes the previous blocks.
+static huf_error_t
+__huf_encode_pipeline(huf_encoder_t *self)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_encoder_pipeline_t *pipeline = NULL;
+
+    pthread_t reader, writer;
+
+    routine_param_m(self);
+
+    pipeline = self->pipeline;
+
+    if (pthread_create(&reader, NULL, __huf_encode_reader, self)) {
+        routine_error_m(HUF_ERROR_FATAL);
+    }
+
+    if (pthread_create(&writer, NULL, __huf_encode_writer, self)) {
+        __huf_encoder_pipeline_cancel(pipeline, HUF_ERROR_FATAL);
+        pthread_join(reader, NULL);
+        routine_error_m(HUF_ERROR_FATAL);
+    }
+
+    err = __huf_encode_coder(self);
+
+    // Stop the other threads on failure, otherwise let the
+    // writer thread to write the rest of the blocks.
+    if (err != HUF_ERROR_SUCCESS) {
+        __huf_encoder_pipeline_cancel(pipeline, err);
+    } else {
+        huf_queue_close(pipeline->encoded_blocks);
+    }
+
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+
+    // Report the error, that caused the cancellation of the pipeline.
+    if (pipeline->error != HUF_ERROR_SUCCESS) {
+        routine_error_m(pipeline->error);
+    }
+
+    routine_yield_m();
+}
+
+
+// Write the header or the end marker of the frame. The pipelined
+// encoder writes them directly to the writer, when the threads of
+// the pipeline are not running.
+static huf_error_t
+__huf_encode_frame_write(huf_encoder_t *self, const void *buf, size_t len)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_read_writer_t *writer = NULL;
+
+    routine_param_m(self);
+
+    writer = self->config->writer;
+
+    if (self->pipeline) {
+        err = writer->write(writer->stream, buf, len);
+    } else {
+        err = huf_bufio_write(self->bufio_writer, buf, len);
+    }
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    // The bytes written around the buffered writer are not counted by it.
+    if (self->config->stats) {
+        self->config->stats->header_bytes += len;
+        self->config->stats->bytes_out += self->pipeline ? len : 0;
+    }
+
+    routine_yield_m();
+}
+
+
+// Write the header of the frame, that describes the encoded data.
+static huf_error_t
+__huf_encode_frame_header(huf_encoder_t *self)
+{
+    routine_m();
+
+    uint8_t header[HUF_FRAME_HEADER_LEN];
+    size_t header_len = sizeof(header);
+
+    routine_param_m(self);
+
+    huf_frame_t frame = {
+        .version = HUF_FRAME_VERSION,
+        .flags = HUF_FRAME_CONTENT_SIZE,
+        .size = self->config->length,
+    };
+
+    if (self->config->streams > 1) {
+        frame.flags |= HUF_FRAME_INTERLEAVED;
+    }
+
+    huf_error_t err = huf_frame_write(&frame, header, &header_len);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = __huf_encode_frame_write(self, header, header_len);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
+
+
+// Count the bytes passed through the encoder in the statistics.
+static void
+__huf_encode_stats_finish(huf_encoder_t *self, uint64_t clock)
+{
+    huf_stats_t *stats = NULL;
+
+    if (!self || !self->config) {
+        return;
+    }
+
+    stats = self->config->stats;
+
+    if (self->bufio_reader) {
+        stats->bytes_in = self->bufio_reader->have_been_processed;
+    }
+
+    if (self->bufio_writer) {
+        stats->bytes_out += self->bufio_writer->have_been_processed;
+    }
+
+    if (stats->bytes_out > stats->header_bytes) {
+        stats->payload_bytes = stats->bytes_out - stats->header_bytes;
+    }
+
+    stats->total_ns = huf_stats_clock(stats) - clock;
+}
+
+
+// Encode the data according to the provided
+// configuration.
+huf_error_t
+huf_encode(const huf_config_t *config)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_encoder_t *self = NULL;
+
+    uint8_t *buf = NULL;
+    const uint8_t *block = NULL;
+    size_t available = 0;
+
+    const uint64_t frame_end = HUF_FRAME_END;
+
+    huf_stats_t *stats = config ? config->stats : NULL;
+    uint64_t clock = huf_stats_clock(stats);
+
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+
+    err = huf_encoder_init(&self, config);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (self->config->frame) {
+        err = __huf_encode_frame_header(self);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
         }
+    }
 
-        err = huf_tree_reset(self->huffman_tree);
+    if (self->pipeline) {
+        err = __huf_encode_pipeline(self);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        err = huf_histogram_reset(self->histogram);
+        if (self->config->frame) {
+            err = __huf_encode_frame_write(self, &frame_end, sizeof(frame_end));
+            if (err != HUF_ERROR_SUCCESS) {
+                routine_error_m(err);
+            }
+        }
+
+        routine_success_m();
+    }
+
+    uint64_t left_to_read = self->config->length;
+    uint64_t need_to_read;
+
+    while (left_to_read > 0) {
+        need_to_read = self->config->blocksize;
+
+        if (left_to_read < need_to_read) {
+            need_to_read = left_to_read;
+        }
+
+        // Encode the next chunk of data in place, when it fits into the
+        // reader buffer, otherwise copy it into the encoder buffer.
+        available = 0;
+
+        if (need_to_read <= self->bufio_reader->capacity) {
+            available = need_to_read;
+
+            err = huf_bufio_peek(self->bufio_reader, &block, &available);
+            if (err != HUF_ERROR_SUCCESS) {
+                routine_error_m(err);
+            }
+        }
+
+        if (available < need_to_read) {
+            if (!buf) {
+                err = huf_alloc(&self->allocator, void_pptr_m(&buf), sizeof(uint8_t),
+                        self->config->blocksize);
+                if (err != HUF_ERROR_SUCCESS) {
+                    routine_error_m(err);
+                }
+            }
+
+            err = huf_bufio_read(self->bufio_reader, buf, need_to_read);
+            if (err != HUF_ERROR_SUCCESS) {
+                routine_error_m(err);
+            }
+
+            block = buf;
+            available = 0;
+        }
+
+        err = __huf_encode_chunk(self, block, need_to_read);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
 
-        err = huf_symbol_mapping_reset(self->mapping);
+        // Release the encoded data of the reader buffer.
+        if (available) {
+            err = huf_bufio_consume(self->bufio_reader, need_to_read);
+            if (err != HUF_ERROR_SUCCESS) {
+                routine_error_m(err);
+            }
+        }
+
+        left_to_read -= need_to_read;
+    }
+
+    if (self->config->frame) {
+        err = __huf_encode_frame_write(self, &frame_end, sizeof(frame_end));
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
@@ -381,8 +1354,15 @@ huf_encode(const huf_config_t *config)
 
     routine_ensure_m();
 
+    if (self) {
+        huf_free(&self->allocator, buf);
+    }
+
+    if (stats) {
+        __huf_encode_stats_finish(self, clock);
+    }
+
     huf_encoder_free(&self);
-    free(buf);
 
     routine_defer_m();
 }
@@ -11,6 +11,9 @@ __huf_error_map[] = {
     "Fatal error",
     "Block is corrupted, Huffman tree has impossible size",
     "Huffman tree is corrupted and cannot be used to decode the block",
+    "Block is corrupted, layout of the block streams is inconsistent",
+    "Destination buffer is too small to store the result",
+    "Frame version or flags are not supported",
     "Unknown error"
 };
 
@@ -0,0 +1,108 @@
+#include <string.h>
+
+#include "huffman/frame.h"
+#include "huffman/sys.h"
+
+
+// Mask of the flags supported by the decoder.
+#define HUF_FRAME_FLAGS (HUF_FRAME_CONTENT_SIZE | HUF_FRAME_INTERLEAVED | HUF_FRAME_SKIPPABLE)
+
+
+// Return the length of the frame header with the specified flags.
+static inline size_t
+__huf_frame_len(uint8_t flags)
+{
+    size_t len = HUF_FRAME_MAGIC_LEN + 2;
+
+    if (flags & (HUF_FRAME_CONTENT_SIZE | HUF_FRAME_SKIPPABLE)) {
+        len += sizeof(uint64_t);
+    }
+
+    return len;
+}
+
+
+// Write the frame header into the buffer.
+huf_error_t
+huf_frame_write(const huf_frame_t *self, void *buf, size_t *len)
+{
+    routine_m();
+
+    uint8_t *ptr = buf;
+
+    routine_param_m(self);
+    routine_param_m(buf);
+    routine_param_m(len);
+
+    // Skipped data has no content size.
+    if ((self->flags & ~HUF_FRAME_FLAGS) ||
+            ((self->flags & HUF_FRAME_SKIPPABLE) && (self->flags & ~HUF_FRAME_SKIPPABLE))) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    size_t frame_len = __huf_frame_len(self->flags);
+    if (*len < frame_len) {
+        routine_error_m(HUF_ERROR_BUFFER_OVERFLOW);
+    }
+
+    memcpy(ptr, HUF_FRAME_MAGIC, HUF_FRAME_MAGIC_LEN);
+    ptr += HUF_FRAME_MAGIC_LEN;
+
+    *ptr++ = self->version;
+    *ptr++ = self->flags;
+
+    if (frame_len > HUF_FRAME_MAGIC_LEN + 2) {
+        memcpy(ptr, &self->size, sizeof(self->size));
+    }
+
+    *len = frame_len;
+
+    routine_yield_m();
+}
+
+
+// Read the frame header from the buffer.
+huf_error_t
+huf_frame_read(huf_frame_t *self, const void *buf, size_t *len)
+{
+    routine_m();
+
+    const uint8_t *ptr = buf;
+
+    routine_param_m(self);
+    routine_param_m(buf);
+    routine_param_m(len);
+
+    if (*len < HUF_FRAME_MAGIC_LEN || memcmp(ptr, HUF_FRAME_MAGIC, HUF_FRAME_MAGIC_LEN)) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    if (*len < HUF_FRAME_MAGIC_LEN + 2) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    ptr += HUF_FRAME_MAGIC_LEN;
+
+    self->version = *ptr++;
+    self->flags = *ptr++;
+    self->size = 0;
+
+    // Frames of the newer versions could change the layout of the
+    // header, so they can't be skipped either.
+    if (self->version != HUF_FRAME_VERSION || (self->flags & ~HUF_FRAME_FLAGS)) {
+        routine_error_m(HUF_ERROR_FRAME_UNSUPPORTED);
+    }
+
+    size_t frame_len = __huf_frame_len(self->flags);
+    if (*len < frame_len) {
+        routine_error_m(HUF_ERROR_BLOCK_CORRUPTED);
+    }
+
+    if (frame_len > HUF_FRAME_MAGIC_LEN + 2) {
+        memcpy(&self->size, ptr, sizeof(self->size));
+    }
+
+    *len = frame_len;
+
+    routine_yield_m();
+}
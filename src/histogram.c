@@ -1,6 +1,7 @@
 #include <string.h>
 
 #include <huffman/histogram.h>
+#include <huffman/kernel.h>
 #include <huffman/malloc.h>
 #include <huffman/sys.h>
 
@@ -8,6 +9,16 @@
 // Initialize a new instance of the frequency histogram.
 huf_error_t
 huf_histogram_init(huf_histogram_t **self, size_t iota, size_t length)
+{
+    return huf_histogram_init_allocator(self, iota, length, NULL);
+}
+
+
+// Initialize a new instance of the frequency histogram with the
+// specified allocator.
+huf_error_t
+huf_histogram_init_allocator(huf_histogram_t **self, size_t iota,
+        size_t length, const huf_allocator_t *allocator)
 {
     routine_m();
 
@@ -15,14 +26,16 @@ huf_histogram_init(huf_histogram_t **self, size_t iota, size_t length)
     routine_param_m(iota);
     routine_param_m(length);
 
-    huf_error_t err = huf_malloc(void_pptr_m(self), sizeof(huf_histogram_t), 1);
+    huf_error_t err = huf_calloc(allocator, void_pptr_m(self), sizeof(huf_histogram_t), 1);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     huf_histogram_t *self_ptr = *self;
+    self_ptr->allocator = allocator;
 
-    err = huf_malloc(void_pptr_m(&self_ptr->frequencies), sizeof(uint64_t), length);
+    err = huf_calloc(allocator, void_pptr_m(&self_ptr->frequencies),
+            sizeof(uint64_t), length);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
@@ -44,8 +57,8 @@ huf_histogram_free(huf_histogram_t **self)
 
     huf_histogram_t *self_ptr = *self;
 
-    free(self_ptr->frequencies);
-    free(self_ptr);
+    huf_free(self_ptr->allocator, self_ptr->frequencies);
+    huf_free(self_ptr->allocator, self_ptr);
 
     *self = NULL;
 
@@ -71,16 +84,31 @@ huf_histogram_reset(huf_histogram_t *self)
 // chart by one if the element was found in the specified
 // buffer.
 huf_error_t
-huf_histogram_populate(huf_histogram_t *self, void *buf, size_t len)
+huf_histogram_populate(huf_histogram_t *self, const void *buf, size_t len)
 {
     routine_m();
 
-    uint8_t *buf_ptr = buf;
-    uint8_t *buf_end = buf_ptr + len;
+    const uint8_t *buf_ptr = buf;
+    const uint8_t *buf_end = buf_ptr + len;
 
     routine_param_m(self);
     routine_param_m(buf);
 
+    // Histogram of bytes is calculated by the specialized kernel.
+    if (self->iota == 1 && self->length >= HUF_ASCII_COUNT) {
+        huf_kernels_default()->histogram(self->frequencies, buf, len);
+
+        size_t start = self->start < HUF_ASCII_COUNT ? self->start : HUF_ASCII_COUNT;
+        for (size_t element = 0; element < start; element++) {
+            if (self->frequencies[element]) {
+                self->start = element;
+                break;
+            }
+        }
+
+        routine_success_m();
+    }
+
     // Calculate frequencies of the symbols.
     while (buf_ptr + self->iota <= buf_end) {
         // Reset the destination variable.
@@ -1,4 +1,10 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stddef.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "huffman/io.h"
@@ -6,23 +12,65 @@
 #include "huffman/malloc.h"
 
 
+// Segments are passed to writev and accepted from the callers of the
+// scatter/gather functions in place of struct iovec, so the build fails
+// on the platforms, where the layouts differ.
+_Static_assert(sizeof(huf_segment_t) == sizeof(struct iovec),
+        "huf_segment_t must have the size of struct iovec");
+_Static_assert(offsetof(huf_segment_t, base) == offsetof(struct iovec, iov_base),
+        "huf_segment_t base must match struct iovec iov_base");
+_Static_assert(offsetof(huf_segment_t, len) == offsetof(struct iovec, iov_len),
+        "huf_segment_t len must match struct iovec iov_len");
+
+
 huf_error_t fdwrite(void *stream, const void *buf, size_t count)
 {
-    size_t have_written = write(*(int*)stream, buf, count);
-    if (have_written != count) {
+    ssize_t have_written = write(*(int*)stream, buf, count);
+    if (have_written < 0 || (size_t)have_written != count) {
+        return HUF_ERROR_READ_WRITE;
+    }
+    return HUF_ERROR_SUCCESS;
+}
+
+
+huf_error_t fdwritev(void *stream, const huf_segment_t *segments, size_t count)
+{
+    // Segments have the layout of the struct iovec, as asserted above.
+    ssize_t have_written = writev(*(int*)stream, (const struct iovec*)segments, count);
+    if (have_written < 0) {
         return HUF_ERROR_READ_WRITE;
     }
+
+    size_t written = have_written;
+
+    // Write the rest of the partially written segments.
+    for (size_t index = 0; index < count; index++) {
+        if (written >= segments[index].len) {
+            written -= segments[index].len;
+            continue;
+        }
+
+        huf_error_t err = fdwrite(stream, (uint8_t*)segments[index].base + written,
+                segments[index].len - written);
+        if (err != HUF_ERROR_SUCCESS) {
+            return err;
+        }
+
+        written = 0;
+    }
+
     return HUF_ERROR_SUCCESS;
 }
 
 
 huf_error_t fdread(void *stream, void *buf, size_t *count)
 {
-    size_t have_read = read(*(int*)stream, buf, *count);
-    *count = have_read;
+    ssize_t have_read = read(*(int*)stream, buf, *count);
     if (have_read < 0) {
+        *count = 0;
         return HUF_ERROR_READ_WRITE;
     }
+    *count = have_read;
     return HUF_ERROR_SUCCESS;
 }
 
@@ -33,18 +81,30 @@ huf_error_t huf_fdopen(huf_read_writer_t **self, int fd)
 
     huf_error_t err;
     huf_read_writer_t *self_ptr;
+    int *stream = NULL;
 
     routine_param_m(self);
 
+    // Keep a copy of the descriptor, since the stream
+    // outlives the argument.
+    err = huf_malloc(void_pptr_m(&stream), sizeof(int), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    *stream = fd;
+
     err = huf_malloc(void_pptr_m(self), sizeof(huf_read_writer_t), 1);
     if (err != HUF_ERROR_SUCCESS) {
+        free(stream);
         routine_error_m(err);
     }
 
     self_ptr = *self;
-    self_ptr->stream = (void*)(&fd);
+    self_ptr->stream = (void*)stream;
     self_ptr->read = fdread;
     self_ptr->write = fdwrite;
+    self_ptr->writev = fdwritev;
 
     routine_yield_m();
 }
@@ -56,6 +116,7 @@ huf_error_t huf_fdclose(huf_read_writer_t **self)
     routine_param_m(self);
 
     huf_read_writer_t *self_ptr = *self;
+    free(self_ptr->stream);
     free(self_ptr);
     *self = NULL;
 
@@ -63,6 +124,244 @@ huf_error_t huf_fdclose(huf_read_writer_t **self)
 }
 
 
+typedef struct __huf_mmap {
+    // Descriptor of the mapped file.
+    int fd;
+
+    // Mode of the mapping.
+    huf_io_mode_t mode;
+
+    // Mapped memory of the file.
+    uint8_t *buf;
+
+    // Length of the mapped memory.
+    size_t len;
+
+    // Current read or write position.
+    size_t off;
+} huf_mmap_t;
+
+
+// Map the file of the specified length, the file is resized
+// to the length of the mapping.
+static huf_error_t
+__huf_mmap_resize(huf_mmap_t *mm, size_t len)
+{
+    if (ftruncate(mm->fd, len) < 0) {
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    if (mm->buf) {
+        munmap(mm->buf, mm->len);
+    }
+
+    mm->buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, mm->fd, 0);
+    if (mm->buf == MAP_FAILED) {
+        mm->buf = NULL;
+        mm->len = 0;
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    mm->len = len;
+    return HUF_ERROR_SUCCESS;
+}
+
+
+huf_error_t mmapwrite(void *stream, const void *buf, size_t count)
+{
+    huf_mmap_t *mm = (huf_mmap_t*)stream;
+
+    if (mm->mode != HUF_IO_WRITE) {
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    // Grow the mapping twice to amortize remapping of the file.
+    if (mm->len < mm->off || count > mm->len - mm->off) {
+        size_t len = mm->len * 2;
+
+        if (len < mm->off + count) {
+            len = mm->off + count;
+        }
+        if (len < HUF_1MIB_BUFFER) {
+            len = HUF_1MIB_BUFFER;
+        }
+
+        huf_error_t err = __huf_mmap_resize(mm, len);
+        if (err != HUF_ERROR_SUCCESS) {
+            return err;
+        }
+    }
+
+    if (count > 0) {
+        memcpy(mm->buf + mm->off, buf, count);
+        mm->off += count;
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+huf_error_t mmapread(void *stream, void *buf, size_t *count)
+{
+    huf_mmap_t *mm = (huf_mmap_t*)stream;
+    size_t num_copy = *count;
+    size_t num_remained = mm->len > mm->off ? mm->len - mm->off : 0;
+
+    if (num_copy > num_remained) {
+        num_copy = num_remained;
+    }
+
+    *count = num_copy;
+
+    if (num_copy > 0) {
+        memcpy(buf, mm->buf + mm->off, num_copy);
+        mm->off += num_copy;
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+huf_error_t mmapmap(void *stream, const void **buf, size_t *count)
+{
+    huf_mmap_t *mm = (huf_mmap_t*)stream;
+
+    *buf = NULL;
+    *count = 0;
+
+    if (mm->len > mm->off) {
+        *buf = mm->buf + mm->off;
+        *count = mm->len - mm->off;
+        mm->off = mm->len;
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+huf_error_t huf_mmapopen(huf_read_writer_t **self, int fd, huf_io_mode_t mode)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_mmap_t *mm = NULL;
+    huf_read_writer_t *self_ptr;
+
+    struct stat st;
+    off_t off;
+
+    routine_param_m(self);
+
+    if (mode != HUF_IO_READ && mode != HUF_IO_WRITE) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    // Only regular files could be mapped into the memory.
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        routine_error_m(HUF_ERROR_READ_WRITE);
+    }
+
+    off = lseek(fd, 0, SEEK_CUR);
+    if (off < 0 || (uintmax_t)st.st_size > SIZE_MAX) {
+        routine_error_m(HUF_ERROR_READ_WRITE);
+    }
+
+    err = huf_malloc(void_pptr_m(&mm), sizeof(huf_mmap_t), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    mm->fd = fd;
+    mm->mode = mode;
+    mm->len = st.st_size;
+    mm->off = off;
+
+    if (mm->len) {
+        int prot = PROT_READ;
+        int flags = MAP_PRIVATE;
+
+        if (mode == HUF_IO_WRITE) {
+            prot |= PROT_WRITE;
+            flags = MAP_SHARED;
+        }
+
+        mm->buf = mmap(NULL, mm->len, prot, flags, fd, 0);
+        if (mm->buf == MAP_FAILED) {
+            mm->buf = NULL;
+            routine_error_m(HUF_ERROR_READ_WRITE);
+        }
+
+        // The encoder and decoder read the file from the beginning to the
+        // end, so let the kernel read ahead more aggressively.
+        if (mode == HUF_IO_READ) {
+            posix_madvise(mm->buf, mm->len, POSIX_MADV_SEQUENTIAL);
+        }
+    }
+
+    err = huf_malloc(void_pptr_m(self), sizeof(huf_read_writer_t), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    self_ptr = *self;
+    self_ptr->stream = mm;
+    self_ptr->write = mmapwrite;
+    self_ptr->read = mmapread;
+
+    // The memory of the file mapped for writing could be
+    // remapped on writes, so it is not exposed.
+    if (mode == HUF_IO_READ) {
+        self_ptr->map = mmapmap;
+    }
+
+    routine_ensure_m();
+
+    if (routine_violation_m() && mm) {
+        if (mm->buf) {
+            munmap(mm->buf, mm->len);
+        }
+        free(mm);
+    }
+
+    routine_defer_m();
+}
+
+
+huf_error_t huf_mmapclose(huf_read_writer_t **self)
+{
+    routine_m();
+    routine_param_m(self);
+
+    huf_error_t err = HUF_ERROR_SUCCESS;
+    huf_read_writer_t *self_ptr = *self;
+    huf_mmap_t *mm = (huf_mmap_t*)self_ptr->stream;
+
+    if (mm->buf) {
+        munmap(mm->buf, mm->len);
+    }
+
+    // Cut the space reserved for the following writes.
+    if (mm->mode == HUF_IO_WRITE && ftruncate(mm->fd, mm->off) < 0) {
+        err = HUF_ERROR_READ_WRITE;
+    }
+
+    // Leave the file position right after the read or written data.
+    if (lseek(mm->fd, mm->off, SEEK_SET) < 0) {
+        err = HUF_ERROR_READ_WRITE;
+    }
+
+    free(mm);
+    free(self_ptr);
+    *self = NULL;
+
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
+
+
 typedef struct __huf_memstream {
     void **buf;
     size_t off;
@@ -82,6 +381,12 @@ huf_error_t memwrite(void *stream, const void *buf, size_t count)
         newcap = count * 2;
     }
 
+    // The buffer is full enough, so doubled capacity does
+    // not fit the new portion of data.
+    if (mem->len + count > newcap) {
+        newcap = mem->len + count;
+    }
+
     if (mem->cap >= mem->len + count) {
         memcpy(*(mem->buf) + mem->len, buf, count);
         mem->len += count;
@@ -224,3 +529,283 @@ huf_error_t huf_memclose(huf_read_writer_t **self)
 
     routine_yield_m();
 }
+
+
+typedef struct __huf_segstream {
+    // Segments of the stream, all of them are of the same size. The
+    // allocated segments are kept after the truncation of the stream.
+    huf_segment_t *segments;
+
+    // Count of segments holding the data.
+    size_t count;
+
+    // Count of allocated segments.
+    size_t allocated;
+
+    // Capacity of the segments array.
+    size_t slots;
+
+    // Size of each segment in bytes.
+    size_t size;
+
+    // Length of the stream data.
+    size_t len;
+
+    // Read position of the stream.
+    size_t off;
+
+    // Allocator of the segments.
+    const huf_allocator_t *allocator;
+} huf_segstream_t;
+
+
+// Allocate the next segment of the stream.
+static huf_error_t
+__huf_segalloc(huf_segstream_t *seg)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_segment_t *segments = NULL;
+
+    // Only the array of segments is copied, the segments
+    // themselves stay at the same place.
+    if (seg->allocated == seg->slots) {
+        size_t slots = seg->slots ? seg->slots * 2 : 8;
+
+        err = huf_alloc(seg->allocator, void_pptr_m(&segments),
+                sizeof(huf_segment_t), slots);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        if (seg->allocated) {
+            memcpy(segments, seg->segments, sizeof(huf_segment_t) * seg->allocated);
+        }
+
+        huf_free(seg->allocator, seg->segments);
+        seg->segments = segments;
+        seg->slots = slots;
+    }
+
+    huf_segment_t *segment = &seg->segments[seg->allocated];
+
+    // Segments are always written before they are read.
+    err = huf_alloc(seg->allocator, void_pptr_m(&segment->base),
+            sizeof(uint8_t), seg->size);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    segment->len = 0;
+    seg->allocated++;
+
+    routine_yield_m();
+}
+
+
+huf_error_t segwrite(void *stream, const void *buf, size_t count)
+{
+    huf_segstream_t *seg = (huf_segstream_t*)stream;
+    const uint8_t *bytes = buf;
+
+    while (count > 0) {
+        size_t index = seg->len / seg->size;
+        size_t pos = seg->len % seg->size;
+
+        if (index == seg->allocated) {
+            huf_error_t err = __huf_segalloc(seg);
+            if (err != HUF_ERROR_SUCCESS) {
+                return err;
+            }
+        }
+
+        size_t num_copy = seg->size - pos;
+        if (num_copy > count) {
+            num_copy = count;
+        }
+
+        huf_segment_t *segment = &seg->segments[index];
+        memcpy((uint8_t*)segment->base + pos, bytes, num_copy);
+
+        segment->len += num_copy;
+        seg->len += num_copy;
+        seg->count = index + 1;
+
+        bytes += num_copy;
+        count -= num_copy;
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+huf_error_t segread(void *stream, void *buf, size_t *count)
+{
+    huf_segstream_t *seg = (huf_segstream_t*)stream;
+    uint8_t *bytes = buf;
+
+    size_t num_remained = seg->len - seg->off;
+    size_t left_to_copy = *count;
+
+    if (left_to_copy > num_remained) {
+        left_to_copy = num_remained;
+    }
+
+    *count = left_to_copy;
+
+    while (left_to_copy > 0) {
+        const huf_segment_t *segment = &seg->segments[seg->off / seg->size];
+        size_t pos = seg->off % seg->size;
+
+        size_t num_copy = segment->len - pos;
+        if (num_copy > left_to_copy) {
+            num_copy = left_to_copy;
+        }
+
+        memcpy(bytes, (const uint8_t*)segment->base + pos, num_copy);
+
+        seg->off += num_copy;
+        bytes += num_copy;
+        left_to_copy -= num_copy;
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+huf_error_t huf_segopen(huf_read_writer_t **self, size_t segment_size,
+        const huf_allocator_t *allocator)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_segstream_t *seg = NULL;
+    huf_read_writer_t *self_ptr = NULL;
+
+    routine_param_m(self);
+
+    err = huf_calloc(allocator, void_pptr_m(&self_ptr), sizeof(huf_read_writer_t), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_calloc(allocator, void_pptr_m(&seg), sizeof(huf_segstream_t), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        huf_free(allocator, self_ptr);
+        routine_error_m(err);
+    }
+
+    seg->allocator = allocator;
+
+    // Use 64 KiB segments by default.
+    seg->size = segment_size ? segment_size : HUF_64KIB_BUFFER;
+
+    self_ptr->stream = seg;
+    self_ptr->write = segwrite;
+    self_ptr->read = segread;
+
+    *self = self_ptr;
+
+    routine_yield_m();
+}
+
+
+huf_error_t huf_seglen(const huf_read_writer_t *self, size_t *len)
+{
+    routine_m();
+
+    routine_param_m(self);
+    routine_param_m(len);
+
+    huf_segstream_t *seg = (huf_segstream_t*)self->stream;
+    *len = seg->len;
+
+    routine_yield_m();
+}
+
+
+huf_error_t huf_segments(const huf_read_writer_t *self,
+        const huf_segment_t **segments, size_t *count)
+{
+    routine_m();
+
+    routine_param_m(self);
+    routine_param_m(segments);
+    routine_param_m(count);
+
+    huf_segstream_t *seg = (huf_segstream_t*)self->stream;
+    *segments = seg->segments;
+    *count = seg->count;
+
+    routine_yield_m();
+}
+
+
+huf_error_t huf_segrewind(huf_read_writer_t *self)
+{
+    routine_m();
+    routine_param_m(self);
+
+    huf_segstream_t *seg = (huf_segstream_t*)self->stream;
+    seg->off = 0;
+
+    routine_yield_m();
+}
+
+
+huf_error_t huf_segtruncate(huf_read_writer_t *self, size_t len)
+{
+    routine_m();
+    routine_param_m(self);
+
+    huf_segstream_t *seg = (huf_segstream_t*)self->stream;
+
+    if (len > seg->len) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    seg->len = len;
+    seg->count = (len + seg->size - 1) / seg->size;
+
+    if (seg->off > len) {
+        seg->off = len;
+    }
+
+    // Keep the segments allocated for the following writes.
+    for (size_t index = 0; index < seg->allocated; index++) {
+        size_t start = index * seg->size;
+        size_t segment_len = 0;
+
+        if (len > start) {
+            segment_len = len - start < seg->size ? len - start : seg->size;
+        }
+
+        seg->segments[index].len = segment_len;
+    }
+
+    routine_yield_m();
+}
+
+
+huf_error_t huf_segclose(huf_read_writer_t **self)
+{
+    routine_m();
+    routine_param_m(self);
+
+    huf_read_writer_t *self_ptr = *self;
+    huf_segstream_t *seg = (huf_segstream_t*)self_ptr->stream;
+
+    const huf_allocator_t *allocator = seg->allocator;
+
+    for (size_t index = 0; index < seg->allocated; index++) {
+        huf_free(allocator, seg->segments[index].base);
+    }
+
+    huf_free(allocator, seg->segments);
+    huf_free(allocator, seg);
+    huf_free(allocator, self_ptr);
+    *self = NULL;
+
+    routine_yield_m();
+}
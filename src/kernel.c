@@ -0,0 +1,503 @@
+#include <string.h>
+
+#include "huffman/kernel.h"
+#include "huffman/sys.h"
+
+
+// Kernels for x86 processors are built with the target attributes, so
+// the same library could be used on processors of any generation.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HUF_KERNELS_X86
+#endif
+
+#if defined(__GNUC__)
+#define __huf_kernel_inline_m static inline __attribute__((always_inline))
+#else
+#define __huf_kernel_inline_m static inline
+#endif
+
+
+// Recursively fill the decoding table with leaves reachable from
+// the specified node within the HUF_DECODE_TABLE_BITS bits.
+static void
+__huf_decode_table_fill(huf_decode_table_t *self, const huf_node_t *node,
+        size_t prefix, size_t depth)
+{
+    // Corrupted branches are left unresolved, the decoder
+    // reports an error when reaches them.
+    if (!node) {
+        return;
+    }
+
+    if (depth && !node->left && !node->right) {
+        size_t shift = HUF_DECODE_TABLE_BITS - depth;
+        uint16_t element = (uint16_t)(depth << 8) | (uint8_t)node->index;
+
+        for (size_t index = prefix << shift; index < (prefix + 1) << shift; index++) {
+            self->elements[index] = element;
+        }
+        return;
+    }
+
+    if (depth == HUF_DECODE_TABLE_BITS) {
+        return;
+    }
+
+    __huf_decode_table_fill(self, node->left, prefix << 1, depth + 1);
+    __huf_decode_table_fill(self, node->right, (prefix << 1) | 1, depth + 1);
+}
+
+
+// Build the decoding table from the Huffman tree.
+huf_error_t
+huf_decode_table_init(huf_decode_table_t *self, const huf_tree_t *tree)
+{
+    routine_m();
+    routine_param_m(self);
+    routine_param_m(tree);
+
+    memset(self->elements, 0, sizeof(self->elements));
+    __huf_decode_table_fill(self, tree->root, 0, 0);
+
+    routine_yield_m();
+}
+
+
+// Store the 64-bit word, so the most significant byte of
+// the word is the first byte in the memory.
+__huf_kernel_inline_m void
+__huf_store_uint64(uint8_t *ptr, uint64_t word)
+{
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) \
+    && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+    memcpy(ptr, &word, sizeof(word));
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    memcpy(ptr, &word, sizeof(word));
+#else
+    for (size_t index = 0; index < sizeof(word); index++) {
+        ptr[index] = word >> (56 - index * 8);
+    }
+#endif
+}
+
+
+__huf_kernel_inline_m void
+__huf_histogram(uint64_t *frequencies, const uint8_t *buf, size_t len)
+{
+    size_t pos = 0;
+
+    // Setup of the separate tables is not worth it for short buffers.
+    if (len < HUF_1KIB_BUFFER) {
+        for (; pos < len; pos++) {
+            frequencies[buf[pos]]++;
+        }
+        return;
+    }
+
+    // Count bytes into separate tables, so the increment of the counter
+    // does not wait for the previous increment of the same counter.
+    uint64_t tables[4][HUF_ASCII_COUNT] = {{0}};
+
+    for (; pos + 4 <= len; pos += 4) {
+        tables[0][buf[pos]]++;
+        tables[1][buf[pos + 1]]++;
+        tables[2][buf[pos + 2]]++;
+        tables[3][buf[pos + 3]]++;
+    }
+
+    for (; pos < len; pos++) {
+        tables[0][buf[pos]]++;
+    }
+
+    for (size_t index = 0; index < HUF_ASCII_COUNT; index++) {
+        frequencies[index] += tables[0][index] + tables[1][index]
+            + tables[2][index] + tables[3][index];
+    }
+}
+
+
+__huf_kernel_inline_m size_t
+__huf_encode(huf_bit_writer_t *writer, const huf_code_t *codes,
+        const uint8_t *buf, size_t len, uint8_t *out)
+{
+    uint64_t bits = writer->bits;
+    size_t count = writer->count;
+    uint8_t *out_ptr = out;
+
+    for (size_t pos = 0; pos < len; pos++) {
+        const huf_code_t *code = &codes[buf[pos]];
+
+        // Dump whole bytes of the register, when the code does not fit.
+        if (count + code->length > 63) {
+            __huf_store_uint64(out_ptr, bits);
+            out_ptr += count >> 3;
+            bits <<= count & ~7;
+            count &= 7;
+        }
+
+        bits |= code->bits >> count;
+        count += code->length;
+    }
+
+    __huf_store_uint64(out_ptr, bits);
+    out_ptr += count >> 3;
+    bits <<= count & ~7;
+    count &= 7;
+
+    writer->bits = bits;
+    writer->count = count;
+
+    return out_ptr - out;
+}
+
+
+// Decode the symbol by walking the Huffman tree bit by bit.
+__huf_kernel_inline_m huf_error_t
+__huf_decode_walk(huf_bit_reader_t *reader, const huf_node_t *root, uint8_t *out)
+{
+    const huf_node_t *node = root;
+
+    do {
+        if (!reader->count) {
+            huf_error_t err = huf_bit_reader_refill(reader);
+            if (err != HUF_ERROR_SUCCESS) {
+                return err;
+            }
+
+            // The stream is exhausted, but the symbol is not decoded yet.
+            if (!reader->count) {
+                return HUF_ERROR_READ_WRITE;
+            }
+        }
+
+        // If next bit equals to 1, then move to the right branch.
+        // Otherwise move to the left branch.
+        node = huf_bit_reader_peek(reader, 1) ? node->right : node->left;
+        huf_bit_reader_consume(reader, 1);
+
+        // The decoding reached the bottom of the tree, but the decoding
+        // is not found. The tree is corrupted.
+        if (!node) {
+            return HUF_ERROR_BTREE_CORRUPTED;
+        }
+    } while (node->left || node->right);
+
+    *out = node->index;
+    return HUF_ERROR_SUCCESS;
+}
+
+
+__huf_kernel_inline_m huf_error_t
+__huf_decode_symbol(huf_bit_reader_t *reader, const huf_decode_table_t *table,
+        const huf_node_t *root, uint8_t *out)
+{
+    if (reader->count < HUF_DECODE_TABLE_BITS) {
+        huf_error_t err = huf_bit_reader_fill(reader);
+        if (err != HUF_ERROR_SUCCESS) {
+            return err;
+        }
+    }
+
+    if (reader->count >= HUF_DECODE_TABLE_BITS) {
+        size_t prefix = huf_bit_reader_peek(reader, HUF_DECODE_TABLE_BITS);
+        uint16_t element = table->elements[prefix];
+
+        if (element) {
+            *out = element & 0xff;
+            huf_bit_reader_consume(reader, element >> 8);
+            return HUF_ERROR_SUCCESS;
+        }
+    }
+
+    // Codes longer than the table prefix and the tail of the
+    // stream are decoded bit by bit.
+    return __huf_decode_walk(reader, root, out);
+}
+
+
+// Decode the symbol with a single lookup into the decoding table, the
+// register should have at least HUF_DECODE_TABLE_BITS valid bits. Zero
+// is returned, when the code is longer than the table prefix.
+__huf_kernel_inline_m size_t
+__huf_decode_lookup(uint64_t *bits, const huf_decode_table_t *table, uint8_t *out)
+{
+    uint16_t element = table->elements[*bits >> (64 - HUF_DECODE_TABLE_BITS)];
+    size_t length = element >> 8;
+
+    *out = element & 0xff;
+    *bits <<= length;
+
+    return length;
+}
+
+
+// Count of symbols decoded after a single refill of the register.
+#define HUF_DECODE_SYMBOLS_PER_REFILL (56 / HUF_DECODE_TABLE_BITS)
+
+
+__huf_kernel_inline_m huf_error_t
+__huf_decode(huf_bit_reader_t *reader, const huf_decode_table_t *table,
+        const huf_node_t *root, uint8_t *out, size_t len)
+{
+    size_t pos = 0;
+
+    while (pos < len) {
+        // Keep the register in local variables, so stores of decoded
+        // symbols don't force the compiler to reload it.
+        uint64_t bits = reader->bits;
+        size_t count = reader->count;
+        const uint8_t *ptr = reader->ptr;
+        const uint8_t *end = reader->end;
+
+        size_t symbol = HUF_DECODE_SYMBOLS_PER_REFILL;
+        size_t length = 1;
+
+        while (length && end - ptr >= 8) {
+            bits |= __huf_bit_reader_load(ptr) >> count;
+            ptr += (63 - count) >> 3;
+            count |= 56;
+
+            for (symbol = 0; symbol < HUF_DECODE_SYMBOLS_PER_REFILL; symbol++) {
+                if (pos >= len) {
+                    break;
+                }
+
+                length = __huf_decode_lookup(&bits, table, out + pos);
+                if (!length) {
+                    break;
+                }
+
+                count -= length;
+                pos++;
+            }
+
+            if (pos >= len) {
+                break;
+            }
+        }
+
+        reader->bits = bits;
+        reader->count = count;
+        reader->ptr = ptr;
+
+        // Codes longer than the table prefix and the tail of the
+        // stream are decoded one by one.
+        if (pos < len) {
+            huf_error_t err = __huf_decode_symbol(reader, table, root, out + pos);
+            if (err != HUF_ERROR_SUCCESS) {
+                return err;
+            }
+            pos++;
+        }
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+__huf_kernel_inline_m huf_error_t
+__huf_decode_streams(huf_bit_reader_t *readers, const huf_decode_table_t *table,
+        const huf_node_t *root, uint8_t **out, const uint64_t *lens)
+{
+    huf_error_t err;
+
+    uint64_t bits[HUF_INTERLEAVED_STREAMS];
+    size_t count[HUF_INTERLEAVED_STREAMS];
+    const uint8_t *ptr[HUF_INTERLEAVED_STREAMS];
+    uint8_t *out_ptr[HUF_INTERLEAVED_STREAMS];
+
+    uint64_t rounds = lens[0];
+    uint64_t pos = 0;
+    size_t stream, symbol;
+
+    for (stream = 0; stream < HUF_INTERLEAVED_STREAMS; stream++) {
+        rounds = lens[stream] < rounds ? lens[stream] : rounds;
+
+        bits[stream] = readers[stream].bits;
+        count[stream] = readers[stream].count;
+        ptr[stream] = readers[stream].ptr;
+        out_ptr[stream] = out[stream];
+    }
+
+    // Decode all streams in the same loop while each of them has symbols
+    // to decode and enough bytes for the unconditional refill.
+    while (rounds - pos >= HUF_DECODE_SYMBOLS_PER_REFILL) {
+        size_t ready = 1;
+
+        for (stream = 0; stream < HUF_INTERLEAVED_STREAMS; stream++) {
+            ready &= (readers[stream].end - ptr[stream] >= 8);
+        }
+        if (!ready) {
+            break;
+        }
+
+        for (stream = 0; stream < HUF_INTERLEAVED_STREAMS; stream++) {
+            bits[stream] |= __huf_bit_reader_load(ptr[stream]) >> count[stream];
+            ptr[stream] += (63 - count[stream]) >> 3;
+            count[stream] |= 56;
+        }
+
+        for (symbol = 0; symbol < HUF_DECODE_SYMBOLS_PER_REFILL; symbol++) {
+            size_t length = 1;
+
+            for (stream = 0; stream < HUF_INTERLEAVED_STREAMS; stream++) {
+                size_t stream_length = __huf_decode_lookup(
+                        &bits[stream], table, out_ptr[stream]);
+
+                count[stream] -= stream_length;
+                out_ptr[stream] += stream_length ? 1 : 0;
+                length &= stream_length ? 1 : 0;
+            }
+
+            // Long codes are decoded by the slower loop.
+            if (!length) {
+                break;
+            }
+        }
+
+        // Streams advanced to the different positions, finish them
+        // separately.
+        if (symbol < HUF_DECODE_SYMBOLS_PER_REFILL) {
+            break;
+        }
+
+        pos += HUF_DECODE_SYMBOLS_PER_REFILL;
+    }
+
+    // Decode the remaining symbols of each stream.
+    for (stream = 0; stream < HUF_INTERLEAVED_STREAMS; stream++) {
+        readers[stream].bits = bits[stream];
+        readers[stream].count = count[stream];
+        readers[stream].ptr = ptr[stream];
+
+        size_t decoded = out_ptr[stream] - out[stream];
+
+        err = __huf_decode(&readers[stream], table, root,
+                out_ptr[stream], lens[stream] - decoded);
+        if (err != HUF_ERROR_SUCCESS) {
+            return err;
+        }
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+// Define the set of kernels compiled with the specified attributes.
+#define __huf_kernels_m(suffix, attributes) \
+    static attributes void \
+    __huf_histogram_##suffix(uint64_t *frequencies, const uint8_t *buf, size_t len) \
+    { \
+        __huf_histogram(frequencies, buf, len); \
+    } \
+    \
+    static attributes size_t \
+    __huf_encode_##suffix(huf_bit_writer_t *writer, const huf_code_t *codes, \
+            const uint8_t *buf, size_t len, uint8_t *out) \
+    { \
+        return __huf_encode(writer, codes, buf, len, out); \
+    } \
+    \
+    static attributes huf_error_t \
+    __huf_decode_##suffix(huf_bit_reader_t *reader, const huf_decode_table_t *table, \
+            const huf_node_t *root, uint8_t *out, size_t len) \
+    { \
+        return __huf_decode(reader, table, root, out, len); \
+    } \
+    \
+    static attributes huf_error_t \
+    __huf_decode_streams_##suffix(huf_bit_reader_t *readers, \
+            const huf_decode_table_t *table, const huf_node_t *root, \
+            uint8_t **out, const uint64_t *lens) \
+    { \
+        return __huf_decode_streams(readers, table, root, out, lens); \
+    } \
+    \
+    static const huf_kernels_t __huf_kernels_##suffix = { \
+        .kind = HUF_KERNELS_##suffix, \
+        .name = #suffix, \
+        .histogram = __huf_histogram_##suffix, \
+        .encode = __huf_encode_##suffix, \
+        .decode = __huf_decode_##suffix, \
+        .decode_streams = __huf_decode_streams_##suffix, \
+    } \
+
+
+__huf_kernels_m(PORTABLE, );
+
+#if defined(HUF_KERNELS_X86)
+// Variable shifts of the bit reader and writer are compiled into
+// the shlx and shrx instructions, which don't depend on flags. The
+// decoding gains about 6% over the portable build (see huf_stages),
+// the histogram is compiled into the same instructions.
+__huf_kernels_m(BMI2, __attribute__((target("bmi2"))));
+#endif
+
+
+// Return kernels of the specified kind, or nil when the
+// processor does not support them.
+const huf_kernels_t*
+huf_kernels_lookup(huf_kernels_kind_t kind)
+{
+    if (kind == HUF_KERNELS_PORTABLE) {
+        return &__huf_kernels_PORTABLE;
+    }
+
+#if defined(HUF_KERNELS_X86)
+    __builtin_cpu_init();
+
+    if (kind == HUF_KERNELS_BMI2 && __builtin_cpu_supports("bmi2")) {
+        return &__huf_kernels_BMI2;
+    }
+#endif
+
+    return NULL;
+}
+
+
+// Kernels chosen for the processor.
+static const huf_kernels_t *__huf_kernels = NULL;
+
+
+// Choose the fastest kernels supported by the processor.
+static const huf_kernels_t*
+__huf_kernels_select(void)
+{
+    const huf_kernels_kind_t kinds[] = {
+        HUF_KERNELS_BMI2,
+        HUF_KERNELS_PORTABLE,
+    };
+
+    const huf_kernels_t *kernels = NULL;
+
+    for (size_t index = 0; !kernels; index++) {
+        kernels = huf_kernels_lookup(kinds[index]);
+    }
+
+    return kernels;
+}
+
+
+#if defined(__GNUC__)
+// Choose kernels once the library is loaded, so the
+// selection is not raced by the encoding threads.
+__attribute__((constructor))
+static void
+__huf_kernels_init(void)
+{
+    __huf_kernels = __huf_kernels_select();
+}
+#endif
+
+
+// Return the fastest kernels supported by the processor.
+const huf_kernels_t*
+huf_kernels_default(void)
+{
+    if (!__huf_kernels) {
+        __huf_kernels = __huf_kernels_select();
+    }
+
+    return __huf_kernels;
+}
@@ -1,5 +1,8 @@
+#include <string.h>
+
 #include "huffman/common.h"
 #include "huffman/errors.h"
+#include "huffman/malloc.h"
 #include "huffman/sys.h"
 
 
@@ -17,3 +20,83 @@ huf_malloc(void** ptr, size_t size, size_t num)
 
     routine_yield_m();
 }
+
+
+// Allocate the memory block of the specified size with the allocator,
+// the content of the memory block is not initialized.
+huf_error_t
+huf_alloc(const huf_allocator_t *allocator, void **ptr, size_t size, size_t num)
+{
+    routine_m();
+    routine_param_m(ptr);
+
+    *ptr = NULL;
+
+    // Size of the memory block overflows.
+    if (size && num > SIZE_MAX / size) {
+        routine_error_m(HUF_ERROR_MEMORY_ALLOCATION);
+    }
+
+    // Empty blocks are allocated as well, so nil always means failure.
+    size_t len = size && num ? size * num : 1;
+
+    if (allocator && allocator->alloc) {
+        *ptr = allocator->alloc(allocator->ctx, len);
+    } else {
+        *ptr = malloc(len);
+    }
+
+    if (!*ptr) {
+        routine_error_m(HUF_ERROR_MEMORY_ALLOCATION);
+    }
+
+    routine_yield_m();
+}
+
+
+// Allocate the zero-filled memory block of the specified
+// size with the allocator.
+huf_error_t
+huf_calloc(const huf_allocator_t *allocator, void **ptr, size_t size, size_t num)
+{
+    routine_m();
+
+    // The standard library zeroes the fresh pages for free.
+    if (!allocator || !allocator->alloc) {
+        huf_error_t err = huf_malloc(ptr, size, num);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        routine_success_m();
+    }
+
+    huf_error_t err = huf_alloc(allocator, ptr, size, num);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    memset(*ptr, 0, size * num);
+
+    routine_yield_m();
+}
+
+
+// Release the memory block allocated with the allocator.
+void
+huf_free(const huf_allocator_t *allocator, void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+
+    // Memory of the allocator without free function is released
+    // all at once by the owner of the allocator, like an arena.
+    if (allocator && allocator->alloc) {
+        if (allocator->free) {
+            allocator->free(allocator->ctx, ptr);
+        }
+    } else {
+        free(ptr);
+    }
+}
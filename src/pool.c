@@ -0,0 +1,547 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <string.h>
+
+#include "huffman/pool.h"
+#include "huffman/sys.h"
+
+
+// Size of the smallest buffer of the pool is 2^6 bytes.
+#define HUF_POOL_MIN_SHIFT 6
+
+// Size of the largest buffer of the pool is 2^22 bytes.
+#define HUF_POOL_MAX_SHIFT 22
+
+// Count of the buffer size classes.
+#define HUF_POOL_CLASSES (HUF_POOL_MAX_SHIFT - HUF_POOL_MIN_SHIFT + 1)
+
+// Maximum count of the buffers of each class cached by a thread.
+#define HUF_POOL_CACHE_LEN 4
+
+// Class of the buffers allocated directly.
+#define HUF_POOL_DIRECT HUF_POOL_CLASSES
+
+// Maximum count of the buffers shared between the threads.
+#define HUF_POOL_SLOTS 4096
+
+// Mask of the slot number in the head of the shared stack.
+#define HUF_POOL_SLOT_MASK 0xffffffffULL
+
+
+// huf_pool_header_t precedes each buffer of the pool.
+typedef struct __huf_pool_header {
+    // Size class of the buffer.
+    size_t index;
+
+    // Padding keeps the buffer aligned as the memory from malloc.
+    size_t reserved;
+} huf_pool_header_t;
+
+
+// huf_pool_slot_t links a shared buffer into the stack. Slots are
+// never released while the pool is used, so the link of a slot
+// popped by another thread is still safe to read.
+typedef struct __huf_pool_slot {
+    // Shared buffer of the slot.
+    huf_pool_header_t *header;
+
+    // Number of the next slot in the stack, zero ends the stack.
+    uint32_t next;
+} huf_pool_slot_t;
+
+
+// huf_pool_cache_t holds buffers released by a thread.
+typedef struct __huf_pool_cache {
+    // Cached buffers of each size class.
+    huf_pool_header_t *buffers[HUF_POOL_CLASSES][HUF_POOL_CACHE_LEN];
+
+    // Count of cached buffers of each size class.
+    size_t lengths[HUF_POOL_CLASSES];
+
+    // Size in bytes of all cached buffers.
+    size_t size;
+
+    // Pool of the cache.
+    huf_pool_t *pool;
+
+    // Siblings in the list of the caches of the pool.
+    struct __huf_pool_cache *prev;
+    struct __huf_pool_cache *next;
+} huf_pool_cache_t;
+
+
+struct __huf_pool {
+    // Key of the thread cache.
+    pthread_key_t key;
+
+    // Mutex guarding the list of caches.
+    pthread_mutex_t mutex;
+
+    // Lock-free stacks of the buffers shared between the threads. The
+    // lower half of the head is the number of the top slot, the upper
+    // half is the tag incremented on each change, so the head is not
+    // restored when the same slot is popped and pushed back (ABA).
+    uint64_t buffers[HUF_POOL_CLASSES];
+
+    // Lock-free stack of the unused slots.
+    uint64_t unused;
+
+    // Slots of the shared buffers, numbered from one.
+    huf_pool_slot_t slots[HUF_POOL_SLOTS];
+
+    // Maximum size in bytes of the shared buffers.
+    size_t capacity;
+
+    // Size in bytes of the shared buffers.
+    size_t size;
+
+    // Caches of all threads.
+    huf_pool_cache_t *caches;
+};
+
+
+static huf_pool_t *__huf_pool_default = NULL;
+
+static pthread_once_t __huf_pool_default_once = PTHREAD_ONCE_INIT;
+
+
+// Return the size in bytes of the buffers of the class.
+static inline size_t
+__huf_pool_class_size(size_t index)
+{
+    return (size_t)1 << (index + HUF_POOL_MIN_SHIFT);
+}
+
+
+// Return the smallest class of the buffers, that fit the size.
+static inline size_t
+__huf_pool_class(size_t size)
+{
+    size_t index = 0;
+
+    while (__huf_pool_class_size(index) < size) {
+        index++;
+    }
+
+    return index;
+}
+
+
+// Push the slot onto the stack.
+static void
+__huf_pool_push(huf_pool_t *self, uint64_t *stack, uint32_t slot)
+{
+    uint64_t head = __atomic_load_n(stack, __ATOMIC_RELAXED);
+    uint64_t next;
+
+    do {
+        __atomic_store_n(&self->slots[slot - 1].next,
+                (uint32_t)(head & HUF_POOL_SLOT_MASK), __ATOMIC_RELAXED);
+
+        next = ((head & ~HUF_POOL_SLOT_MASK) + HUF_POOL_SLOT_MASK + 1) | slot;
+    } while (!__atomic_compare_exchange_n(stack, &head, next, 1,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+
+// Pop the slot from the stack, zero is returned when the stack is empty.
+static uint32_t
+__huf_pool_pop(huf_pool_t *self, uint64_t *stack)
+{
+    uint64_t head = __atomic_load_n(stack, __ATOMIC_ACQUIRE);
+    uint64_t next;
+    uint32_t slot;
+
+    do {
+        slot = head & HUF_POOL_SLOT_MASK;
+        if (!slot) {
+            return 0;
+        }
+
+        // The link is stale when the slot was popped by another
+        // thread, but then the tag of the head is changed as well.
+        next = ((head & ~HUF_POOL_SLOT_MASK) + HUF_POOL_SLOT_MASK + 1) |
+            __atomic_load_n(&self->slots[slot - 1].next, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(stack, &head, next, 1,
+                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return slot;
+}
+
+
+// Put the buffer into the shared stack, or release it when the
+// shared buffers exceed the capacity or all slots are used.
+static void
+__huf_pool_share(huf_pool_t *self, huf_pool_header_t *header)
+{
+    size_t size = __huf_pool_class_size(header->index);
+
+    size_t shared = __atomic_add_fetch(&self->size, size, __ATOMIC_RELAXED);
+    uint32_t slot = shared <= self->capacity ?
+        __huf_pool_pop(self, &self->unused) : 0;
+
+    if (!slot) {
+        __atomic_sub_fetch(&self->size, size, __ATOMIC_RELAXED);
+        free(header);
+        return;
+    }
+
+    self->slots[slot - 1].header = header;
+    __huf_pool_push(self, &self->buffers[header->index], slot);
+}
+
+
+// Take the buffer of the class from the shared stack, nil is
+// returned when the stack is empty.
+static huf_pool_header_t*
+__huf_pool_take(huf_pool_t *self, size_t index)
+{
+    uint32_t slot = __huf_pool_pop(self, &self->buffers[index]);
+    if (!slot) {
+        return NULL;
+    }
+
+    huf_pool_header_t *header = self->slots[slot - 1].header;
+    __huf_pool_push(self, &self->unused, slot);
+
+    __atomic_sub_fetch(&self->size, __huf_pool_class_size(index),
+            __ATOMIC_RELAXED);
+
+    return header;
+}
+
+
+// Move buffers of the cache to the shared stacks and release the
+// cache. Must be called under the lock.
+static void
+__huf_pool_cache_free(huf_pool_t *self, huf_pool_cache_t *cache, int share)
+{
+    for (size_t index = 0; index < HUF_POOL_CLASSES; index++) {
+        for (size_t pos = 0; pos < cache->lengths[index]; pos++) {
+            if (share) {
+                __huf_pool_share(self, cache->buffers[index][pos]);
+            } else {
+                free(cache->buffers[index][pos]);
+            }
+        }
+    }
+
+    if (cache->prev) {
+        cache->prev->next = cache->next;
+    } else {
+        self->caches = cache->next;
+    }
+
+    if (cache->next) {
+        cache->next->prev = cache->prev;
+    }
+
+    free(cache);
+}
+
+
+// Return the buffers of the exited thread to the pool.
+static void
+__huf_pool_cache_destroy(void *arg)
+{
+    huf_pool_cache_t *cache = arg;
+    huf_pool_t *self = cache->pool;
+
+    pthread_mutex_lock(&self->mutex);
+    __huf_pool_cache_free(self, cache, 1);
+    pthread_mutex_unlock(&self->mutex);
+}
+
+
+// Return the cache of the calling thread, nil is returned
+// when the cache could not be created.
+static huf_pool_cache_t*
+__huf_pool_cache(huf_pool_t *self)
+{
+    huf_pool_cache_t *cache = pthread_getspecific(self->key);
+    if (cache) {
+        return cache;
+    }
+
+    cache = calloc(1, sizeof(huf_pool_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+
+    if (pthread_setspecific(self->key, cache)) {
+        free(cache);
+        return NULL;
+    }
+
+    cache->pool = self;
+
+    pthread_mutex_lock(&self->mutex);
+
+    cache->next = self->caches;
+    if (self->caches) {
+        self->caches->prev = cache;
+    }
+    self->caches = cache;
+
+    pthread_mutex_unlock(&self->mutex);
+
+    return cache;
+}
+
+
+// Initialize a new instance of the pool.
+huf_error_t
+huf_pool_init(huf_pool_t **self, size_t capacity)
+{
+    routine_m();
+
+    huf_pool_t *self_ptr = NULL;
+
+    routine_param_m(self);
+
+    huf_error_t err = huf_malloc(void_pptr_m(&self_ptr), sizeof(huf_pool_t), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    if (pthread_key_create(&self_ptr->key, __huf_pool_cache_destroy)) {
+        free(self_ptr);
+        routine_error_m(HUF_ERROR_FATAL);
+    }
+
+    if (pthread_mutex_init(&self_ptr->mutex, NULL)) {
+        pthread_key_delete(self_ptr->key);
+        free(self_ptr);
+        routine_error_m(HUF_ERROR_FATAL);
+    }
+
+    // All slots are unused, and the stacks of the buffers are empty.
+    for (uint32_t slot = 1; slot < HUF_POOL_SLOTS; slot++) {
+        self_ptr->slots[slot - 1].next = slot + 1;
+    }
+
+    self_ptr->unused = 1;
+    self_ptr->capacity = capacity ? capacity : HUF_POOL_CAPACITY;
+    *self = self_ptr;
+
+    routine_yield_m();
+}
+
+
+// Release memory occupied by the pool and all cached buffers.
+huf_error_t
+huf_pool_free(huf_pool_t **self)
+{
+    routine_m();
+    routine_param_m(self);
+
+    huf_pool_t *self_ptr = *self;
+    huf_pool_header_t *header = NULL;
+
+    if (!self_ptr) {
+        routine_success_m();
+    }
+
+    // Caches are not released on exit of the threads after
+    // the deletion of the key.
+    pthread_key_delete(self_ptr->key);
+
+    while (self_ptr->caches) {
+        __huf_pool_cache_free(self_ptr, self_ptr->caches, 0);
+    }
+
+    for (size_t index = 0; index < HUF_POOL_CLASSES; index++) {
+        while ((header = __huf_pool_take(self_ptr, index))) {
+            free(header);
+        }
+    }
+
+    pthread_mutex_destroy(&self_ptr->mutex);
+    free(self_ptr);
+
+    *self = NULL;
+
+    routine_yield_m();
+}
+
+
+static void
+__huf_pool_default_init(void)
+{
+    huf_pool_init(&__huf_pool_default, 0);
+}
+
+
+// Return the process-wide pool.
+huf_error_t
+huf_pool_default(huf_pool_t **pool)
+{
+    routine_m();
+    routine_param_m(pool);
+
+    pthread_once(&__huf_pool_default_once, __huf_pool_default_init);
+
+    *pool = __huf_pool_default;
+    if (!*pool) {
+        routine_error_m(HUF_ERROR_MEMORY_ALLOCATION);
+    }
+
+    routine_yield_m();
+}
+
+
+// Take the buffer of at least the specified size from the pool.
+huf_error_t
+huf_pool_get(huf_pool_t *self, void **buf, size_t size)
+{
+    routine_m();
+
+    huf_pool_header_t *header = NULL;
+    huf_pool_cache_t *cache = NULL;
+
+    routine_param_m(self);
+    routine_param_m(buf);
+
+    // Large buffers are not cached.
+    if (size > HUF_POOL_MAX_SIZE) {
+        if (size > SIZE_MAX - sizeof(huf_pool_header_t)) {
+            routine_error_m(HUF_ERROR_MEMORY_ALLOCATION);
+        }
+
+        header = malloc(sizeof(huf_pool_header_t) + size);
+        if (!header) {
+            routine_error_m(HUF_ERROR_MEMORY_ALLOCATION);
+        }
+
+        header->index = HUF_POOL_DIRECT;
+        *buf = header + 1;
+
+        routine_success_m();
+    }
+
+    size_t index = __huf_pool_class(size);
+
+    // Take the buffer from the cache of the thread without locking.
+    cache = __huf_pool_cache(self);
+    if (cache && cache->lengths[index]) {
+        header = cache->buffers[index][--cache->lengths[index]];
+        cache->size -= __huf_pool_class_size(index);
+    }
+
+    if (!header) {
+        header = __huf_pool_take(self, index);
+    }
+
+    if (!header) {
+        header = malloc(sizeof(huf_pool_header_t) + __huf_pool_class_size(index));
+        if (!header) {
+            routine_error_m(HUF_ERROR_MEMORY_ALLOCATION);
+        }
+
+        header->index = index;
+    }
+
+    *buf = header + 1;
+
+    routine_yield_m();
+}
+
+
+// Return the buffer to the pool.
+void
+huf_pool_put(huf_pool_t *self, void *buf)
+{
+    huf_pool_cache_t *cache = NULL;
+
+    if (!self || !buf) {
+        return;
+    }
+
+    huf_pool_header_t *header = (huf_pool_header_t*)buf - 1;
+    size_t index = header->index;
+
+    if (index == HUF_POOL_DIRECT) {
+        free(header);
+        return;
+    }
+
+    size_t size = __huf_pool_class_size(index);
+
+    // Keep the buffer in the cache of the thread without locking.
+    cache = __huf_pool_cache(self);
+    if (cache && cache->lengths[index] < HUF_POOL_CACHE_LEN &&
+            cache->size + size <= HUF_POOL_CACHE_SIZE) {
+        cache->buffers[index][cache->lengths[index]++] = header;
+        cache->size += size;
+        return;
+    }
+
+    __huf_pool_share(self, header);
+}
+
+
+static void*
+__huf_pool_alloc(void *ctx, size_t size)
+{
+    void *buf = NULL;
+
+    if (huf_pool_get(ctx, &buf, size) != HUF_ERROR_SUCCESS) {
+        return NULL;
+    }
+
+    return buf;
+}
+
+
+static void
+__huf_pool_release(void *ctx, void *ptr)
+{
+    huf_pool_put(ctx, ptr);
+}
+
+
+// Fill the allocator, that takes the memory from the pool.
+huf_error_t
+huf_pool_allocator(huf_pool_t *self, huf_allocator_t *allocator)
+{
+    routine_m();
+
+    routine_param_m(self);
+    routine_param_m(allocator);
+
+    allocator->alloc = __huf_pool_alloc;
+    allocator->free = __huf_pool_release;
+    allocator->ctx = self;
+
+    routine_yield_m();
+}
+
+
+// Fill the allocator, that takes the memory from the process-wide
+// pool, when the alloc function of the allocator is not set.
+huf_error_t
+huf_pool_default_allocator(huf_allocator_t *allocator)
+{
+    routine_m();
+
+    huf_pool_t *pool = NULL;
+
+    routine_param_m(allocator);
+
+    if (allocator->alloc) {
+        routine_success_m();
+    }
+
+    huf_error_t err = huf_pool_default(&pool);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_pool_allocator(pool, allocator);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
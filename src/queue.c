@@ -0,0 +1,155 @@
+#include "huffman/malloc.h"
+#include "huffman/queue.h"
+#include "huffman/sys.h"
+
+
+// Initialize a new instance of the queue with the
+// specified capacity.
+huf_error_t
+huf_queue_init(huf_queue_t **self, size_t capacity,
+        const huf_allocator_t *allocator)
+{
+    routine_m();
+
+    huf_queue_t *self_ptr = NULL;
+
+    routine_param_m(self);
+
+    if (!capacity) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    huf_error_t err = huf_calloc(allocator, void_pptr_m(&self_ptr),
+            sizeof(huf_queue_t), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    err = huf_alloc(allocator, void_pptr_m(&self_ptr->items),
+            sizeof(void*), capacity);
+    if (err != HUF_ERROR_SUCCESS) {
+        huf_free(allocator, self_ptr);
+        routine_error_m(err);
+    }
+
+    if (pthread_mutex_init(&self_ptr->mutex, NULL)) {
+        huf_free(allocator, self_ptr->items);
+        huf_free(allocator, self_ptr);
+        routine_error_m(HUF_ERROR_FATAL);
+    }
+
+    pthread_cond_init(&self_ptr->not_empty, NULL);
+    pthread_cond_init(&self_ptr->not_full, NULL);
+
+    self_ptr->capacity = capacity;
+    self_ptr->allocator = allocator;
+    *self = self_ptr;
+
+    routine_yield_m();
+}
+
+
+// Release memory occupied by the queue.
+huf_error_t
+huf_queue_free(huf_queue_t **self)
+{
+    routine_m();
+    routine_param_m(self);
+
+    huf_queue_t *self_ptr = *self;
+
+    if (!self_ptr) {
+        routine_success_m();
+    }
+
+    pthread_cond_destroy(&self_ptr->not_full);
+    pthread_cond_destroy(&self_ptr->not_empty);
+    pthread_mutex_destroy(&self_ptr->mutex);
+
+    huf_free(self_ptr->allocator, self_ptr->items);
+    huf_free(self_ptr->allocator, self_ptr);
+
+    *self = NULL;
+
+    routine_yield_m();
+}
+
+
+// Push the item to the end of the queue, wait while the queue is full.
+huf_error_t
+huf_queue_push(huf_queue_t *self, void *item)
+{
+    routine_m();
+    routine_param_m(self);
+
+    pthread_mutex_lock(&self->mutex);
+
+    while (self->length == self->capacity && !self->closed) {
+        pthread_cond_wait(&self->not_full, &self->mutex);
+    }
+
+    if (self->closed) {
+        pthread_mutex_unlock(&self->mutex);
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    self->items[(self->head + self->length) % self->capacity] = item;
+    self->length++;
+
+    pthread_cond_signal(&self->not_empty);
+    pthread_mutex_unlock(&self->mutex);
+
+    routine_yield_m();
+}
+
+
+// Pop the item from the beginning of the queue, wait while
+// the queue is empty.
+huf_error_t
+huf_queue_pop(huf_queue_t *self, void **item)
+{
+    routine_m();
+    routine_param_m(self);
+    routine_param_m(item);
+
+    pthread_mutex_lock(&self->mutex);
+
+    while (!self->length && !self->closed) {
+        pthread_cond_wait(&self->not_empty, &self->mutex);
+    }
+
+    *item = NULL;
+
+    // Items of the closed queue are still returned.
+    if (self->length) {
+        *item = self->items[self->head];
+
+        self->head = (self->head + 1) % self->capacity;
+        self->length--;
+
+        pthread_cond_signal(&self->not_full);
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+
+    routine_yield_m();
+}
+
+
+// Close the queue and wake up all waiting threads.
+huf_error_t
+huf_queue_close(huf_queue_t *self)
+{
+    routine_m();
+    routine_param_m(self);
+
+    pthread_mutex_lock(&self->mutex);
+
+    self->closed = 1;
+
+    pthread_cond_broadcast(&self->not_empty);
+    pthread_cond_broadcast(&self->not_full);
+    pthread_mutex_unlock(&self->mutex);
+
+    routine_yield_m();
+}
@@ -0,0 +1,81 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <time.h>
+
+#include "huffman/stats.h"
+#include "huffman/sys.h"
+
+
+// Return the average length of the code in bits per symbol.
+double
+huf_stats_code_length(const huf_stats_t *self)
+{
+    if (!self || !self->symbols) {
+        return 0;
+    }
+
+    return (double)self->code_bits / self->symbols;
+}
+
+
+// Return the monotonic time in nanoseconds.
+uint64_t
+huf_stats_clock(const huf_stats_t *self)
+{
+    struct timespec now;
+
+    if (!self || clock_gettime(CLOCK_MONOTONIC, &now)) {
+        return 0;
+    }
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+// Allocate the memory with the wrapped allocator. The pipelined
+// encoder allocates from several threads, so the counter is atomic.
+static void*
+__huf_stats_alloc(void *ctx, size_t size)
+{
+    huf_stats_allocator_t *self = ctx;
+
+    __atomic_fetch_add(&self->stats->allocations, 1, __ATOMIC_RELAXED);
+    return self->allocator.alloc(self->allocator.ctx, size);
+}
+
+
+// Release the memory with the wrapped allocator.
+static void
+__huf_stats_free(void *ctx, void *ptr)
+{
+    huf_stats_allocator_t *self = ctx;
+
+    if (self->allocator.free) {
+        self->allocator.free(self->allocator.ctx, ptr);
+    }
+}
+
+
+// Replace the allocator with the one counting the allocations.
+huf_error_t
+huf_stats_allocator(huf_stats_allocator_t *self, huf_stats_t *stats,
+        huf_allocator_t *allocator)
+{
+    routine_m();
+
+    routine_param_m(self);
+    routine_param_m(stats);
+    routine_param_m(allocator);
+
+    // The wrapped allocator must be complete.
+    routine_param_m(allocator->alloc);
+
+    self->allocator = *allocator;
+    self->stats = stats;
+
+    allocator->alloc = __huf_stats_alloc;
+    allocator->free = __huf_stats_free;
+    allocator->ctx = self;
+
+    routine_yield_m();
+}
@@ -12,6 +12,19 @@ huf_symbol_mapping_element_init(
         huf_symbol_mapping_element_t **self,
         const uint8_t *coding,
         size_t length)
+{
+    return huf_symbol_mapping_element_init_allocator(self, coding, length, NULL);
+}
+
+
+// Initialize a new instance of the symbol mapping element with
+// the specified allocator.
+huf_error_t
+huf_symbol_mapping_element_init_allocator(
+        huf_symbol_mapping_element_t **self,
+        const uint8_t *coding,
+        size_t length,
+        const huf_allocator_t *allocator)
 {
     routine_m();
 
@@ -21,15 +34,16 @@ huf_symbol_mapping_element_init(
     routine_param_m(self);
     routine_param_m(coding);
 
-    err = huf_malloc(void_pptr_m(self),
+    err = huf_calloc(allocator, void_pptr_m(self),
             sizeof(huf_symbol_mapping_element_t), 1);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     self_ptr = *self;
+    self_ptr->allocator = allocator;
 
-    err = huf_malloc(void_pptr_m(&self_ptr->coding),
+    err = huf_calloc(allocator, void_pptr_m(&self_ptr->coding),
             sizeof(uint8_t), length + 1);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
@@ -53,8 +67,8 @@ huf_symbol_mapping_element_free(
 
     huf_symbol_mapping_element_t *self_ptr = *self;
 
-    free(self_ptr->coding);
-    free(self_ptr);
+    huf_free(self_ptr->allocator, self_ptr->coding);
+    huf_free(self_ptr->allocator, self_ptr);
 
     *self = NULL;
 
@@ -67,6 +81,18 @@ huf_error_t
 huf_symbol_mapping_init(
         huf_symbol_mapping_t **self,
         size_t length)
+{
+    return huf_symbol_mapping_init_allocator(self, length, NULL);
+}
+
+
+// Initialize a new instance of the symbol mapping with the
+// specified allocator.
+huf_error_t
+huf_symbol_mapping_init_allocator(
+        huf_symbol_mapping_t **self,
+        size_t length,
+        const huf_allocator_t *allocator)
 {
     routine_m();
 
@@ -75,15 +101,16 @@ huf_symbol_mapping_init(
 
     routine_param_m(self);
 
-    err = huf_malloc(void_pptr_m(self),
+    err = huf_calloc(allocator, void_pptr_m(self),
             sizeof(huf_symbol_mapping_t), 1);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     self_ptr = *self;
+    self_ptr->allocator = allocator;
 
-    err = huf_malloc(void_pptr_m(&self_ptr->symbols),
+    err = huf_calloc(allocator, void_pptr_m(&self_ptr->symbols),
             sizeof(huf_symbol_mapping_element_t*), length);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
@@ -143,8 +170,8 @@ huf_symbol_mapping_free(
         routine_error_m(err);
     }
 
-    free(self_ptr->symbols);
-    free(self_ptr);
+    huf_free(self_ptr->allocator, self_ptr->symbols);
+    huf_free(self_ptr->allocator, self_ptr);
 
     *self = NULL;
 
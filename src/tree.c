@@ -50,18 +50,28 @@ huf_node_to_string(const huf_node_t *self, uint8_t *buf, size_t *len)
 // Initialize a new instance of the Huffman tree.
 huf_error_t
 huf_tree_init(huf_tree_t **self)
+{
+    return huf_tree_init_allocator(self, NULL);
+}
+
+
+// Initialize a new instance of the Huffman tree with the specified
+// allocator.
+huf_error_t
+huf_tree_init_allocator(huf_tree_t **self, const huf_allocator_t *allocator)
 {
     routine_m();
     routine_param_m(self);
 
-    huf_error_t err = huf_malloc(void_pptr_m(self), sizeof(huf_tree_t), 1);
+    huf_error_t err = huf_calloc(allocator, void_pptr_m(self), sizeof(huf_tree_t), 1);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
 
     huf_tree_t *self_ptr = *self;
+    self_ptr->allocator = allocator;
 
-    err = huf_malloc(void_pptr_m(&self_ptr->leaves),
+    err = huf_calloc(allocator, void_pptr_m(&self_ptr->leaves),
             sizeof(huf_node_t*), HUF_ASCII_COUNT * 2);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
@@ -74,21 +84,21 @@ huf_tree_init(huf_tree_t **self)
 // Recursively release memory occupied
 // by the Huffman nodes.
 static void
-__huf_tree_free(huf_node_t* node)
+__huf_tree_free(const huf_allocator_t *allocator, huf_node_t* node)
 {
     if (!node) {
         return;
     }
 
     if (node->left) {
-        __huf_tree_free(node->left);
-        free(node->left);
+        __huf_tree_free(allocator, node->left);
+        huf_free(allocator, node->left);
         node->left = NULL;
     }
 
     if (node->right) {
-        __huf_tree_free(node->right);
-        free(node->right);
+        __huf_tree_free(allocator, node->right);
+        huf_free(allocator, node->right);
         node->left = NULL;
     }
 }
@@ -103,11 +113,13 @@ huf_tree_free(huf_tree_t **self)
 
     huf_tree_t *self_ptr = *self;
 
-    __huf_tree_free(self_ptr->root);
+    const huf_allocator_t *allocator = self_ptr->allocator;
+
+    __huf_tree_free(allocator, self_ptr->root);
 
-    free(self_ptr->root);
-    free(self_ptr->leaves);
-    free(self_ptr);
+    huf_free(allocator, self_ptr->root);
+    huf_free(allocator, self_ptr->leaves);
+    huf_free(allocator, self_ptr);
 
     *self = NULL;
 
@@ -123,8 +135,8 @@ huf_tree_reset(huf_tree_t *self)
     routine_m();
     routine_param_m(self);
 
-    __huf_tree_free(self->root);
-    free(self->root);
+    __huf_tree_free(self->allocator, self->root);
+    huf_free(self->allocator, self->root);
     self->root = NULL;
 
     // Reset the memory occupied by the leaves.
@@ -136,7 +148,8 @@ huf_tree_reset(huf_tree_t *self)
 
 // Recursively de-serialize the Huffman tree from the provided buffer.
 static huf_error_t
-__huf_deserialize_tree(huf_node_t **node, const int16_t *buf, size_t *len)
+__huf_deserialize_tree(const huf_allocator_t *allocator,
+        huf_node_t **node, const int16_t *buf, size_t *len)
 {
     routine_m();
 
@@ -170,7 +183,7 @@ __huf_deserialize_tree(huf_node_t **node, const int16_t *buf, size_t *len)
         routine_success_m();
     }
 
-    huf_error_t err = huf_malloc(void_pptr_m(&node_ptr), sizeof(huf_node_t), 1);
+    huf_error_t err = huf_calloc(allocator, void_pptr_m(&node_ptr), sizeof(huf_node_t), 1);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
@@ -187,7 +200,7 @@ __huf_deserialize_tree(huf_node_t **node, const int16_t *buf, size_t *len)
     left_branch_len = buf_len - 1;
 
     // Recursively de-serialize a left branch of the tree.
-    err = __huf_deserialize_tree(node_left, buf_ptr, &left_branch_len);
+    err = __huf_deserialize_tree(allocator, node_left, buf_ptr, &left_branch_len);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
@@ -196,7 +209,7 @@ __huf_deserialize_tree(huf_node_t **node, const int16_t *buf, size_t *len)
     right_branch_len = buf_len - left_branch_len - 1;
 
     // Recursively de-serialize a right branch of the tree.
-    err = __huf_deserialize_tree(node_right, buf_ptr, &right_branch_len);
+    err = __huf_deserialize_tree(allocator, node_right, buf_ptr, &right_branch_len);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
@@ -218,7 +231,7 @@ huf_tree_deserialize(huf_tree_t *self, const int16_t *buf, size_t len)
     routine_param_m(self);
     routine_param_m(buf);
 
-    huf_error_t err = __huf_deserialize_tree(&self->root, buf, &len);
+    huf_error_t err = __huf_deserialize_tree(self->allocator, &self->root, buf, &len);
     if (err != HUF_ERROR_SUCCESS) {
         routine_error_m(err);
     }
@@ -289,6 +302,37 @@ huf_tree_serialize(huf_tree_t *self, int16_t *buf, size_t *len)
 }
 
 
+// Recursively calculate the depth of the tree starting
+// from the specified node.
+static size_t
+__huf_tree_depth(const huf_node_t *node)
+{
+    if (!node || (!node->left && !node->right)) {
+        return 0;
+    }
+
+    size_t left = __huf_tree_depth(node->left);
+    size_t right = __huf_tree_depth(node->right);
+
+    return (left > right ? left : right) + 1;
+}
+
+
+// Return the depth of the Huffman tree.
+huf_error_t
+huf_tree_depth(const huf_tree_t *self, size_t *depth)
+{
+    routine_m();
+
+    routine_param_m(self);
+    routine_param_m(depth);
+
+    *depth = __huf_tree_depth(self->root);
+
+    routine_yield_m();
+}
+
+
 huf_error_t
 huf_tree_from_histogram(huf_tree_t *self, huf_histogram_t *histogram)
 {
@@ -357,9 +401,16 @@ huf_tree_from_histogram(huf_tree_t *self, huf_histogram_t *histogram)
             break;
         }
 
+        // The last node is the root of the tree. Only the single symbol
+        // needs a parent, so it is encoded with a one-bit code.
+        if (index2 == -1 && index1 >= HUF_ASCII_COUNT) {
+            self->root = shadow_tree[index1];
+            break;
+        }
+
         if (index1 > -1 && !shadow_tree[index1]) {
             // Allocate memory for the left child of the node.
-            err = huf_malloc(void_pptr_m(&shadow_tree[index1]), sizeof(huf_node_t), 1);
+            err = huf_calloc(self->allocator, void_pptr_m(&shadow_tree[index1]), sizeof(huf_node_t), 1);
             if (err != HUF_ERROR_SUCCESS) {
                 routine_error_m(err);
             }
@@ -367,14 +418,14 @@ huf_tree_from_histogram(huf_tree_t *self, huf_histogram_t *histogram)
 
         if (index2 > -1 && !shadow_tree[index2]) {
             // Allocate memory for the right child of the node.
-            err = huf_malloc(void_pptr_m(&shadow_tree[index2]), sizeof(huf_node_t), 1);
+            err = huf_calloc(self->allocator, void_pptr_m(&shadow_tree[index2]), sizeof(huf_node_t), 1);
             if (err != HUF_ERROR_SUCCESS) {
                 routine_error_m(err);
             }
         }
 
         // Allocate memory for the node itself.
-        err = huf_malloc(void_pptr_m(&shadow_tree[node]), sizeof(huf_node_t), 1);
+        err = huf_calloc(self->allocator, void_pptr_m(&shadow_tree[node]), sizeof(huf_node_t), 1);
         if (err != HUF_ERROR_SUCCESS) {
             routine_error_m(err);
         }
@@ -419,7 +470,7 @@ huf_tree_from_histogram(huf_tree_t *self, huf_histogram_t *histogram)
     // release the memory block occupied by the shadow tree.
     if (routine_violation_m()) {
         for (j = 0; j < shadow_tree_len; j++) {
-            free(shadow_tree[j]);
+            huf_free(self->allocator, shadow_tree[j]);
         }
     }
 
@@ -0,0 +1,664 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "huffman/io.h"
+#include "huffman/malloc.h"
+#include "huffman/sys.h"
+
+
+// The io_uring interface is used directly through the system calls, so
+// only the kernel headers are required.
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_FAST_POLL)
+#define HUF_URING_SUPPORTED
+#endif
+#endif
+#endif
+
+
+// Synchronous reads and writes of the file descriptor.
+huf_error_t fdread(void *stream, void *buf, size_t *count);
+huf_error_t fdwrite(void *stream, const void *buf, size_t count);
+
+
+// Count of the buffers in flight.
+#define HUF_URING_DEPTH 4
+
+// Size of each buffer in bytes.
+#define HUF_URING_BUFFER_SIZE HUF_128KIB_BUFFER
+
+
+typedef struct __huf_uring_buffer {
+    // Memory of the buffer.
+    uint8_t *bytes;
+
+    // Offset of the buffer in the file.
+    uint64_t offset;
+
+    // Count of bytes to read or write.
+    size_t requested;
+
+    // Count of bytes already read or written by the kernel.
+    size_t length;
+
+    // Count of bytes consumed from the buffer on reads,
+    // or filled into the buffer on writes.
+    size_t position;
+
+    // Non-zero value when the request is in flight.
+    int pending;
+} huf_uring_buffer_t;
+
+
+typedef struct __huf_uring {
+    // Descriptor of the file.
+    int fd;
+
+    // Mode of the file.
+    huf_io_mode_t mode;
+
+    // Descriptor of the ring, or -1 when the file is read
+    // and written synchronously.
+    int ring_fd;
+
+#if defined(HUF_URING_SUPPORTED)
+    // Submission queue ring.
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+
+    // Submission queue entries.
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    // Completion queue ring.
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+#endif
+
+    // Ring of the buffers, the current buffer is either consumed
+    // by reads or filled by writes.
+    huf_uring_buffer_t buffers[HUF_URING_DEPTH];
+    size_t current;
+
+    // Memory of all buffers.
+    uint8_t *bytes;
+
+    // Offset of the next request in the file.
+    uint64_t offset;
+
+    // Offset of the data consumed by the reads.
+    uint64_t position;
+
+    // Count of requests in flight.
+    size_t inflight;
+
+    // Error of the asynchronous request.
+    huf_error_t error;
+} huf_uring_t;
+
+
+#if defined(HUF_URING_SUPPORTED)
+
+
+// Create the ring and map its queues into the memory.
+static huf_error_t
+__huf_uring_setup(huf_uring_t *self)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int ring_fd = syscall(__NR_io_uring_setup, HUF_URING_DEPTH * 2, &params);
+    if (ring_fd < 0) {
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    self->ring_fd = ring_fd;
+
+    // Plain read and write requests are supported since the same
+    // kernel version as the fast poll feature.
+    if (!(params.features & IORING_FEAT_FAST_POLL)) {
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    self->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    self->sq_ring = mmap(NULL, self->sq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED, ring_fd, IORING_OFF_SQ_RING);
+    if (self->sq_ring == MAP_FAILED) {
+        self->sq_ring = NULL;
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    self->cq_ring_size = params.cq_off.cqes
+        + params.cq_entries * sizeof(struct io_uring_cqe);
+    self->cq_ring = mmap(NULL, self->cq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED, ring_fd, IORING_OFF_CQ_RING);
+    if (self->cq_ring == MAP_FAILED) {
+        self->cq_ring = NULL;
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    self->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    self->sqes = mmap(NULL, self->sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED, ring_fd, IORING_OFF_SQES);
+    if (self->sqes == MAP_FAILED) {
+        self->sqes = NULL;
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    uint8_t *sq_ring = self->sq_ring;
+    uint8_t *cq_ring = self->cq_ring;
+
+    self->sq_tail = (unsigned*)(sq_ring + params.sq_off.tail);
+    self->sq_mask = (unsigned*)(sq_ring + params.sq_off.ring_mask);
+    self->sq_array = (unsigned*)(sq_ring + params.sq_off.array);
+
+    self->cq_head = (unsigned*)(cq_ring + params.cq_off.head);
+    self->cq_tail = (unsigned*)(cq_ring + params.cq_off.tail);
+    self->cq_mask = (unsigned*)(cq_ring + params.cq_off.ring_mask);
+    self->cqes = (struct io_uring_cqe*)(cq_ring + params.cq_off.cqes);
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+// Release the ring and its queues.
+static void
+__huf_uring_teardown(huf_uring_t *self)
+{
+    if (self->sqes) {
+        munmap(self->sqes, self->sqes_size);
+    }
+    if (self->cq_ring) {
+        munmap(self->cq_ring, self->cq_ring_size);
+    }
+    if (self->sq_ring) {
+        munmap(self->sq_ring, self->sq_ring_size);
+    }
+    if (self->ring_fd >= 0) {
+        close(self->ring_fd);
+    }
+
+    self->sqes = NULL;
+    self->cq_ring = NULL;
+    self->sq_ring = NULL;
+    self->ring_fd = -1;
+}
+
+
+// Submit the request for the rest of the specified buffer.
+static huf_error_t
+__huf_uring_submit(huf_uring_t *self, size_t index)
+{
+    huf_uring_buffer_t *buffer = &self->buffers[index];
+
+    // Only this process writes the tail of the submission queue.
+    unsigned tail = *self->sq_tail;
+    unsigned sq_index = tail & *self->sq_mask;
+
+    struct io_uring_sqe *sqe = &self->sqes[sq_index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqe->opcode = self->mode == HUF_IO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = self->fd;
+    sqe->off = buffer->offset + buffer->length;
+    sqe->addr = (uintptr_t)(buffer->bytes + buffer->length);
+    sqe->len = buffer->requested - buffer->length;
+    sqe->user_data = index;
+
+    self->sq_array[sq_index] = sq_index;
+    __atomic_store_n(self->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    long submitted;
+    do {
+        submitted = syscall(__NR_io_uring_enter, self->ring_fd, 1, 0, 0, NULL, 0);
+    } while (submitted < 0 && errno == EINTR);
+
+    if (submitted != 1) {
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    buffer->pending = 1;
+    self->inflight++;
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+// Account the completed request, the partially completed
+// request is submitted again for the rest of the buffer.
+static huf_error_t
+__huf_uring_complete(huf_uring_t *self, size_t index, int result)
+{
+    huf_uring_buffer_t *buffer = &self->buffers[index];
+
+    buffer->pending = 0;
+    self->inflight--;
+
+    if (result < 0) {
+        self->error = HUF_ERROR_READ_WRITE;
+        return self->error;
+    }
+
+    buffer->length += result;
+
+    // The end of the file is reached.
+    if (self->mode == HUF_IO_READ && !result) {
+        return HUF_ERROR_SUCCESS;
+    }
+
+    if (self->mode == HUF_IO_WRITE && !result && buffer->length < buffer->requested) {
+        self->error = HUF_ERROR_READ_WRITE;
+        return self->error;
+    }
+
+    if (buffer->length < buffer->requested) {
+        return __huf_uring_submit(self, index);
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+// Wait for at least one request to complete, and process
+// all completed requests.
+static huf_error_t
+__huf_uring_reap(huf_uring_t *self)
+{
+    huf_error_t err = HUF_ERROR_SUCCESS;
+    unsigned head = *self->cq_head;
+
+    while (head == __atomic_load_n(self->cq_tail, __ATOMIC_ACQUIRE)) {
+        long ret = syscall(__NR_io_uring_enter, self->ring_fd, 0, 1,
+                IORING_ENTER_GETEVENTS, NULL, 0);
+
+        // The ring itself is broken, so the requests never complete.
+        if (ret < 0 && errno != EINTR) {
+            return HUF_ERROR_FATAL;
+        }
+    }
+
+    while (head != __atomic_load_n(self->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &self->cqes[head & *self->cq_mask];
+
+        size_t index = cqe->user_data;
+        int result = cqe->res;
+
+        __atomic_store_n(self->cq_head, ++head, __ATOMIC_RELEASE);
+
+        huf_error_t complete_err = __huf_uring_complete(self, index, result);
+        if (complete_err != HUF_ERROR_SUCCESS) {
+            err = complete_err;
+        }
+    }
+
+    return err;
+}
+
+
+// Wait until the request of the specified buffer completes.
+static huf_error_t
+__huf_uring_wait(huf_uring_t *self, size_t index)
+{
+    while (self->buffers[index].pending) {
+        huf_error_t err = __huf_uring_reap(self);
+        if (err != HUF_ERROR_SUCCESS) {
+            return err;
+        }
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+// Wait until all requests complete.
+static huf_error_t
+__huf_uring_drain(huf_uring_t *self)
+{
+    huf_error_t err = HUF_ERROR_SUCCESS;
+
+    while (self->inflight) {
+        huf_error_t reap_err = __huf_uring_reap(self);
+        if (reap_err != HUF_ERROR_SUCCESS) {
+            err = reap_err;
+        }
+
+        // Requests are not completed, when the ring is broken.
+        if (reap_err == HUF_ERROR_FATAL) {
+            break;
+        }
+    }
+
+    return err;
+}
+
+
+// Submit the request for the next part of the file into the buffer.
+static huf_error_t
+__huf_uring_submit_next(huf_uring_t *self, size_t index, size_t requested)
+{
+    huf_uring_buffer_t *buffer = &self->buffers[index];
+
+    buffer->offset = self->offset;
+    buffer->requested = requested;
+    buffer->length = 0;
+    buffer->position = 0;
+
+    self->offset += requested;
+
+    return __huf_uring_submit(self, index);
+}
+
+
+#else
+
+
+static huf_error_t
+__huf_uring_setup(huf_uring_t *self)
+{
+    return HUF_ERROR_READ_WRITE;
+}
+
+
+static void
+__huf_uring_teardown(huf_uring_t *self)
+{
+    self->ring_fd = -1;
+}
+
+
+static huf_error_t
+__huf_uring_wait(huf_uring_t *self, size_t index)
+{
+    return HUF_ERROR_FATAL;
+}
+
+
+static huf_error_t
+__huf_uring_drain(huf_uring_t *self)
+{
+    return HUF_ERROR_SUCCESS;
+}
+
+
+static huf_error_t
+__huf_uring_submit_next(huf_uring_t *self, size_t index, size_t requested)
+{
+    return HUF_ERROR_FATAL;
+}
+
+
+#endif
+
+
+huf_error_t uringread(void *stream, void *buf, size_t *count)
+{
+    huf_uring_t *self = (huf_uring_t*)stream;
+    huf_error_t err;
+
+    uint8_t *buf_ptr = buf;
+    size_t copied = 0;
+
+    if (self->mode != HUF_IO_READ) {
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    if (self->ring_fd < 0) {
+        return fdread(&self->fd, buf, count);
+    }
+
+    // The previous asynchronous request failed.
+    if (self->error != HUF_ERROR_SUCCESS) {
+        return self->error;
+    }
+
+    while (copied < *count) {
+        huf_uring_buffer_t *buffer = &self->buffers[self->current];
+
+        err = __huf_uring_wait(self, self->current);
+        if (err != HUF_ERROR_SUCCESS) {
+            *count = copied;
+            return err;
+        }
+
+        size_t available = buffer->length - buffer->position;
+
+        if (available) {
+            size_t num_copy = *count - copied;
+            if (num_copy > available) {
+                num_copy = available;
+            }
+
+            memcpy(buf_ptr + copied, buffer->bytes + buffer->position, num_copy);
+
+            buffer->position += num_copy;
+            self->position += num_copy;
+            copied += num_copy;
+            continue;
+        }
+
+        // The buffer is filled partially only at the end of the file.
+        if (buffer->length < buffer->requested) {
+            break;
+        }
+
+        // Reuse the consumed buffer to read ahead the next part of the file.
+        err = __huf_uring_submit_next(self, self->current, HUF_URING_BUFFER_SIZE);
+        if (err != HUF_ERROR_SUCCESS) {
+            *count = copied;
+            return err;
+        }
+
+        self->current = (self->current + 1) % HUF_URING_DEPTH;
+    }
+
+    *count = copied;
+    return HUF_ERROR_SUCCESS;
+}
+
+
+huf_error_t uringwrite(void *stream, const void *buf, size_t count)
+{
+    huf_uring_t *self = (huf_uring_t*)stream;
+    huf_error_t err;
+
+    const uint8_t *buf_ptr = buf;
+
+    if (self->mode != HUF_IO_WRITE) {
+        return HUF_ERROR_READ_WRITE;
+    }
+
+    if (self->ring_fd < 0) {
+        return fdwrite(&self->fd, buf, count);
+    }
+
+    // The previous asynchronous request failed.
+    if (self->error != HUF_ERROR_SUCCESS) {
+        return self->error;
+    }
+
+    while (count > 0) {
+        huf_uring_buffer_t *buffer = &self->buffers[self->current];
+
+        // Wait for the previous write from the buffer.
+        err = __huf_uring_wait(self, self->current);
+        if (err != HUF_ERROR_SUCCESS) {
+            return err;
+        }
+
+        size_t num_copy = HUF_URING_BUFFER_SIZE - buffer->position;
+        if (num_copy > count) {
+            num_copy = count;
+        }
+
+        memcpy(buffer->bytes + buffer->position, buf_ptr, num_copy);
+
+        buffer->position += num_copy;
+        buf_ptr += num_copy;
+        count -= num_copy;
+
+        if (buffer->position < HUF_URING_BUFFER_SIZE) {
+            break;
+        }
+
+        // Write the filled buffer, while the next one is filled.
+        err = __huf_uring_submit_next(self, self->current, buffer->position);
+        if (err != HUF_ERROR_SUCCESS) {
+            return err;
+        }
+
+        self->current = (self->current + 1) % HUF_URING_DEPTH;
+    }
+
+    return HUF_ERROR_SUCCESS;
+}
+
+
+huf_error_t huf_uringopen(huf_read_writer_t **self, int fd, huf_io_mode_t mode)
+{
+    routine_m();
+
+    huf_error_t err;
+    huf_uring_t *uring = NULL;
+    huf_read_writer_t *self_ptr;
+
+    routine_param_m(self);
+
+    if (mode != HUF_IO_READ && mode != HUF_IO_WRITE) {
+        routine_error_m(HUF_ERROR_INVALID_ARGUMENT);
+    }
+
+    err = huf_malloc(void_pptr_m(&uring), sizeof(huf_uring_t), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    uring->fd = fd;
+    uring->mode = mode;
+    uring->ring_fd = -1;
+
+    // Read and write the file synchronously, when io_uring
+    // is not supported by the kernel.
+    err = __huf_uring_setup(uring);
+    if (err != HUF_ERROR_SUCCESS) {
+        __huf_uring_teardown(uring);
+    }
+
+    if (uring->ring_fd >= 0) {
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (offset < 0) {
+            routine_error_m(HUF_ERROR_READ_WRITE);
+        }
+
+        uring->offset = offset;
+        uring->position = offset;
+
+        err = huf_malloc(void_pptr_m(&uring->bytes), sizeof(uint8_t),
+                HUF_URING_BUFFER_SIZE * HUF_URING_DEPTH);
+        if (err != HUF_ERROR_SUCCESS) {
+            routine_error_m(err);
+        }
+
+        for (size_t index = 0; index < HUF_URING_DEPTH; index++) {
+            uring->buffers[index].bytes = uring->bytes + index * HUF_URING_BUFFER_SIZE;
+        }
+    }
+
+    // Start reading ahead into all buffers at once.
+    if (uring->ring_fd >= 0 && mode == HUF_IO_READ) {
+        for (size_t index = 0; index < HUF_URING_DEPTH; index++) {
+            err = __huf_uring_submit_next(uring, index, HUF_URING_BUFFER_SIZE);
+            if (err != HUF_ERROR_SUCCESS) {
+                routine_error_m(err);
+            }
+        }
+    }
+
+    err = huf_malloc(void_pptr_m(self), sizeof(huf_read_writer_t), 1);
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    self_ptr = *self;
+    self_ptr->stream = uring;
+    self_ptr->read = uringread;
+    self_ptr->write = uringwrite;
+
+    routine_ensure_m();
+
+    if (routine_violation_m() && uring) {
+        __huf_uring_drain(uring);
+        __huf_uring_teardown(uring);
+
+        free(uring->bytes);
+        free(uring);
+    }
+
+    routine_defer_m();
+}
+
+
+huf_error_t huf_uringclose(huf_read_writer_t **self)
+{
+    routine_m();
+    routine_param_m(self);
+
+    huf_error_t err = HUF_ERROR_SUCCESS;
+    huf_read_writer_t *self_ptr = *self;
+    huf_uring_t *uring = (huf_uring_t*)self_ptr->stream;
+
+    if (uring->ring_fd >= 0) {
+        huf_uring_buffer_t *buffer = &uring->buffers[uring->current];
+
+        // Write the rest of the data.
+        if (uring->mode == HUF_IO_WRITE && buffer->position) {
+            err = __huf_uring_wait(uring, uring->current);
+            if (err == HUF_ERROR_SUCCESS) {
+                err = __huf_uring_submit_next(uring, uring->current, buffer->position);
+            }
+        }
+
+        // The memory of the buffers could be released only
+        // after all requests are completed.
+        huf_error_t drain_err = __huf_uring_drain(uring);
+        if (err == HUF_ERROR_SUCCESS) {
+            err = drain_err;
+        }
+
+        if (err == HUF_ERROR_SUCCESS) {
+            err = uring->error;
+        }
+
+        // Leave the file position right after the read or written data.
+        uint64_t position = uring->mode == HUF_IO_READ ? uring->position : uring->offset;
+        if (lseek(uring->fd, position, SEEK_SET) < 0 && err == HUF_ERROR_SUCCESS) {
+            err = HUF_ERROR_READ_WRITE;
+        }
+    }
+
+    __huf_uring_teardown(uring);
+
+    free(uring->bytes);
+    free(uring);
+    free(self_ptr);
+    *self = NULL;
+
+    if (err != HUF_ERROR_SUCCESS) {
+        routine_error_m(err);
+    }
+
+    routine_yield_m();
+}
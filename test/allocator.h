@@ -0,0 +1,47 @@
+#ifndef INCLUDE_huffman_allocator_h__
+#define INCLUDE_huffman_allocator_h__
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <huffman/malloc.h>
+
+// counting_allocator_t counts the calls of the test allocator. The
+// counters are updated atomically, since the allocator is shared by
+// the threads of the pipelined encoder.
+typedef struct counting_allocator {
+    size_t allocations;
+    size_t releases;
+} counting_allocator_t;
+
+
+static inline void*
+counting_alloc(void *ctx, size_t size)
+{
+    counting_allocator_t *counter = ctx;
+
+    __atomic_fetch_add(&counter->allocations, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+
+static inline void
+counting_free(void *ctx, void *ptr)
+{
+    counting_allocator_t *counter = ctx;
+
+    __atomic_fetch_add(&counter->releases, 1, __ATOMIC_RELAXED);
+    free(ptr);
+}
+
+
+// Return the allocator, that counts its calls with the counter.
+static inline huf_allocator_t
+counting_allocator(counting_allocator_t *counter)
+{
+    huf_allocator_t allocator = {counting_alloc, counting_free, counter};
+    return allocator;
+}
+
+
+#endif // INCLUDE_huffman_allocator_h__
@@ -0,0 +1,304 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <huffman/bufio.h>
+#include <huffman/io.h>
+#include "assert.h"
+
+
+static const uint8_t bit_stream[] = {
+    0xa5, 0x0f, 0x3c, 0xff, 0x00, 0x81, 0x42, 0x24, 0x18, 0x99,
+};
+
+
+static void
+test_bit_reader_memory(void **state)
+{
+    huf_bit_reader_t reader;
+
+    huf_bit_reader_init(&reader, bit_stream, sizeof(bit_stream));
+    assert_ok(huf_bit_reader_refill(&reader));
+    assert_true(reader.count >= 56);
+
+    assert_int_equal(huf_bit_reader_peek(&reader, 4), 0xa);
+    huf_bit_reader_consume(&reader, 4);
+
+    // Read the bits crossing the byte boundary.
+    assert_int_equal(huf_bit_reader_peek(&reader, 8), 0x50);
+    huf_bit_reader_consume(&reader, 8);
+
+    assert_int_equal(huf_bit_reader_peek(&reader, 16), 0xf3cf);
+    huf_bit_reader_consume(&reader, 16);
+
+    // Consume the rest of the stream except the last 4 bits.
+    size_t rest = sizeof(bit_stream) * 8 - 32;
+    while (rest > 0) {
+        assert_ok(huf_bit_reader_refill(&reader));
+
+        size_t count = reader.count < rest ? reader.count : rest;
+        huf_bit_reader_consume(&reader, count);
+        rest -= count;
+    }
+
+    assert_int_equal(huf_bit_reader_peek(&reader, 4), 0x9);
+    huf_bit_reader_consume(&reader, 4);
+
+    assert_ok(huf_bit_reader_refill(&reader));
+    assert_int_equal(reader.count, 0);
+}
+
+
+static void
+test_bit_reader_attach(void **state)
+{
+    void *buf = NULL;
+    huf_read_writer_t *mem = NULL;
+    huf_bufio_read_writer_t *bufio = NULL;
+
+    uint8_t byte = 0;
+
+    assert_ok(huf_memopen(&mem, &buf, sizeof(bit_stream)));
+    assert_ok(mem->write(mem->stream, bit_stream, sizeof(bit_stream)));
+
+    // Use the buffer smaller than the register, so the window of the
+    // bit reader is refilled from the reader.
+    assert_ok(huf_bufio_read_writer_init(&bufio, mem, 3));
+
+    assert_ok(huf_bufio_read_uint8(bufio, &byte));
+    assert_int_equal(byte, 0xa5);
+
+    huf_bit_reader_t reader;
+    assert_ok(huf_bit_reader_attach(&reader, bufio));
+
+    assert_ok(huf_bit_reader_refill(&reader));
+    assert_int_equal(huf_bit_reader_peek(&reader, 12), 0x0f3);
+    huf_bit_reader_consume(&reader, 12);
+
+    // The rest of the partially read byte is skipped, the following
+    // bytes are available for reading again.
+    assert_ok(huf_bit_reader_detach(&reader));
+    assert_int_equal(bufio->have_been_processed, 3);
+
+    assert_ok(huf_bufio_read_uint8(bufio, &byte));
+    assert_int_equal(byte, 0xff);
+
+    assert_ok(huf_bit_reader_attach(&reader, bufio));
+
+    for (size_t index = 4; index < sizeof(bit_stream); index++) {
+        assert_ok(huf_bit_reader_refill(&reader));
+        assert_true(reader.count >= 8);
+
+        assert_int_equal(huf_bit_reader_peek(&reader, 8), bit_stream[index]);
+        huf_bit_reader_consume(&reader, 8);
+    }
+
+    assert_ok(huf_bit_reader_detach(&reader));
+    assert_int_equal(bufio->have_been_processed, sizeof(bit_stream));
+
+    assert_ok(huf_bufio_read_writer_free(&bufio));
+    assert_ok(huf_memclose(&mem));
+    free(buf);
+}
+
+
+static void
+test_bit_reader_unbuffered(void **state)
+{
+    void *buf = NULL;
+    huf_read_writer_t *mem = NULL;
+    huf_bufio_read_writer_t *bufio = NULL;
+
+    assert_ok(huf_memopen(&mem, &buf, sizeof(bit_stream)));
+    assert_ok(mem->write(mem->stream, bit_stream, sizeof(bit_stream)));
+    assert_ok(huf_bufio_read_writer_init(&bufio, mem, 0));
+
+    huf_bit_reader_t reader;
+    assert_ok(huf_bit_reader_attach(&reader, bufio));
+
+    // Unbuffered reader should never read more than a byte ahead.
+    assert_ok(huf_bit_reader_refill(&reader));
+    assert_int_equal(reader.count, 8);
+    huf_bit_reader_consume(&reader, 3);
+
+    assert_ok(huf_bit_reader_refill(&reader));
+    assert_int_equal(reader.count, 5);
+    huf_bit_reader_consume(&reader, 5);
+
+    assert_ok(huf_bit_reader_refill(&reader));
+    assert_int_equal(huf_bit_reader_peek(&reader, 8), 0x0f);
+    huf_bit_reader_consume(&reader, 1);
+
+    assert_ok(huf_bit_reader_detach(&reader));
+    assert_int_equal(bufio->have_been_processed, 2);
+
+    assert_ok(huf_bufio_read_writer_free(&bufio));
+    assert_ok(huf_memclose(&mem));
+    free(buf);
+}
+
+
+static void
+test_bufio_peek_consume(void **state)
+{
+    void *buf = NULL;
+    huf_read_writer_t *mem = NULL;
+    huf_bufio_read_writer_t *bufio = NULL;
+
+    const uint8_t *window = NULL;
+    size_t len = 0;
+    uint8_t byte = 0;
+
+    assert_ok(huf_memopen(&mem, &buf, sizeof(bit_stream)));
+    assert_ok(mem->write(mem->stream, bit_stream, sizeof(bit_stream)));
+    assert_ok(huf_bufio_read_writer_init(&bufio, mem, 4));
+
+    assert_ok(huf_bufio_read_uint8(bufio, &byte));
+    assert_int_equal(byte, 0xa5);
+
+    // Bytes left in the buffer are returned without reading.
+    len = 1;
+    assert_ok(huf_bufio_peek(bufio, &window, &len));
+    assert_int_equal(len, 3);
+    assert_memory_equal(window, bit_stream + 1, len);
+
+    assert_ok(huf_bufio_consume(bufio, 2));
+    assert_int_equal(bufio->have_been_processed, 3);
+
+    // The rest of the buffer is moved, so the requested
+    // bytes are next to each other.
+    len = 4;
+    assert_ok(huf_bufio_peek(bufio, &window, &len));
+    assert_int_equal(len, 4);
+    assert_memory_equal(window, bit_stream + 3, len);
+
+    assert_int_equal(huf_bufio_consume(bufio, 5), HUF_ERROR_INVALID_ARGUMENT);
+    assert_ok(huf_bufio_consume(bufio, 4));
+
+    // Request larger than the buffer returns the whole buffer.
+    len = 16;
+    assert_ok(huf_bufio_peek(bufio, &window, &len));
+    assert_int_equal(len, 3);
+    assert_memory_equal(window, bit_stream + 7, len);
+
+    assert_ok(huf_bufio_consume(bufio, len));
+    assert_int_equal(bufio->have_been_processed, sizeof(bit_stream));
+
+    len = 1;
+    assert_ok(huf_bufio_peek(bufio, &window, &len));
+    assert_int_equal(len, 0);
+
+    assert_ok(huf_bufio_read_writer_free(&bufio));
+    assert_ok(huf_memclose(&mem));
+    free(buf);
+}
+
+
+static void
+test_bufio_reserve_commit(void **state)
+{
+    void *buf = NULL;
+    huf_read_writer_t *mem = NULL;
+    huf_bufio_read_writer_t *bufio = NULL;
+
+    uint8_t *window = NULL;
+    size_t len = 0;
+
+    assert_ok(huf_memopen(&mem, &buf, sizeof(bit_stream)));
+    assert_ok(huf_bufio_read_writer_init(&bufio, mem, 8));
+
+    len = 6;
+    assert_ok(huf_bufio_reserve(bufio, &window, &len));
+    assert_int_equal(len, 8);
+
+    memcpy(window, bit_stream, 6);
+    assert_ok(huf_bufio_commit(bufio, 6));
+
+    // The buffer is flushed, when it does not have enough space.
+    len = 4;
+    assert_ok(huf_bufio_reserve(bufio, &window, &len));
+    assert_int_equal(len, 8);
+
+    size_t mem_len = 0;
+    assert_ok(huf_memlen(mem, &mem_len));
+    assert_int_equal(mem_len, 6);
+
+    assert_int_equal(huf_bufio_commit(bufio, 9), HUF_ERROR_INVALID_ARGUMENT);
+
+    memcpy(window, bit_stream + 6, 4);
+    assert_ok(huf_bufio_commit(bufio, 4));
+    assert_ok(huf_bufio_read_writer_flush(bufio));
+
+    assert_ok(huf_memlen(mem, &mem_len));
+    assert_int_equal(mem_len, sizeof(bit_stream));
+    assert_memory_equal(buf, bit_stream, sizeof(bit_stream));
+
+    assert_ok(huf_bufio_read_writer_free(&bufio));
+    assert_ok(huf_memclose(&mem));
+    free(buf);
+}
+
+
+// Read at most 3 bytes of the memory stream at once, like a pipe.
+static huf_error_t
+short_read(void *stream, void *buf, size_t *count)
+{
+    huf_read_writer_t *mem = stream;
+
+    if (*count > 3) {
+        *count = 3;
+    }
+
+    return mem->read(mem->stream, buf, count);
+}
+
+
+static void
+test_bufio_short_reads(void **state)
+{
+    // The small buffer is bypassed by the request, and the large
+    // buffer is filled by several reads.
+    const size_t capacities[] = {2, 64};
+
+    for (size_t index = 0; index < 2; index++) {
+        void *buf = NULL;
+        huf_read_writer_t *mem = NULL;
+        huf_bufio_read_writer_t *bufio = NULL;
+
+        uint8_t bytes[sizeof(bit_stream)] = {0};
+
+        assert_ok(huf_memopen(&mem, &buf, sizeof(bit_stream)));
+        assert_ok(mem->write(mem->stream, bit_stream, sizeof(bit_stream)));
+
+        huf_read_writer_t reader = {.stream = mem, .read = short_read};
+        assert_ok(huf_bufio_read_writer_init(&bufio, &reader, capacities[index]));
+
+        assert_ok(huf_bufio_read(bufio, bytes, 7));
+        assert_ok(huf_bufio_read(bufio, bytes + 7, 3));
+        assert_memory_equal(bytes, bit_stream, sizeof(bit_stream));
+
+        // The reader is exhausted.
+        assert_int_equal(huf_bufio_read(bufio, bytes, 1), HUF_ERROR_READ_WRITE);
+
+        assert_ok(huf_bufio_read_writer_free(&bufio));
+        assert_ok(huf_memclose(&mem));
+        free(buf);
+    }
+}
+
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_bit_reader_memory),
+        cmocka_unit_test(test_bit_reader_attach),
+        cmocka_unit_test(test_bit_reader_unbuffered),
+        cmocka_unit_test(test_bufio_peek_consume),
+        cmocka_unit_test(test_bufio_reserve_commit),
+        cmocka_unit_test(test_bufio_short_reads),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
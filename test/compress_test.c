@@ -0,0 +1,533 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <cmocka.h>
+
+#include <huffman.h>
+#include "assert.h"
+#include "fill.h"
+
+
+#define TEST_COMPRESS_LEN 70001
+
+
+static void
+test_compress_decompress(void **state)
+{
+    static uint8_t buf[TEST_COMPRESS_LEN];
+    static uint8_t compressed[TEST_COMPRESS_LEN + HUF_COMPRESS_BLOCK_OVERHEAD];
+    static uint8_t decompressed[TEST_COMPRESS_LEN];
+
+    fill_buffer(buf, sizeof(buf), 42, 0x7);
+    assert_true(huf_compress_bound(sizeof(buf)) <= sizeof(compressed));
+
+    // Validate the buffers of different lengths, so the tail
+    // of the block is packed in different ways.
+    for (size_t len = 0; len < sizeof(buf); len = len * 3 + 1) {
+        size_t compressed_len = 0;
+        size_t decompressed_len = 0;
+
+        assert_ok(huf_compress(compressed, huf_compress_bound(len),
+                    buf, len, &compressed_len));
+        assert_true(compressed_len <= huf_compress_bound(len));
+
+        memset(decompressed, 0, sizeof(decompressed));
+        assert_ok(huf_decompress(decompressed, len,
+                    compressed, compressed_len, &decompressed_len));
+
+        assert_int_equal(decompressed_len, len);
+        assert_memory_equal(decompressed, buf, len);
+    }
+}
+
+
+// Validate that the input with all 256 symbols fits into the bound,
+// the uniform distribution yields the largest tree and 8-bit codes.
+static void
+test_compress_all_symbols(void **state)
+{
+    static uint8_t buf[1 << 16];
+    static uint8_t compressed[sizeof(buf) + HUF_COMPRESS_BLOCK_OVERHEAD];
+    static uint8_t decompressed[sizeof(buf)];
+
+    for (size_t index = 0; index < sizeof(buf); index++) {
+        buf[index] = index * 167;
+    }
+
+    for (size_t len = 256; len <= sizeof(buf); len *= 4) {
+        size_t compressed_len = 0;
+        size_t decompressed_len = 0;
+
+        assert_ok(huf_compress(compressed, huf_compress_bound(len),
+                    buf, len, &compressed_len));
+        assert_true(compressed_len <= huf_compress_bound(len));
+
+        assert_ok(huf_decompress(decompressed, len,
+                    compressed, compressed_len, &decompressed_len));
+
+        assert_int_equal(decompressed_len, len);
+        assert_memory_equal(decompressed, buf, len);
+    }
+}
+
+
+// Validate that the one-shot compression produces the same output
+// as the encoder, and the exact destination buffer is enough.
+static void
+test_compress_encode(void **state)
+{
+    static uint8_t buf[TEST_COMPRESS_LEN];
+    static uint8_t compressed[TEST_COMPRESS_LEN + HUF_COMPRESS_BLOCK_OVERHEAD];
+    static uint8_t decompressed[TEST_COMPRESS_LEN];
+
+    void *bufin, *bufout = NULL;
+    huf_read_writer_t *input, *output = NULL;
+
+    fill_buffer(buf, sizeof(buf), 42, 0x7);
+
+    assert_ok(huf_memopen(&input, &bufin, sizeof(buf)));
+    assert_ok(huf_memopen(&output, &bufout, sizeof(buf)));
+    assert_ok(input->write(input->stream, buf, sizeof(buf)));
+
+    huf_config_t config = {
+        .length = sizeof(buf),
+        .reader = input,
+        .writer = output,
+    };
+
+    assert_ok(huf_encode(&config));
+
+    size_t encoding_len = 0;
+    assert_ok(huf_memlen(output, &encoding_len));
+
+    size_t compressed_len = 0;
+    assert_ok(huf_compress(compressed, encoding_len, buf, sizeof(buf),
+                &compressed_len));
+
+    assert_int_equal(compressed_len, encoding_len);
+    assert_memory_equal(compressed, bufout, encoding_len);
+
+    // The output of the encoder is decompressed as well.
+    size_t decompressed_len = 0;
+    assert_ok(huf_decompress(decompressed, sizeof(decompressed),
+                bufout, encoding_len, &decompressed_len));
+
+    assert_int_equal(decompressed_len, sizeof(buf));
+    assert_memory_equal(decompressed, buf, sizeof(buf));
+
+    assert_ok(huf_memclose(&input));
+    assert_ok(huf_memclose(&output));
+
+    free(bufin);
+    free(bufout);
+}
+
+
+static void
+test_compress_overflow(void **state)
+{
+    uint8_t compressed[HUF_COMPRESS_BLOCK_OVERHEAD + 16];
+    uint8_t decompressed[16];
+
+    size_t compressed_len = 0;
+    size_t decompressed_len = 0;
+
+    assert_ok(huf_compress(compressed, sizeof(compressed),
+                "0123456789", 10, &compressed_len));
+
+    assert_int_equal(huf_compress(compressed, compressed_len - 1,
+                "0123456789", 10, &compressed_len), HUF_ERROR_BUFFER_OVERFLOW);
+
+    assert_ok(huf_compress(compressed, sizeof(compressed),
+                "0123456789", 10, &compressed_len));
+
+    assert_int_equal(huf_decompress(decompressed, 9,
+                compressed, compressed_len, &decompressed_len),
+            HUF_ERROR_BUFFER_OVERFLOW);
+
+    // Truncated header of the block.
+    assert_int_equal(huf_decompress(decompressed, sizeof(decompressed),
+                compressed, 9, &decompressed_len), HUF_ERROR_BLOCK_CORRUPTED);
+}
+
+
+// Validate that each output of the batch is decompressed independently,
+// and the shared table reduces the length of the outputs.
+static void
+test_encode_batch(void **state)
+{
+    static uint8_t buf[TEST_COMPRESS_LEN];
+    static uint8_t compressed[TEST_COMPRESS_LEN * 4];
+    static uint8_t shared[TEST_COMPRESS_LEN * 4];
+    uint8_t decompressed[4096];
+
+    huf_segment_t srcs[64];
+    huf_segment_t dsts[64];
+    huf_segment_t shared_dsts[64];
+    huf_segment_t table = {0};
+
+    size_t count = sizeof(srcs) / sizeof(*srcs);
+    size_t offset = 0;
+    size_t bound = HUF_COMPRESS_BLOCK_OVERHEAD;
+
+    fill_buffer(buf, sizeof(buf), 42, 0x7);
+
+    // Records of different lengths, including the empty one.
+    for (size_t index = 0; index < count; index++) {
+        srcs[index].base = buf + offset;
+        srcs[index].len = (index * 397) % 1024;
+
+        offset += srcs[index].len;
+        bound += huf_compress_bound(srcs[index].len);
+    }
+
+    // Record of the rare symbols, that is expanded by the shared table.
+    memcpy(buf + offset, "0123456789", 10);
+    srcs[count - 1].base = buf + offset;
+    srcs[count - 1].len = 10;
+
+    assert_true(bound <= sizeof(compressed));
+
+    assert_ok(huf_encode_batch(compressed, bound, srcs, dsts, count, NULL));
+    assert_ok(huf_encode_batch(shared, bound, srcs, shared_dsts, count, &table));
+
+    size_t total = 0;
+    size_t shared_total = table.len;
+
+    for (size_t index = 0; index < count; index++) {
+        size_t decompressed_len = 0;
+
+        assert_ok(huf_decompress(decompressed, sizeof(decompressed),
+                    dsts[index].base, dsts[index].len, &decompressed_len));
+
+        assert_int_equal(decompressed_len, srcs[index].len);
+        assert_memory_equal(decompressed, srcs[index].base, srcs[index].len);
+
+        assert_ok(huf_decompress_shared(decompressed, sizeof(decompressed),
+                    table.base, table.len, shared_dsts[index].base,
+                    shared_dsts[index].len, &decompressed_len));
+
+        assert_int_equal(decompressed_len, srcs[index].len);
+        assert_memory_equal(decompressed, srcs[index].base, srcs[index].len);
+
+        total += dsts[index].len;
+        shared_total += shared_dsts[index].len;
+    }
+
+    assert_true(shared_total < total);
+
+    // Expanded record carries its own tree.
+    int16_t tree_length = 0;
+    memcpy(&tree_length, (uint8_t*)shared_dsts[count - 1].base + sizeof(uint64_t),
+            sizeof(tree_length));
+    assert_true(tree_length > 0);
+
+    memcpy(&tree_length, (uint8_t*)shared_dsts[1].base + sizeof(uint64_t),
+            sizeof(tree_length));
+    assert_int_equal(tree_length, 0);
+}
+
+
+// Split the buffer into segments of irregular lengths, including
+// the empty ones. Returns the count of segments.
+static int
+split_buffer(struct iovec *iov, int iovcnt, uint8_t *buf, size_t len)
+{
+    size_t offset = 0;
+    int count = 0;
+
+    while (offset < len && count < iovcnt - 1) {
+        size_t segment = (count * 7919) % 613;
+        if (segment > len - offset) {
+            segment = len - offset;
+        }
+
+        iov[count].iov_base = buf + offset;
+        iov[count].iov_len = segment;
+
+        offset += segment;
+        count++;
+    }
+
+    iov[count].iov_base = buf + offset;
+    iov[count].iov_len = len - offset;
+
+    return count + 1;
+}
+
+
+// Validate that the data gathered from the segments is encoded the
+// same way as the contiguous buffer, and the segmented encoded data
+// is decoded into the segments.
+static void
+test_encodev_decodev(void **state)
+{
+    static uint8_t buf[TEST_COMPRESS_LEN];
+    static uint8_t compressed[TEST_COMPRESS_LEN + HUF_COMPRESS_BLOCK_OVERHEAD];
+    static uint8_t decompressed[TEST_COMPRESS_LEN];
+
+    struct iovec src[512];
+    struct iovec dst[512];
+
+    void *bufout = NULL;
+    huf_read_writer_t *output = NULL;
+
+    fill_buffer(buf, sizeof(buf), 42, 0x7);
+
+    size_t compressed_len = 0;
+    assert_ok(huf_compress(compressed, sizeof(compressed), buf, sizeof(buf),
+                &compressed_len));
+
+    assert_ok(huf_memopen(&output, &bufout, HUF_1KIB_BUFFER));
+
+    int srccnt = split_buffer(src, 512, buf, sizeof(buf));
+    assert_ok(huf_encodev(output, src, srccnt));
+
+    size_t encoding_len = 0;
+    assert_ok(huf_memlen(output, &encoding_len));
+
+    assert_int_equal(encoding_len, compressed_len);
+    assert_memory_equal(bufout, compressed, compressed_len);
+
+    srccnt = split_buffer(src, 512, compressed, compressed_len);
+    int dstcnt = split_buffer(dst, 512, decompressed, sizeof(decompressed));
+
+    size_t decompressed_len = 0;
+    assert_ok(huf_decodev(dst, dstcnt, src, srccnt, &decompressed_len));
+
+    assert_int_equal(decompressed_len, sizeof(buf));
+    assert_memory_equal(decompressed, buf, sizeof(buf));
+
+    // Output doesn't fit into the destination segment.
+    struct iovec short_dst = {decompressed, sizeof(decompressed) - 1};
+
+    assert_int_equal(huf_decodev(&short_dst, 1, src, srccnt, &decompressed_len),
+            HUF_ERROR_BUFFER_OVERFLOW);
+
+    assert_ok(huf_memclose(&output));
+    free(bufout);
+}
+
+
+// Validate that the vectored writes of the file descriptor write
+// the same data as the sequential writes.
+static void
+test_encodev_fd(void **state)
+{
+    static uint8_t buf[TEST_COMPRESS_LEN];
+    static uint8_t compressed[TEST_COMPRESS_LEN + HUF_COMPRESS_BLOCK_OVERHEAD];
+    static uint8_t written[TEST_COMPRESS_LEN + HUF_COMPRESS_BLOCK_OVERHEAD];
+
+    struct iovec src[512];
+    huf_read_writer_t *output = NULL;
+
+    fill_buffer(buf, sizeof(buf), 42, 0x7);
+
+    size_t compressed_len = 0;
+    assert_ok(huf_compress(compressed, sizeof(compressed), buf, sizeof(buf),
+                &compressed_len));
+
+    FILE *file = tmpfile();
+    assert_non_null(file);
+
+    assert_ok(huf_fdopen(&output, fileno(file)));
+    assert_non_null(output->writev);
+
+    int srccnt = split_buffer(src, 512, buf, sizeof(buf));
+    assert_ok(huf_encodev(output, src, srccnt));
+
+    rewind(file);
+    assert_int_equal(fread(written, 1, sizeof(written), file), compressed_len);
+    assert_memory_equal(written, compressed, compressed_len);
+
+    assert_ok(huf_fdclose(&output));
+    fclose(file);
+}
+
+
+// Validate that the blocks compressed by the threads are joined
+// in the same order as the blocks compressed one by one.
+static void
+test_compress_parallel(void **state)
+{
+    static uint8_t buf[TEST_COMPRESS_LEN];
+    static uint8_t expected[TEST_COMPRESS_LEN * 2];
+    static uint8_t compressed[TEST_COMPRESS_LEN * 2];
+    static uint8_t decompressed[TEST_COMPRESS_LEN];
+
+    const size_t blocksize = 8192;
+    const size_t threads[] = {0, 2, 3, 16};
+
+    size_t expected_len = 0, len = 0;
+
+    fill_buffer(buf, sizeof(buf), 42, 0x7);
+
+    for (size_t offset = 0; offset < sizeof(buf); offset += blocksize) {
+        size_t chunk = sizeof(buf) - offset;
+        if (chunk > blocksize) {
+            chunk = blocksize;
+        }
+
+        assert_ok(huf_compress(expected + expected_len, sizeof(expected) - expected_len,
+                    buf + offset, chunk, &len));
+        expected_len += len;
+    }
+
+    for (size_t index = 0; index < sizeof(threads) / sizeof(threads[0]); index++) {
+        memset(compressed, 0, sizeof(compressed));
+
+        assert_ok(huf_compress_parallel(compressed, sizeof(compressed), buf,
+                    sizeof(buf), blocksize, threads[index], &len));
+
+        assert_int_equal(len, expected_len);
+        assert_memory_equal(compressed, expected, expected_len);
+    }
+
+    assert_ok(huf_decompress(decompressed, sizeof(decompressed), compressed,
+                len, &len));
+    assert_memory_equal(decompressed, buf, sizeof(buf));
+
+    // Each block is compressed into its own part of the buffer.
+    size_t bound = huf_compress_parallel_bound(sizeof(buf), blocksize);
+    assert_true(bound <= sizeof(compressed));
+
+    assert_ok(huf_compress_parallel(compressed, bound, buf,
+                sizeof(buf), blocksize, 2, &len));
+    assert_int_equal(huf_compress_parallel(compressed, bound - 1, buf,
+                sizeof(buf), blocksize, 2, &len), HUF_ERROR_BUFFER_OVERFLOW);
+
+    assert_int_equal(huf_compress_parallel(compressed, sizeof(compressed), buf,
+                sizeof(buf), 0, 2, &len), HUF_ERROR_INVALID_ARGUMENT);
+}
+
+
+// Decompress the stream revealed to the decompressor only as much
+// as requested, and return the length of the decompressed data.
+static huf_error_t
+decompress_next_all(const uint8_t *src, size_t src_len, uint8_t *dst,
+        size_t *dst_len)
+{
+    huf_decompressor_t decompressor = {0};
+
+    size_t available = 0, offset = 0;
+    size_t dst_cap = 1;
+
+    *dst_len = 0;
+
+    for (;;) {
+        size_t written = 0, read = 0;
+
+        huf_error_t err = huf_decompress_next(&decompressor, dst + *dst_len,
+                dst_cap, src + offset, available - offset,
+                available == src_len, &written, &read);
+        if (err != HUF_ERROR_SUCCESS) {
+            return err;
+        }
+
+        if (written || read) {
+            *dst_len += written;
+            offset += read;
+            continue;
+        }
+
+        if (decompressor.dst_need) {
+            assert_true(decompressor.dst_need > dst_cap);
+            dst_cap = decompressor.dst_need;
+        } else if (decompressor.src_need) {
+            assert_true(decompressor.src_need > available - offset);
+            available = offset + decompressor.src_need;
+            if (available > src_len) {
+                available = src_len;
+            }
+        } else {
+            return HUF_ERROR_SUCCESS;
+        }
+    }
+}
+
+
+// Validate that the blocks, frames and skippable frames are
+// decompressed incrementally from the partial source buffers.
+static void
+test_decompress_next(void **state)
+{
+    static uint8_t buf[TEST_COMPRESS_LEN];
+    static uint8_t stream[TEST_COMPRESS_LEN * 2];
+    static uint8_t decompressed[TEST_COMPRESS_LEN];
+
+    const size_t blocksize = 16384;
+    const uint64_t end = HUF_FRAME_END;
+
+    size_t stream_len = 0, len = 0;
+
+    fill_buffer(buf, sizeof(buf), 42, 0x7);
+
+    // The frame of the blocks of the first half of the buffer.
+    huf_frame_t frame = {.version = HUF_FRAME_VERSION,
+        .flags = HUF_FRAME_CONTENT_SIZE, .size = sizeof(buf) / 2};
+
+    len = sizeof(stream);
+    assert_ok(huf_frame_write(&frame, stream, &len));
+    stream_len += len;
+
+    for (size_t offset = 0; offset < sizeof(buf) / 2; offset += blocksize) {
+        size_t chunk = sizeof(buf) / 2 - offset;
+        if (chunk > blocksize) {
+            chunk = blocksize;
+        }
+
+        assert_ok(huf_compress(stream + stream_len, sizeof(stream) - stream_len,
+                    buf + offset, chunk, &len));
+        stream_len += len;
+    }
+
+    memcpy(stream + stream_len, &end, sizeof(end));
+    stream_len += sizeof(end);
+
+    // The skippable frame followed by the block without the frame.
+    frame.flags = HUF_FRAME_SKIPPABLE;
+    frame.size = 5;
+
+    len = sizeof(stream) - stream_len;
+    assert_ok(huf_frame_write(&frame, stream + stream_len, &len));
+    stream_len += len + frame.size;
+
+    assert_ok(huf_compress(stream + stream_len, sizeof(stream) - stream_len,
+                buf + sizeof(buf) / 2, sizeof(buf) - sizeof(buf) / 2, &len));
+    stream_len += len;
+
+    assert_ok(decompress_next_all(stream, stream_len, decompressed, &len));
+    assert_int_equal(len, sizeof(buf));
+    assert_memory_equal(decompressed, buf, sizeof(buf));
+
+    // The stream ends in the middle of the block.
+    assert_int_equal(decompress_next_all(stream, stream_len - 1,
+                decompressed, &len), HUF_ERROR_READ_WRITE);
+
+    // The stream ends in the middle of the frame.
+    assert_int_equal(decompress_next_all(stream, 100, decompressed, &len),
+            HUF_ERROR_BLOCK_CORRUPTED);
+}
+
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_compress_decompress),
+        cmocka_unit_test(test_compress_all_symbols),
+        cmocka_unit_test(test_compress_encode),
+        cmocka_unit_test(test_compress_overflow),
+        cmocka_unit_test(test_compress_parallel),
+        cmocka_unit_test(test_decompress_next),
+        cmocka_unit_test(test_encode_batch),
+        cmocka_unit_test(test_encodev_decodev),
+        cmocka_unit_test(test_encodev_fd),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
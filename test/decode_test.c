@@ -81,10 +81,56 @@ test_decoder_corrupted(void **state)
 }
 
 
+// Validate that the length of the interleaved block is checked against
+// the length of the streams before the memory is reserved for symbols.
+static void
+test_decoder_streams_length(void **state)
+{
+    void *bufin, *bufout = NULL;
+    huf_read_writer_t *input, *output = NULL;
+
+    assert_ok(huf_memopen(&input, &bufin, 128));
+    assert_ok(huf_memopen(&output, &bufout, 128));
+
+    huf_config_t config = {
+        .length = 16,
+        .streams = HUF_INTERLEAVED_STREAMS,
+        .reader = input,
+        .writer = output,
+    };
+
+    assert_ok(input->write(input->stream, "interleaved data", 16));
+    assert_ok(huf_encode(&config));
+
+    size_t encoding_len = 0;
+    assert_ok(huf_memlen(output, &encoding_len));
+
+    // Replace the length of the block with the one, that can't be
+    // encoded into the streams of the block.
+    const uint64_t len = (uint64_t)1 << 40;
+    memcpy(bufout, &len, sizeof(len));
+
+    assert_ok(huf_memrewind(input));
+
+    config.reader = output;
+    config.writer = input;
+    config.length = encoding_len;
+
+    assert_int_equal(huf_decode(&config), HUF_ERROR_BLOCK_CORRUPTED);
+
+    assert_ok(huf_memclose(&input));
+    assert_ok(huf_memclose(&output));
+
+    free(bufin);
+    free(bufout);
+}
+
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_decoder_corrupted),
+        cmocka_unit_test(test_decoder_streams_length),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
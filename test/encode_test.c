@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdarg.h>
 #include <stddef.h>
 #include <setjmp.h>
@@ -5,6 +7,7 @@
 #include <cmocka.h>
 
 #include <huffman.h>
+#include "allocator.h"
 #include "assert.h"
 #include <stdio.h>
 
@@ -94,11 +97,284 @@ test_encode_decode(void **state)
 }
 
 
+static void
+test_encode_decode_streams(void **state)
+{
+    void *bufin, *bufout = NULL;
+
+    huf_read_writer_t *input = NULL;
+    huf_read_writer_t *output = NULL;
+
+    // Use the lengths that are not divisible by count of streams, so
+    // the last stream of each block is shorter than the others.
+    const size_t lengths[] = {1, 2, 3, 1000};
+
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(*lengths); i++) {
+        uint8_t data[1000] = {0};
+        uint8_t result[1000] = {0};
+        size_t result_len = sizeof(result);
+
+        for (size_t j = 0; j < lengths[i]; j++) {
+            data[j] = "interleaved streams"[j % 19];
+        }
+
+        assert_ok(huf_memopen(&input, &bufin, 128));
+        assert_ok(huf_memopen(&output, &bufout, 128));
+
+        huf_config_t config = {
+            .length = lengths[i],
+            .blocksize = 333,
+            .reader_buffer_size = 128,
+            .writer_buffer_size = 128,
+            .streams = HUF_INTERLEAVED_STREAMS,
+            .reader = input,
+            .writer = output,
+        };
+
+        assert_ok(input->write(input->stream, data, lengths[i]));
+        assert_ok(huf_encode(&config));
+
+        size_t encoding_len = 0;
+        assert_ok(huf_memlen(output, &encoding_len));
+
+        config.reader = output;
+        config.writer = input;
+        config.length = encoding_len;
+
+        assert_ok(huf_memrewind(input));
+        assert_ok(huf_decode(&config));
+
+        assert_ok(input->read(input->stream, result, &result_len));
+        assert_int_equal(result_len, lengths[i]);
+        assert_memory_equal(result, data, lengths[i]);
+
+        assert_ok(huf_memclose(&input));
+        assert_ok(huf_memclose(&output));
+
+        free(bufin);
+        free(bufout);
+    }
+}
+
+
+static void
+test_encode_decode_mmap(void **state)
+{
+    huf_read_writer_t *input = NULL;
+    huf_read_writer_t *output = NULL;
+
+    uint8_t data[3000] = {0};
+    uint8_t result[3000] = {0};
+
+    for (size_t j = 0; j < sizeof(data); j++) {
+        data[j] = "memory-mapped file"[j % 18];
+    }
+
+    FILE *data_file = tmpfile();
+    FILE *encoded_file = tmpfile();
+    FILE *decoded_file = tmpfile();
+
+    assert_int_equal(fwrite(data, 1, sizeof(data), data_file), sizeof(data));
+    assert_int_equal(fflush(data_file), 0);
+    rewind(data_file);
+
+    assert_ok(huf_mmapopen(&input, fileno(data_file), HUF_IO_READ));
+    assert_ok(huf_mmapopen(&output, fileno(encoded_file), HUF_IO_WRITE));
+
+    // The mapped input is encoded without the reader buffer.
+    huf_config_t config = {
+        .length = sizeof(data),
+        .blocksize = 1024,
+        .writer_buffer_size = 128,
+        .reader = input,
+        .writer = output,
+    };
+
+    assert_ok(huf_encode(&config));
+    assert_ok(huf_mmapclose(&input));
+    assert_ok(huf_mmapclose(&output));
+
+    long encoding_len = ftell(encoded_file);
+    assert_true(encoding_len > 0);
+    rewind(encoded_file);
+
+    assert_ok(huf_mmapopen(&input, fileno(encoded_file), HUF_IO_READ));
+    assert_ok(huf_fdopen(&output, fileno(decoded_file)));
+
+    config.length = encoding_len;
+    config.reader = input;
+    config.writer = output;
+
+    assert_ok(huf_decode(&config));
+    assert_ok(huf_mmapclose(&input));
+    assert_ok(huf_fdclose(&output));
+
+    rewind(decoded_file);
+    assert_int_equal(fread(result, 1, sizeof(result), decoded_file), sizeof(result));
+    assert_memory_equal(result, data, sizeof(data));
+
+    fclose(data_file);
+    fclose(encoded_file);
+    fclose(decoded_file);
+}
+
+
+static void
+test_encode_pipeline(void **state)
+{
+    void *bufin, *bufout, *bufpiped = NULL;
+
+    huf_read_writer_t *input = NULL;
+    huf_read_writer_t *output = NULL;
+    huf_read_writer_t *piped = NULL;
+
+    uint8_t data[5000] = {0};
+    uint8_t result[5000] = {0};
+    size_t result_len = sizeof(result);
+
+    for (size_t j = 0; j < sizeof(data); j++) {
+        data[j] = "pipelined encoder"[j % 17] + j % 7;
+    }
+
+    assert_ok(huf_memopen(&input, &bufin, 128));
+    assert_ok(huf_memopen(&output, &bufout, 128));
+    assert_ok(huf_memopen(&piped, &bufpiped, 128));
+    assert_ok(input->write(input->stream, data, sizeof(data)));
+
+    huf_config_t config = {
+        .length = sizeof(data),
+        .blocksize = 700,
+        .reader_buffer_size = 128,
+        .writer_buffer_size = 128,
+        .reader = input,
+        .writer = output,
+    };
+
+    assert_ok(huf_encode(&config));
+
+    // The pipelined encoder produces the same output as
+    // the sequential one.
+    assert_ok(huf_memrewind(input));
+    assert_ok(input->write(input->stream, data, sizeof(data)));
+
+    config.pipeline_depth = 3;
+    config.writer = piped;
+
+    assert_ok(huf_encode(&config));
+
+    size_t encoding_len = 0, piped_len = 0;
+    assert_ok(huf_memlen(output, &encoding_len));
+    assert_ok(huf_memlen(piped, &piped_len));
+
+    assert_int_equal(piped_len, encoding_len);
+    assert_memory_equal(bufpiped, bufout, encoding_len);
+
+    config.reader = piped;
+    config.writer = input;
+    config.length = piped_len;
+
+    assert_ok(huf_memrewind(input));
+    assert_ok(huf_decode(&config));
+
+    assert_ok(input->read(input->stream, result, &result_len));
+    assert_int_equal(result_len, sizeof(data));
+    assert_memory_equal(result, data, sizeof(data));
+
+    assert_ok(huf_memclose(&input));
+    assert_ok(huf_memclose(&output));
+    assert_ok(huf_memclose(&piped));
+
+    free(bufin);
+    free(bufout);
+    free(bufpiped);
+}
+
+
+static void
+test_encode_decode_allocator(void **state)
+{
+    void *bufin, *bufout = NULL;
+
+    huf_read_writer_t *input = NULL;
+    huf_read_writer_t *output = NULL;
+
+    uint8_t data[2000] = {0};
+    uint8_t result[2000] = {0};
+    size_t result_len = sizeof(result);
+
+    for (size_t j = 0; j < sizeof(data); j++) {
+        data[j] = "custom allocator"[j % 16];
+    }
+
+    counting_allocator_t counter = {0};
+
+    assert_ok(huf_memopen(&input, &bufin, sizeof(data)));
+    assert_ok(huf_memopen(&output, &bufout, sizeof(data)));
+    assert_ok(input->write(input->stream, data, sizeof(data)));
+
+    huf_config_t config = {
+        .length = sizeof(data),
+        .blocksize = 300,
+        .reader_buffer_size = 64,
+        .writer_buffer_size = 64,
+        .pipeline_depth = 2,
+        .reader = input,
+        .writer = output,
+        .allocator = counting_allocator(&counter),
+    };
+
+    assert_ok(huf_encode(&config));
+    assert_true(counter.allocations > 0);
+    assert_int_equal(counter.releases, counter.allocations);
+
+    size_t encoding_len = 0;
+    assert_ok(huf_memlen(output, &encoding_len));
+
+    config.reader = output;
+    config.writer = input;
+    config.length = encoding_len;
+    counter.allocations = counter.releases = 0;
+
+    assert_ok(huf_memrewind(input));
+    assert_ok(huf_decode(&config));
+    assert_true(counter.allocations > 0);
+    assert_int_equal(counter.releases, counter.allocations);
+
+    assert_ok(input->read(input->stream, result, &result_len));
+    assert_int_equal(result_len, sizeof(data));
+    assert_memory_equal(result, data, sizeof(data));
+
+    assert_ok(huf_memclose(&input));
+    assert_ok(huf_memclose(&output));
+
+    free(bufin);
+    free(bufout);
+}
+
+
+static void
+test_encode_streams_invalid(void **state)
+{
+    huf_config_t config = {
+        .length = 1,
+        .streams = 3,
+    };
+
+    assert_int_equal(huf_encode(&config), HUF_ERROR_INVALID_ARGUMENT);
+    assert_int_equal(huf_decode(&config), HUF_ERROR_INVALID_ARGUMENT);
+}
+
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_encode_nobuffer),
         cmocka_unit_test(test_encode_decode),
+        cmocka_unit_test(test_encode_decode_streams),
+        cmocka_unit_test(test_encode_decode_mmap),
+        cmocka_unit_test(test_encode_pipeline),
+        cmocka_unit_test(test_encode_decode_allocator),
+        cmocka_unit_test(test_encode_streams_invalid),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
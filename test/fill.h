@@ -0,0 +1,24 @@
+#ifndef INCLUDE_huffman_fill_h__
+#define INCLUDE_huffman_fill_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Fill the buffer with skewed pseudo-random bytes. Three quarters of
+// the bytes are reduced with the mask, and the rest are spread over the
+// whole alphabet, so the longer buffers use all 256 symbols, and the
+// codes of the rare symbols are longer than the decoding table prefix.
+static inline void
+fill_buffer(uint8_t *buf, size_t len, uint32_t seed, uint8_t mask)
+{
+    for (size_t index = 0; index < len; index++) {
+        seed = seed * 1103515245 + 12345;
+
+        uint8_t byte = (seed >> 16) & 0xff;
+        buf[index] = byte < 192 ? byte & mask : seed >> 24;
+    }
+}
+
+
+#endif // INCLUDE_huffman_fill_h__
@@ -0,0 +1,332 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <huffman.h>
+#include "assert.h"
+#include "fill.h"
+
+
+#define TEST_FRAME_LEN 70001
+
+
+// Encode the buffer with the specified configuration and append
+// the encoded data to the output.
+static void
+encode_buffer(huf_config_t config, const uint8_t *buf, size_t len,
+        uint8_t *out, size_t *out_len)
+{
+    void *bufin, *bufout = NULL;
+    huf_read_writer_t *input, *output = NULL;
+
+    assert_ok(huf_memopen(&input, &bufin, HUF_1KIB_BUFFER));
+    assert_ok(huf_memopen(&output, &bufout, HUF_1KIB_BUFFER));
+    assert_ok(input->write(input->stream, buf, len));
+
+    config.length = len;
+    config.reader = input;
+    config.writer = output;
+
+    assert_ok(huf_encode(&config));
+
+    size_t encoding_len = 0;
+    assert_ok(huf_memlen(output, &encoding_len));
+
+    memcpy(out + *out_len, bufout, encoding_len);
+    *out_len += encoding_len;
+
+    assert_ok(huf_memclose(&input));
+    assert_ok(huf_memclose(&output));
+
+    free(bufin);
+    free(bufout);
+}
+
+
+// Decode the buffer with the specified configuration, the length
+// of the input is not passed to the decoder.
+static huf_error_t
+decode_buffer(huf_config_t config, const uint8_t *buf, size_t len,
+        uint8_t *out, size_t *out_len)
+{
+    void *bufin, *bufout = NULL;
+    huf_read_writer_t *input, *output = NULL;
+
+    assert_ok(huf_memopen(&input, &bufin, HUF_1KIB_BUFFER));
+    assert_ok(huf_memopen(&output, &bufout, HUF_1KIB_BUFFER));
+    assert_ok(input->write(input->stream, buf, len));
+
+    config.reader = input;
+    config.writer = output;
+
+    huf_error_t err = huf_decode(&config);
+
+    assert_ok(huf_memlen(output, out_len));
+    memcpy(out, bufout, *out_len);
+
+    assert_ok(huf_memclose(&input));
+    assert_ok(huf_memclose(&output));
+
+    free(bufin);
+    free(bufout);
+
+    return err;
+}
+
+
+static void
+test_frame_read_write(void **state)
+{
+    uint8_t buf[HUF_FRAME_HEADER_LEN];
+    size_t len = sizeof(buf);
+
+    huf_frame_t frame = {
+        .version = HUF_FRAME_VERSION,
+        .flags = HUF_FRAME_CONTENT_SIZE | HUF_FRAME_INTERLEAVED,
+        .size = 123456789,
+    };
+    huf_frame_t parsed = {0};
+
+    assert_ok(huf_frame_write(&frame, buf, &len));
+    assert_int_equal(len, HUF_FRAME_HEADER_LEN);
+    assert_memory_equal(buf, HUF_FRAME_MAGIC, HUF_FRAME_MAGIC_LEN);
+
+    assert_ok(huf_frame_read(&parsed, buf, &len));
+    assert_int_equal(len, HUF_FRAME_HEADER_LEN);
+    assert_int_equal(parsed.version, frame.version);
+    assert_int_equal(parsed.flags, frame.flags);
+    assert_int_equal(parsed.size, frame.size);
+
+    // Header without the size.
+    frame.flags = 0;
+    len = sizeof(buf);
+
+    assert_ok(huf_frame_write(&frame, buf, &len));
+    assert_int_equal(len, HUF_FRAME_MAGIC_LEN + 2);
+
+    // Signature read as the length of the block is never valid.
+    uint64_t blocksize = 0;
+    memcpy(&blocksize, buf, sizeof(blocksize));
+    assert_true(blocksize > ((uint64_t)1 << 56));
+
+    len = HUF_FRAME_MAGIC_LEN + 1;
+    assert_int_equal(huf_frame_read(&parsed, buf, &len), HUF_ERROR_BLOCK_CORRUPTED);
+
+    len = sizeof(buf);
+    frame.flags = HUF_FRAME_SKIPPABLE | HUF_FRAME_CONTENT_SIZE;
+    assert_int_equal(huf_frame_write(&frame, buf, &len), HUF_ERROR_INVALID_ARGUMENT);
+
+    len = HUF_FRAME_MAGIC_LEN;
+    frame.flags = 0;
+    assert_int_equal(huf_frame_write(&frame, buf, &len), HUF_ERROR_BUFFER_OVERFLOW);
+
+    // Unknown version of the frame.
+    len = sizeof(buf);
+    frame.version = HUF_FRAME_VERSION + 1;
+    assert_ok(huf_frame_write(&frame, buf, &len));
+    assert_int_equal(huf_frame_read(&parsed, buf, &len), HUF_ERROR_FRAME_UNSUPPORTED);
+
+    len = sizeof(buf);
+    assert_int_equal(huf_frame_read(&parsed, "0123456789", &len),
+            HUF_ERROR_INVALID_ARGUMENT);
+}
+
+
+// Validate that the frames are decoded without the length of
+// the input, with either layout of the blocks.
+static void
+test_frame_encode_decode(void **state)
+{
+    static uint8_t buf[TEST_FRAME_LEN];
+    static uint8_t encoded[TEST_FRAME_LEN * 2];
+    static uint8_t decoded[TEST_FRAME_LEN];
+
+    const size_t streams[] = {0, HUF_INTERLEAVED_STREAMS};
+    const size_t depths[] = {0, 2};
+    const size_t buffer_sizes[] = {0, HUF_1KIB_BUFFER, HUF_64KIB_BUFFER};
+
+    fill_buffer(buf, sizeof(buf), 7, 0xf);
+
+    for (size_t index = 0; index < 4; index++) {
+        huf_config_t config = {
+            .blocksize = 4096,
+            .streams = streams[index % 2],
+            .pipeline_depth = depths[index / 2],
+            .frame = 1,
+        };
+
+        size_t encoded_len = 0;
+        encode_buffer(config, buf, sizeof(buf), encoded, &encoded_len);
+
+        huf_frame_t frame;
+        size_t header_len = encoded_len;
+
+        assert_ok(huf_frame_read(&frame, encoded, &header_len));
+        assert_int_equal(frame.size, sizeof(buf));
+        assert_int_equal(frame.flags & HUF_FRAME_INTERLEAVED, config.streams ?
+                HUF_FRAME_INTERLEAVED : 0);
+
+        // The layout of the blocks is taken from the frame.
+        for (size_t pos = 0; pos < 3; pos++) {
+            huf_config_t decoder_config = {
+                .reader_buffer_size = buffer_sizes[pos],
+                .writer_buffer_size = buffer_sizes[pos],
+            };
+
+            size_t decoded_len = 0;
+            assert_ok(decode_buffer(decoder_config, encoded, encoded_len,
+                        decoded, &decoded_len));
+
+            assert_int_equal(decoded_len, sizeof(buf));
+            assert_memory_equal(decoded, buf, sizeof(buf));
+        }
+
+        if (config.streams) {
+            continue;
+        }
+
+        size_t decoded_len = 0;
+        assert_ok(huf_decompress(decoded, sizeof(decoded), encoded, encoded_len,
+                    &decoded_len));
+
+        assert_int_equal(decoded_len, sizeof(buf));
+        assert_memory_equal(decoded, buf, sizeof(buf));
+
+        // Destination is validated before the decompression.
+        assert_int_equal(huf_decompress(decoded, sizeof(buf) - 1, encoded,
+                    encoded_len, &decoded_len), HUF_ERROR_BUFFER_OVERFLOW);
+    }
+}
+
+
+// Validate that the concatenated frames and blocks without the
+// frame are decoded, and the skippable frames are skipped.
+static void
+test_frame_concatenated(void **state)
+{
+    static uint8_t buf[TEST_FRAME_LEN];
+    static uint8_t encoded[TEST_FRAME_LEN * 4];
+    static uint8_t decoded[TEST_FRAME_LEN * 3];
+
+    uint8_t header[HUF_FRAME_HEADER_LEN];
+    size_t header_len = sizeof(header);
+
+    huf_config_t config = {.blocksize = 10000};
+    huf_config_t frame_config = {.blocksize = 10000, .frame = 1};
+
+    fill_buffer(buf, sizeof(buf), 7, 0xf);
+
+    size_t encoded_len = 0;
+    encode_buffer(frame_config, buf, 1000, encoded, &encoded_len);
+    encode_buffer(config, buf + 1000, 30000, encoded, &encoded_len);
+
+    // Skippable frame of the user data.
+    huf_frame_t frame = {
+        .version = HUF_FRAME_VERSION,
+        .flags = HUF_FRAME_SKIPPABLE,
+        .size = 5000,
+    };
+
+    assert_ok(huf_frame_write(&frame, header, &header_len));
+
+    memcpy(encoded + encoded_len, header, header_len);
+    memset(encoded + encoded_len + header_len, 0xff, frame.size);
+    encoded_len += header_len + frame.size;
+
+    encode_buffer(frame_config, buf + 31000, 0, encoded, &encoded_len);
+    encode_buffer(frame_config, buf + 31000, sizeof(buf) - 31000,
+            encoded, &encoded_len);
+
+    const size_t buffer_sizes[] = {0, HUF_1KIB_BUFFER};
+
+    for (size_t pos = 0; pos < 2; pos++) {
+        huf_config_t decoder_config = {
+            .reader_buffer_size = buffer_sizes[pos],
+            .writer_buffer_size = buffer_sizes[pos],
+        };
+
+        size_t decoded_len = 0;
+        assert_ok(decode_buffer(decoder_config, encoded, encoded_len,
+                    decoded, &decoded_len));
+
+        assert_int_equal(decoded_len, sizeof(buf));
+        assert_memory_equal(decoded, buf, sizeof(buf));
+
+        // The length of the input is still respected.
+        decoder_config.length = encoded_len;
+
+        assert_ok(decode_buffer(decoder_config, encoded, encoded_len,
+                    decoded, &decoded_len));
+        assert_int_equal(decoded_len, sizeof(buf));
+    }
+
+    size_t decoded_len = 0;
+    assert_ok(huf_decompress(decoded, sizeof(decoded), encoded, encoded_len,
+                &decoded_len));
+
+    assert_int_equal(decoded_len, sizeof(buf));
+    assert_memory_equal(decoded, buf, sizeof(buf));
+}
+
+
+static void
+test_frame_corrupted(void **state)
+{
+    static uint8_t buf[TEST_FRAME_LEN];
+    static uint8_t encoded[TEST_FRAME_LEN * 2];
+    static uint8_t decoded[TEST_FRAME_LEN];
+
+    huf_config_t config = {.blocksize = 4096, .frame = 1};
+    huf_config_t decoder_config = {0};
+
+    fill_buffer(buf, sizeof(buf), 7, 0xf);
+
+    size_t encoded_len = 0;
+    size_t decoded_len = 0;
+
+    encode_buffer(config, buf, sizeof(buf), encoded, &encoded_len);
+
+    // The end marker is missing.
+    assert_int_equal(decode_buffer(decoder_config, encoded, encoded_len - 1,
+                decoded, &decoded_len), HUF_ERROR_READ_WRITE);
+
+    assert_int_equal(huf_decompress(decoded, sizeof(decoded), encoded,
+                encoded_len - 1, &decoded_len), HUF_ERROR_BLOCK_CORRUPTED);
+
+    // The content size does not match the decoded data.
+    uint64_t size = sizeof(buf) + 1;
+    memcpy(encoded + HUF_FRAME_MAGIC_LEN + 2, &size, sizeof(size));
+
+    assert_int_equal(decode_buffer(decoder_config, encoded, encoded_len,
+                decoded, &decoded_len), HUF_ERROR_BLOCK_CORRUPTED);
+
+    size = sizeof(buf) - 1;
+    memcpy(encoded + HUF_FRAME_MAGIC_LEN + 2, &size, sizeof(size));
+
+    assert_int_equal(decode_buffer(decoder_config, encoded, encoded_len,
+                decoded, &decoded_len), HUF_ERROR_BLOCK_CORRUPTED);
+
+    assert_int_equal(huf_decompress(decoded, sizeof(decoded), encoded,
+                encoded_len, &decoded_len), HUF_ERROR_BLOCK_CORRUPTED);
+
+    // Unknown version of the frame.
+    encoded[HUF_FRAME_MAGIC_LEN] = HUF_FRAME_VERSION + 1;
+
+    assert_int_equal(decode_buffer(decoder_config, encoded, encoded_len,
+                decoded, &decoded_len), HUF_ERROR_FRAME_UNSUPPORTED);
+}
+
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_frame_read_write),
+        cmocka_unit_test(test_frame_encode_decode),
+        cmocka_unit_test(test_frame_concatenated),
+        cmocka_unit_test(test_frame_corrupted),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -1,7 +1,11 @@
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdarg.h>
 #include <stddef.h>
 #include <setjmp.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <cmocka.h>
 
 #include <huffman/io.h>
@@ -66,6 +70,33 @@ test_membuf_realloc(void **state)
 }
 
 
+static void
+test_membuf_realloc_large(void **state)
+{
+    void *buf = NULL;
+    size_t cap = 0;
+    huf_read_writer_t *mem = NULL;
+
+    uint8_t data[32] = {0};
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+
+    assert_ok(huf_memopen(&mem, &buf, 16));
+    assert_ok(mem->write(mem->stream, data, 15));
+
+    // Doubled capacity does not fit the written data, when the
+    // length of the written data is less than a new portion.
+    assert_ok(mem->write(mem->stream, data + 15, 17));
+    assert_ok(huf_memcap(mem, &cap));
+    assert_true(cap >= sizeof(data));
+    assert_memory_equal(buf, data, sizeof(data));
+
+    assert_ok(huf_memclose(&mem));
+    free(buf);
+}
+
+
 static void
 test_membuf_read(void **state)
 {
@@ -94,12 +125,183 @@ test_membuf_read(void **state)
 }
 
 
+static void
+test_segments_read_write(void **state)
+{
+    huf_read_writer_t *seg = NULL;
+    const huf_segment_t *segments = NULL;
+    size_t count = 0, len = 0;
+
+    assert_ok(huf_segopen(&seg, 4, NULL));
+    assert_ok(seg->write(seg->stream, "abcdefghij", 10));
+
+    // Segments are filled one after another.
+    assert_ok(huf_segments(seg, &segments, &count));
+    assert_int_equal(count, 3);
+    assert_int_equal(segments[0].len, 4);
+    assert_int_equal(segments[2].len, 2);
+    assert_memory_equal(segments[1].base, "efgh", 4);
+
+    void *base = segments[0].base;
+
+    char dest[16] = {0};
+    size_t destsz = 3;
+
+    assert_ok(seg->read(seg->stream, dest, &destsz));
+    assert_int_equal(destsz, 3);
+
+    destsz = sizeof(dest);
+    assert_ok(seg->read(seg->stream, dest + 3, &destsz));
+    assert_int_equal(destsz, 7);
+    assert_memory_equal(dest, "abcdefghij", 10);
+
+    // Read the same data again after the rewind.
+    assert_ok(huf_segrewind(seg));
+
+    destsz = sizeof(dest);
+    assert_ok(seg->read(seg->stream, dest, &destsz));
+    assert_int_equal(destsz, 10);
+
+    // Truncated data is overwritten without allocation of segments.
+    assert_int_equal(huf_segtruncate(seg, 11), HUF_ERROR_INVALID_ARGUMENT);
+    assert_ok(huf_segtruncate(seg, 5));
+    assert_ok(seg->write(seg->stream, "xyz", 3));
+
+    assert_ok(huf_seglen(seg, &len));
+    assert_int_equal(len, 8);
+
+    assert_ok(huf_segments(seg, &segments, &count));
+    assert_int_equal(count, 2);
+    assert_ptr_equal(segments[0].base, base);
+    assert_memory_equal(segments[1].base, "exyz", 4);
+
+    assert_ok(huf_segclose(&seg));
+    assert_null(seg);
+}
+
+
+static void
+test_mmap_read_write(void **state)
+{
+    huf_read_writer_t *mm = NULL;
+
+    FILE *file = tmpfile();
+    assert_non_null(file);
+
+    int fd = fileno(file);
+
+    assert_ok(huf_mmapopen(&mm, fd, HUF_IO_WRITE));
+    assert_null(mm->map);
+    assert_ok(mm->write(mm->stream, "mmap test", 9));
+    assert_ok(mm->write(mm->stream, " mmap test", 10));
+    assert_ok(huf_mmapclose(&mm));
+    assert_null(mm);
+
+    // The file is truncated to the written data.
+    assert_int_equal(lseek(fd, 0, SEEK_END), 19);
+
+    // Start reading from the current position of the file.
+    assert_int_equal(lseek(fd, 5, SEEK_SET), 5);
+    assert_ok(huf_mmapopen(&mm, fd, HUF_IO_READ));
+    assert_non_null(mm->map);
+
+    char dest[8] = {0};
+    size_t destsz = 4;
+
+    assert_ok(mm->read(mm->stream, dest, &destsz));
+    assert_int_equal(destsz, 4);
+    assert_memory_equal(dest, "test", 4);
+
+    // The rest of the file is available without copying.
+    const void *window = NULL;
+    size_t window_len = 0;
+
+    assert_ok(mm->map(mm->stream, &window, &window_len));
+    assert_int_equal(window_len, 10);
+    assert_memory_equal(window, " mmap test", 10);
+
+    destsz = sizeof(dest);
+    assert_ok(mm->read(mm->stream, dest, &destsz));
+    assert_int_equal(destsz, 0);
+
+    assert_ok(huf_mmapclose(&mm));
+    assert_int_equal(lseek(fd, 0, SEEK_CUR), 19);
+
+    fclose(file);
+}
+
+
+static void
+test_uring_read_write(void **state)
+{
+    huf_read_writer_t *uring = NULL;
+
+    // Use the length larger than all buffers of the ring.
+    const size_t len = 600000;
+    uint8_t *data = malloc(len);
+    uint8_t *result = malloc(len);
+
+    assert_non_null(data);
+    assert_non_null(result);
+
+    for (size_t index = 0; index < len; index++) {
+        data[index] = index * 7 + index / 251;
+    }
+
+    FILE *file = tmpfile();
+    assert_non_null(file);
+
+    int fd = fileno(file);
+
+    // Write the data by chunks, that are not aligned to the buffers.
+    assert_ok(huf_uringopen(&uring, fd, HUF_IO_WRITE));
+    for (size_t offset = 0; offset < len; offset += 9973) {
+        size_t count = len - offset < 9973 ? len - offset : 9973;
+        assert_ok(uring->write(uring->stream, data + offset, count));
+    }
+
+    assert_int_equal(uring->read(uring->stream, result, &(size_t){1}),
+            HUF_ERROR_READ_WRITE);
+
+    assert_ok(huf_uringclose(&uring));
+    assert_null(uring);
+    assert_int_equal(lseek(fd, 0, SEEK_CUR), len);
+
+    // Start reading from the current position of the file.
+    assert_int_equal(lseek(fd, 3, SEEK_SET), 3);
+    assert_ok(huf_uringopen(&uring, fd, HUF_IO_READ));
+
+    size_t have_read = 3;
+    size_t count = 0;
+
+    do {
+        count = 70001;
+        assert_ok(uring->read(uring->stream, result + have_read, &count));
+        have_read += count;
+    } while (count > 0);
+
+    assert_int_equal(have_read, len);
+    assert_memory_equal(result + 3, data + 3, len - 3);
+
+    assert_ok(huf_uringclose(&uring));
+    assert_int_equal(lseek(fd, 0, SEEK_CUR), len);
+
+    fclose(file);
+    free(data);
+    free(result);
+}
+
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_membuf_write),
         cmocka_unit_test(test_membuf_realloc),
+        cmocka_unit_test(test_membuf_realloc_large),
         cmocka_unit_test(test_membuf_read),
+        cmocka_unit_test(test_segments_read_write),
+        cmocka_unit_test(test_mmap_read_write),
+        cmocka_unit_test(test_uring_read_write),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,148 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <huffman/histogram.h>
+#include <huffman/kernel.h>
+#include "assert.h"
+#include "fill.h"
+
+
+#define TEST_KERNELS_LEN 4099
+
+
+static const huf_kernels_kind_t kernels_kinds[] = {
+    HUF_KERNELS_PORTABLE,
+    HUF_KERNELS_BMI2,
+};
+
+
+// Pack the codes of the leaves by walking the tree from each
+// leaf to the root.
+static void
+fill_codes(huf_code_t *codes, const huf_tree_t *tree)
+{
+    memset(codes, 0, sizeof(huf_code_t) * HUF_ASCII_COUNT);
+
+    for (size_t index = 0; index < HUF_ASCII_COUNT; index++) {
+        const huf_node_t *node = tree->leaves[index];
+        if (!node) {
+            continue;
+        }
+
+        while (node->parent) {
+            uint64_t bit = node->parent->right == node;
+
+            codes[index].bits = (codes[index].bits >> 1) | (bit << 63);
+            codes[index].length++;
+            node = node->parent;
+        }
+    }
+}
+
+
+// Validate that all kernels count bytes the same way.
+static void
+test_kernels_histogram(void **state)
+{
+    uint8_t buf[TEST_KERNELS_LEN];
+    uint64_t expected[HUF_ASCII_COUNT] = {0};
+
+    fill_buffer(buf, sizeof(buf), 42, 0x7);
+    for (size_t index = 0; index < sizeof(buf); index++) {
+        expected[buf[index]]++;
+    }
+
+    assert_non_null(huf_kernels_default());
+
+    for (size_t kind = 0; kind < sizeof(kernels_kinds) / sizeof(*kernels_kinds); kind++) {
+        const huf_kernels_t *kernels = huf_kernels_lookup(kernels_kinds[kind]);
+        if (!kernels) {
+            continue;
+        }
+
+        // Use short buffer as well to validate the direct counting.
+        uint64_t frequencies[HUF_ASCII_COUNT] = {0};
+        kernels->histogram(frequencies, buf, sizeof(buf) - 3);
+        kernels->histogram(frequencies, buf + sizeof(buf) - 3, 3);
+
+        assert_memory_equal(frequencies, expected, sizeof(expected));
+    }
+}
+
+
+// Validate that output of all kernels is the same, and each of
+// the kernels decodes the encoded buffer.
+static void
+test_kernels_encode_decode(void **state)
+{
+    uint8_t buf[TEST_KERNELS_LEN];
+    uint8_t decoded[TEST_KERNELS_LEN];
+
+    // Encoded buffer with the space for the unconditional stores.
+    uint8_t expected[TEST_KERNELS_LEN + 8];
+    uint8_t encoded[TEST_KERNELS_LEN + 8];
+    size_t expected_len = 0;
+
+    fill_buffer(buf, sizeof(buf), 42, 0x7);
+
+    huf_histogram_t *histogram = NULL;
+    huf_tree_t *tree = NULL;
+
+    assert_ok(huf_histogram_init(&histogram, 1, HUF_HISTOGRAM_LEN));
+    assert_ok(huf_histogram_populate(histogram, buf, sizeof(buf)));
+    assert_ok(huf_tree_init(&tree));
+    assert_ok(huf_tree_from_histogram(tree, histogram));
+
+    huf_code_t codes[HUF_ASCII_COUNT];
+    huf_decode_table_t table;
+
+    fill_codes(codes, tree);
+    assert_ok(huf_decode_table_init(&table, tree));
+
+    for (size_t kind = 0; kind < sizeof(kernels_kinds) / sizeof(*kernels_kinds); kind++) {
+        const huf_kernels_t *kernels = huf_kernels_lookup(kernels_kinds[kind]);
+        if (!kernels) {
+            continue;
+        }
+
+        huf_bit_writer_t writer = {0};
+        size_t encoded_len = kernels->encode(&writer, codes, buf, sizeof(buf), encoded);
+
+        // Write the last incomplete byte.
+        if (writer.count) {
+            encoded[encoded_len++] = writer.bits >> 56;
+        }
+
+        if (kernels->kind == HUF_KERNELS_PORTABLE) {
+            memcpy(expected, encoded, encoded_len);
+            expected_len = encoded_len;
+        }
+
+        assert_int_equal(encoded_len, expected_len);
+        assert_memory_equal(encoded, expected, expected_len);
+
+        huf_bit_reader_t reader;
+        huf_bit_reader_init(&reader, encoded, encoded_len);
+
+        memset(decoded, 0, sizeof(decoded));
+        assert_ok(kernels->decode(&reader, &table, tree->root, decoded, sizeof(decoded)));
+        assert_memory_equal(decoded, buf, sizeof(buf));
+    }
+
+    assert_ok(huf_tree_free(&tree));
+    assert_ok(huf_histogram_free(&histogram));
+}
+
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_kernels_histogram),
+        cmocka_unit_test(test_kernels_encode_decode),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
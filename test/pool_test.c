@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <huffman/pool.h>
+#include "assert.h"
+
+
+static void
+test_pool_get_put(void **state)
+{
+    huf_pool_t *pool = NULL;
+    void *buf = NULL, *next = NULL;
+
+    assert_ok(huf_pool_init(&pool, 0));
+    assert_ok(huf_pool_get(pool, &buf, 1000));
+    memset(buf, 0xff, 1000);
+
+    // Released buffer is reused for the buffers of the same size class.
+    huf_pool_put(pool, buf);
+    assert_ok(huf_pool_get(pool, &next, 1024));
+    assert_ptr_equal(next, buf);
+    huf_pool_put(pool, next);
+
+    // Large buffers are allocated directly.
+    assert_ok(huf_pool_get(pool, &buf, HUF_POOL_MAX_SIZE + 1));
+    memset(buf, 0xff, HUF_POOL_MAX_SIZE + 1);
+    huf_pool_put(pool, buf);
+
+    assert_ok(huf_pool_free(&pool));
+    assert_null(pool);
+}
+
+
+static void*
+test_pool_thread(void *arg)
+{
+    void *buf = NULL;
+
+    huf_pool_get(arg, &buf, HUF_64KIB_BUFFER);
+    huf_pool_put(arg, buf);
+
+    return buf;
+}
+
+
+static void
+test_pool_threads(void **state)
+{
+    huf_pool_t *pool = NULL;
+    pthread_t thread;
+    void *buf = NULL, *next = NULL;
+
+    assert_ok(huf_pool_init(&pool, 0));
+
+    // Buffers cached by the exited thread are shared with other threads.
+    assert_int_equal(pthread_create(&thread, NULL, test_pool_thread, pool), 0);
+    assert_int_equal(pthread_join(thread, &buf), 0);
+
+    assert_ok(huf_pool_get(pool, &next, HUF_64KIB_BUFFER));
+    assert_ptr_equal(next, buf);
+    huf_pool_put(pool, next);
+
+    assert_ok(huf_pool_free(&pool));
+}
+
+
+// Each thread takes more buffers than its cache holds, so the rest
+// of the buffers are passed between the threads through the pool.
+static void*
+test_pool_contention_thread(void *arg)
+{
+    void *bufs[16] = {NULL};
+
+    for (size_t iter = 0; iter < 1000; iter++) {
+        for (size_t index = 0; index < 16; index++) {
+            if (huf_pool_get(arg, &bufs[index], 64 << (index % 3))) {
+                return arg;
+            }
+
+            memset(bufs[index], (int)index, 64);
+        }
+
+        for (size_t index = 0; index < 16; index++) {
+            huf_pool_put(arg, bufs[index]);
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+test_pool_contention(void **state)
+{
+    huf_pool_t *pool = NULL;
+    pthread_t threads[4];
+    void *result = NULL;
+
+    assert_ok(huf_pool_init(&pool, 0));
+
+    for (size_t index = 0; index < 4; index++) {
+        assert_int_equal(pthread_create(&threads[index], NULL,
+                    test_pool_contention_thread, pool), 0);
+    }
+
+    for (size_t index = 0; index < 4; index++) {
+        assert_int_equal(pthread_join(threads[index], &result), 0);
+        assert_null(result);
+    }
+
+    assert_ok(huf_pool_free(&pool));
+}
+
+
+static void
+test_pool_allocator(void **state)
+{
+    huf_pool_t *pool = NULL;
+    huf_allocator_t allocator = {0};
+    void *buf = NULL;
+
+    assert_ok(huf_pool_init(&pool, 0));
+    assert_ok(huf_pool_allocator(pool, &allocator));
+
+    assert_ok(huf_calloc(&allocator, &buf, sizeof(uint64_t), 16));
+    for (size_t i = 0; i < 16; i++) {
+        assert_int_equal(((uint64_t*)buf)[i], 0);
+    }
+    huf_free(&allocator, buf);
+
+    // The allocator is not replaced, when it is set.
+    assert_ok(huf_pool_default_allocator(&allocator));
+    assert_ptr_equal(allocator.ctx, pool);
+
+    assert_ok(huf_pool_free(&pool));
+}
+
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_pool_get_put),
+        cmocka_unit_test(test_pool_threads),
+        cmocka_unit_test(test_pool_contention),
+        cmocka_unit_test(test_pool_allocator),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
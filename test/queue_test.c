@@ -0,0 +1,69 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <huffman/queue.h>
+#include "assert.h"
+
+
+static void
+test_queue_push_pop(void **state)
+{
+    huf_queue_t *queue = NULL;
+    int items[3] = {0};
+    void *item = NULL;
+
+    assert_int_equal(huf_queue_init(&queue, 0, NULL), HUF_ERROR_INVALID_ARGUMENT);
+    assert_ok(huf_queue_init(&queue, 2, NULL));
+
+    // Wrap the items around the end of the ring.
+    assert_ok(huf_queue_push(queue, &items[0]));
+    assert_ok(huf_queue_push(queue, &items[1]));
+    assert_ok(huf_queue_pop(queue, &item));
+    assert_ptr_equal(item, &items[0]);
+
+    assert_ok(huf_queue_push(queue, &items[2]));
+    assert_ok(huf_queue_pop(queue, &item));
+    assert_ptr_equal(item, &items[1]);
+    assert_ok(huf_queue_pop(queue, &item));
+    assert_ptr_equal(item, &items[2]);
+
+    assert_ok(huf_queue_free(&queue));
+    assert_null(queue);
+}
+
+
+static void
+test_queue_close(void **state)
+{
+    huf_queue_t *queue = NULL;
+    int items[1] = {0};
+    void *item = NULL;
+
+    assert_ok(huf_queue_init(&queue, 1, NULL));
+    assert_ok(huf_queue_push(queue, &items[0]));
+    assert_ok(huf_queue_close(queue));
+
+    // Items are not pushed to the closed queue, but
+    // the queued items are still returned.
+    assert_int_equal(huf_queue_push(queue, &items[0]), HUF_ERROR_INVALID_ARGUMENT);
+    assert_ok(huf_queue_pop(queue, &item));
+    assert_ptr_equal(item, &items[0]);
+
+    assert_ok(huf_queue_pop(queue, &item));
+    assert_null(item);
+
+    assert_ok(huf_queue_free(&queue));
+}
+
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_queue_push_pop),
+        cmocka_unit_test(test_queue_close),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,165 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <huffman.h>
+#include "allocator.h"
+#include "assert.h"
+#include "fill.h"
+
+
+#define TEST_STATS_LEN 70001
+
+#define TEST_STATS_BLOCKSIZE 16384
+
+
+// Encode or decode the buffer with the specified configuration, and
+// return the length of the output.
+static size_t
+run_buffer(huf_config_t config, int encode, const uint8_t *buf, size_t len,
+        uint8_t *out)
+{
+    void *bufin, *bufout = NULL;
+    huf_read_writer_t *input, *output = NULL;
+    size_t out_len = 0;
+
+    assert_ok(huf_memopen(&input, &bufin, HUF_1KIB_BUFFER));
+    assert_ok(huf_memopen(&output, &bufout, HUF_1KIB_BUFFER));
+    assert_ok(input->write(input->stream, buf, len));
+
+    config.length = len;
+    config.reader = input;
+    config.writer = output;
+
+    assert_ok(encode ? huf_encode(&config) : huf_decode(&config));
+    assert_ok(huf_memlen(output, &out_len));
+
+    memcpy(out, bufout, out_len);
+
+    assert_ok(huf_memclose(&input));
+    assert_ok(huf_memclose(&output));
+
+    free(bufin);
+    free(bufout);
+
+    return out_len;
+}
+
+
+static void
+test_stats_encode_decode(void **state)
+{
+    uint8_t buf[TEST_STATS_LEN];
+    uint8_t encoded[TEST_STATS_LEN * 2];
+    uint8_t decoded[TEST_STATS_LEN];
+
+    fill_buffer(buf, sizeof(buf), 11, 0xf);
+
+    for (size_t streams = 1; streams <= HUF_INTERLEAVED_STREAMS; streams += 3) {
+        for (int frame = 0; frame < 2; frame++) {
+            for (size_t depth = 0; depth < 3; depth += 2) {
+                huf_stats_t encoder_stats, decoder_stats;
+                counting_allocator_t counter = {0};
+
+                huf_config_t config = {
+                    .blocksize = TEST_STATS_BLOCKSIZE,
+                    .reader_buffer_size = HUF_1KIB_BUFFER,
+                    .writer_buffer_size = HUF_1KIB_BUFFER,
+                    .streams = streams,
+                    .pipeline_depth = depth,
+                    .frame = frame,
+                    .allocator = counting_allocator(&counter),
+                    .stats = &encoder_stats,
+                };
+
+                size_t encoded_len = run_buffer(config, 1, buf, sizeof(buf), encoded);
+
+                assert_int_equal(encoder_stats.bytes_in, sizeof(buf));
+                assert_int_equal(encoder_stats.bytes_out, encoded_len);
+                assert_int_equal(encoder_stats.blocks,
+                        (sizeof(buf) + TEST_STATS_BLOCKSIZE - 1) / TEST_STATS_BLOCKSIZE);
+                assert_int_equal(encoder_stats.header_bytes + encoder_stats.payload_bytes,
+                        encoded_len);
+                assert_int_equal(encoder_stats.symbols, sizeof(buf));
+                assert_int_equal(encoder_stats.allocations, counter.allocations);
+
+                // Each stream of the block is padded by less than a byte.
+                assert_true(encoder_stats.code_bits <= encoder_stats.payload_bytes * 8);
+                assert_true(encoder_stats.code_bits + encoder_stats.blocks * streams * 8 >
+                        encoder_stats.payload_bytes * 8);
+
+                // Most of the symbols are 4-bit long.
+                double code_length = huf_stats_code_length(&encoder_stats);
+                assert_true(code_length > 4 && code_length < 8);
+                assert_true(encoder_stats.max_depth >= 8);
+
+                assert_true(encoder_stats.total_ns >= encoder_stats.histogram_ns +
+                        encoder_stats.tree_ns + encoder_stats.coding_ns);
+
+                counter.allocations = 0;
+                config.stats = &decoder_stats;
+
+                size_t decoded_len = run_buffer(config, 0, encoded, encoded_len, decoded);
+
+                assert_int_equal(decoded_len, sizeof(buf));
+                assert_memory_equal(decoded, buf, sizeof(buf));
+
+                assert_int_equal(decoder_stats.bytes_in, encoded_len);
+                assert_int_equal(decoder_stats.bytes_out, sizeof(buf));
+                assert_int_equal(decoder_stats.blocks, encoder_stats.blocks);
+                assert_int_equal(decoder_stats.header_bytes, encoder_stats.header_bytes);
+                assert_int_equal(decoder_stats.payload_bytes, encoder_stats.payload_bytes);
+                assert_int_equal(decoder_stats.symbols, sizeof(buf));
+                assert_int_equal(decoder_stats.max_depth, encoder_stats.max_depth);
+                assert_int_equal(decoder_stats.allocations, counter.allocations);
+                assert_int_equal(decoder_stats.histogram_ns, 0);
+            }
+        }
+    }
+}
+
+
+static void
+test_stats_reset(void **state)
+{
+    uint8_t buf[TEST_STATS_LEN];
+    uint8_t encoded[TEST_STATS_LEN * 2];
+
+    fill_buffer(buf, sizeof(buf), 11, 0xf);
+
+    huf_stats_t stats;
+    memset(&stats, 0xff, sizeof(stats));
+
+    huf_config_t config = {
+        .blocksize = TEST_STATS_BLOCKSIZE,
+        .stats = &stats,
+    };
+
+    // Statistics of the previous run are not accumulated.
+    size_t encoded_len = run_buffer(config, 1, buf, 100, encoded);
+
+    assert_int_equal(stats.bytes_in, 100);
+    assert_int_equal(stats.bytes_out, encoded_len);
+    assert_int_equal(stats.blocks, 1);
+
+    // Empty input is not encoded.
+    encoded_len = run_buffer(config, 1, buf, 0, encoded);
+
+    assert_int_equal(encoded_len, 0);
+    assert_int_equal(stats.blocks, 0);
+    assert_int_equal(stats.bytes_out, 0);
+    assert_true(huf_stats_code_length(&stats) == 0);
+}
+
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_stats_encode_decode),
+        cmocka_unit_test(test_stats_reset),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -35,10 +35,44 @@ test_tree_from_histogram(void **state)
 }
 
 
+// Validate that the tree of all symbols fits into the serialized tree.
+static void
+test_tree_all_symbols(void **state)
+{
+    huf_histogram_t *hist = NULL;
+    huf_tree_t *tree = NULL;
+
+    int16_t buf[HUF_BTREE_LEN * 2];
+    size_t len = 0;
+
+    assert_ok(huf_histogram_init(&hist, 1, HUF_HISTOGRAM_LEN));
+    assert_ok(huf_tree_init(&tree));
+
+    uint8_t array[HUF_ASCII_COUNT];
+    for (size_t index = 0; index < sizeof(array); index++) {
+        array[index] = index;
+    }
+
+    assert_ok(huf_histogram_populate(hist, array, sizeof(array)));
+    assert_ok(huf_tree_from_histogram(tree, hist));
+
+    assert_non_null(tree->root);
+    assert_non_null(tree->root->left);
+    assert_non_null(tree->root->right);
+
+    assert_ok(huf_tree_serialize(tree, buf, &len));
+    assert_int_equal(len, HUF_BTREE_LEN - 1);
+
+    assert_ok(huf_histogram_free(&hist));
+    assert_ok(huf_tree_free(&tree));
+}
+
+
 int main(void)
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_tree_from_histogram),
+        cmocka_unit_test(test_tree_all_symbols),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);